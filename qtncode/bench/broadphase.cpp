@@ -0,0 +1,90 @@
+// Times the BVH and uniform-grid broad phases of intersectMeshes() against
+// each other. Every STL file given on the command line is intersected with a
+// shifted copy of itself, followed by synthetic UV spheres of increasing size
+// and a fine sphere against a coarse one (uneven triangle sizes, where the
+// grid is weakest). Each case is run a few times and the fastest run kept.
+//
+//   bench_broadphase [runs] [file.stl ...]
+//   bench_broadphase 3 ../cube.stl ../sphere.stl
+
+#include "intersection.h"
+#include "stlparser.h"
+#include "trianglebatch.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Sphere of slices * stacks quads, split into triangles; the poles are fans
+static std::vector<Triangle> uvSphere(int slices, int stacks, float radius, const POINT& center) {
+    auto at = [&](int i, int j) {
+        double theta = M_PI * j / stacks, phi = 2 * M_PI * (i % slices) / slices;
+        return POINT(center.x + float(radius * std::sin(theta) * std::cos(phi)),
+                     center.y + float(radius * std::sin(theta) * std::sin(phi)),
+                     center.z + float(radius * std::cos(theta)));
+    };
+    std::vector<Triangle> out;
+    for (int j = 0; j < stacks; ++j)
+        for (int i = 0; i < slices; ++i) {
+            POINT a = at(i, j), b = at(i + 1, j), c = at(i, j + 1), d = at(i + 1, j + 1);
+            if (j > 0)
+                out.emplace_back(a, c, b);
+            if (j < stacks - 1)
+                out.emplace_back(b, c, d);
+        }
+    return out;
+}
+
+// Copy moved by a fraction of the mesh size that lines up with no face
+static std::vector<Triangle> shifted(const std::vector<Triangle>& triangles) {
+    AABB box;
+    for (const Triangle& t : triangles)
+        box.expand(triangleBounds(t));
+    POINT d(0.137f * (box.max.x - box.min.x), 0.071f * (box.max.y - box.min.y), 0.053f * (box.max.z - box.min.z));
+    std::vector<Triangle> out(triangles);
+    for (Triangle& t : out)
+        for (POINT* p : { &t.p1, &t.p2, &t.p3 })
+            *p = POINT(p->x + d.x, p->y + d.y, p->z + d.z);
+    return out;
+}
+
+static void run(const char* name, const std::vector<Triangle>& a, const std::vector<Triangle>& b, int runs) {
+    std::printf("%-24s %9zu x %9zu", name, a.size(), b.size());
+    for (BroadPhase phase : { BroadPhase::Tree, BroadPhase::Grid }) {
+        BroadPhaseStats best;
+        size_t segments = 0;
+        for (int r = 0; r < runs; ++r) {
+            std::vector<std::pair<POINT, POINT>> out;
+            BroadPhaseStats stats;
+            intersectMeshes(a, b, out, phase, &stats);
+            if (r == 0 || stats.buildMs + stats.queryMs < best.buildMs + best.queryMs)
+                best = stats;
+            segments = out.size();
+        }
+        std::printf(" | %s build %8.1f query %8.1f ms, %9zu pairs, %7zu segs", phase == BroadPhase::Tree ? "tree" : "grid",
+                    best.buildMs, best.queryMs, best.candidates, segments);
+    }
+    std::printf("\n");
+}
+
+int main(int argc, char** argv) {
+    int runs = argc > 1 ? std::max(1, std::atoi(argv[1])) : 3;
+    std::printf("narrow phase on %s, best of %d run(s)\n", triangleBatchKernel(), runs);
+
+    for (int i = 2; i < argc; ++i) {
+        std::vector<Triangle> mesh;
+        if (!loadSTLFile(argv[i], mesh))
+            return 1;
+        run(argv[i], mesh, shifted(mesh), runs);
+    }
+
+    for (int slices : { 64, 256, 1024 }) {
+        std::vector<Triangle> sphere = uvSphere(slices, slices / 2, 1.0f, POINT(0, 0, 0));
+        run(("sphere " + std::to_string(slices)).c_str(), sphere, shifted(sphere), runs);
+    }
+    run("fine x coarse sphere", uvSphere(1024, 512, 1.0f, POINT(0, 0, 0)), uvSphere(32, 16, 1.0f, POINT(0.3f, 0.1f, 0.05f)),
+        runs);
+    return 0;
+}
@@ -0,0 +1,76 @@
+#ifndef BLOCKEDMESH_H
+#define BLOCKEDMESH_H
+
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <unordered_map>
+#include "triangle.h"
+#include "bvh.h"
+
+// Mesh that is not held as a plain triangle soup but handed out in spatially
+// coherent blocks of triangles, each with its bounds. Implemented by meshes
+// paged in from disk (OutOfCoreMesh) and by compressed in-memory meshes
+// (QuantizedMesh); both can stand in for a mesh's triangle soup.
+class BlockedMesh {
+public:
+    using Block = std::shared_ptr<const std::vector<Triangle>>;
+
+    virtual ~BlockedMesh() = default;
+
+    virtual size_t triangleCount() const = 0;
+    virtual size_t blockCount() const = 0;
+    virtual const AABB& bounds() const = 0;
+    virtual const AABB& blockBound(size_t b) const = 0;
+
+    // Decoded triangles of block b. The returned handle stays valid however
+    // the mesh manages its own storage meanwhile. Safe to call from several
+    // threads at once.
+    virtual Block block(size_t b) = 0;
+    // Whether block(b) is cheap right now (drawing falls back to boxes otherwise)
+    virtual bool isResident(size_t b) const = 0;
+};
+
+// Decoded blocks of a BlockedMesh kept for reuse, least recently used
+// dropped first once they take more than a byte budget (at least one block is
+// always kept). Safe to use from several threads at once.
+class ResidentBlocks {
+public:
+    explicit ResidentBlocks(size_t budget) : budget(budget) {}
+    // Takes over the other set's blocks; only for a set no other thread uses
+    ResidentBlocks(ResidentBlocks&& other);
+
+    // Block b if it is held, now marked most recently used; null otherwise
+    BlockedMesh::Block find(size_t b);
+    // Holds decoded as block b and returns it, or returns the block another
+    // thread inserted first
+    BlockedMesh::Block insert(size_t b, BlockedMesh::Block decoded);
+    bool contains(size_t b) const;
+
+    void setBudget(size_t bytes);
+    size_t budgetBytes() const;
+    size_t residentBytes() const;
+
+private:
+    void evict();
+
+    mutable std::mutex mutex;
+    size_t budget;
+    size_t resident = 0;
+    std::list<std::pair<size_t, BlockedMesh::Block>> lru; // Most recently used first
+    std::unordered_map<size_t, std::list<std::pair<size_t, BlockedMesh::Block>>::iterator> index;
+};
+
+// Intersection segments between two blocked meshes, or a blocked mesh and an
+// in-memory one. Only block pairs with overlapping bounds are decoded. Blocks
+// of `a` are tasks on the work-stealing pool. Each builds BVHs over just the
+// triangles of its block and of each overlapping block of b that lie inside
+// the other's bounds (for an in-memory b, one BVH over all of b is shared),
+// and runs them through the dual traversal and batched narrow phase of
+// intersectMeshes().
+void intersectBlocked(BlockedMesh& a, BlockedMesh& b, std::vector<std::pair<POINT, POINT>>& segments);
+void intersectBlocked(BlockedMesh& a, const std::vector<Triangle>& b, std::vector<std::pair<POINT, POINT>>& segments);
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <type_traits>
+#include "triangle.h"
+
+// Axis-aligned bounding box
+struct AABB {
+    POINT min = POINT(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                      std::numeric_limits<float>::max());
+    POINT max = POINT(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(),
+                      -std::numeric_limits<float>::max());
+
+    void expand(const POINT& p) {
+        min = POINT(std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z));
+        max = POINT(std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z));
+    }
+    void expand(const AABB& b) {
+        expand(b.min);
+        expand(b.max);
+    }
+    bool empty() const { return min.x > max.x; }
+    bool overlaps(const AABB& b) const {
+        return min.x <= b.max.x && b.min.x <= max.x &&
+               min.y <= b.max.y && b.min.y <= max.y &&
+               min.z <= b.max.z && b.min.z <= max.z;
+    }
+    POINT center() const {
+        return POINT(0.5f * (min.x + max.x), 0.5f * (min.y + max.y), 0.5f * (min.z + max.z));
+    }
+    // Half the surface area, which is all the SAH needs
+    float halfArea() const {
+        if (empty())
+            return 0.0f;
+        float dx = max.x - min.x, dy = max.y - min.y, dz = max.z - min.z;
+        return dx * dy + dy * dz + dz * dx;
+    }
+};
+
+AABB triangleBounds(const Triangle& t);
+
+// Flat BVH node, 32 bytes. Inner nodes (count == 0) store the index of their
+// left child in `first`; the right child always follows it. Leaves reference
+// `count` entries of BVH::primitives starting at `first`.
+struct BVHNode {
+    AABB bounds;
+    uint32_t first = 0;
+    uint32_t count = 0;
+
+    bool isLeaf() const { return count != 0; }
+};
+
+// Bounding volume hierarchy over the triangles of one mesh. The node and
+// primitive arrays are plain data so they can be written to and read from
+// disk unchanged (see meshcache.h). nodes[0] is the root.
+class BVH {
+public:
+    std::vector<BVHNode> nodes;
+    std::vector<uint32_t> primitives;
+
+    static const uint32_t MAX_LEAF_SIZE = 4;
+    // Candidate split planes per axis for the binned SAH
+    static const int SAH_BINS = 16;
+
+    // How nodes are split. The binned surface area heuristic gives the tree
+    // that is fastest to query; splitting at the centroid median along the
+    // longest axis builds several times faster, which wins for trees that
+    // are built to answer a single query.
+    enum class Split { SAH, Median };
+
+    // The upper levels are split on the calling thread, the subtrees below
+    // them are built concurrently unless `parallel` is off (for callers that
+    // already run one build per task).
+    void build(const std::vector<Triangle>& triangles, bool parallel = true, Split split = Split::SAH);
+    bool empty() const { return nodes.empty(); }
+};
+
+// Node bounds of a tree in the frame it was built in
+struct SameFrameBounds {
+    const AABB& operator()(const AABB& box) const { return box; }
+};
+
+// Simultaneous descent of two hierarchies: calls fn(leafA, leafB) for every
+// pair of leaves whose bounds overlap. At each step the node with the larger
+// surface is opened, so both trees are refined at a similar rate. The descent
+// can start from any pair of nodes (rootA, rootB) instead of the roots.
+// boundsB maps the bounds of b's nodes into a's frame, for trees built over
+// meshes that are placed differently. If fn returns bool, returning false
+// ends the descent.
+template <typename Fn, typename BoundsB = SameFrameBounds>
+void forEachOverlappingLeafPair(const BVH& a, const BVH& b, Fn fn, uint32_t rootA = 0, uint32_t rootB = 0,
+                                BoundsB boundsB = BoundsB()) {
+    if (a.empty() || b.empty())
+        return;
+    std::vector<std::pair<uint32_t, uint32_t>> stack;
+    stack.push_back({ rootA, rootB });
+    while (!stack.empty()) {
+        auto [ia, ib] = stack.back();
+        stack.pop_back();
+        const BVHNode& na = a.nodes[ia];
+        const BVHNode& nb = b.nodes[ib];
+        const AABB& boxB = boundsB(nb.bounds);
+        if (!na.bounds.overlaps(boxB))
+            continue;
+        if (na.isLeaf() && nb.isLeaf()) {
+            if constexpr (std::is_same_v<decltype(fn(na, nb)), bool>) {
+                if (!fn(na, nb))
+                    return;
+            } else {
+                fn(na, nb);
+            }
+        } else if (nb.isLeaf() || (!na.isLeaf() && na.bounds.halfArea() >= boxB.halfArea())) {
+            stack.push_back({ na.first + 1, ib });
+            stack.push_back({ na.first, ib });
+        } else {
+            stack.push_back({ ia, nb.first + 1 });
+            stack.push_back({ ia, nb.first });
+        }
+    }
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <cmath>
+#include "triangle.h"
 
 class Point {
 private:
@@ -63,6 +64,8 @@ public:
     void finalizeExtrusion();
     void build2DFace();
     void draw() const;
+    // Closed triangle mesh of the extruded solid (or the 2D face if not extruded)
+    std::vector<Triangle> toTriangles() const;
 };
 
 
@@ -0,0 +1,51 @@
+#ifndef GZIPREADER_H
+#define GZIPREADER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include "boundedqueue.h"
+
+struct gzFile_s;
+
+// Decompression stage of a streaming import. open() starts a thread that
+// inflates the file and queues the output in CHUNK_SIZE pieces; read() hands
+// them to the consumer in file order. At most QUEUE_CHUNKS chunks wait in
+// memory, so the decompressor and the parser run side by side without the
+// whole file ever being inflated at once.
+class GzipReader {
+public:
+    static const size_t CHUNK_SIZE = 1 << 20;
+    static const size_t QUEUE_CHUNKS = 8;
+
+    GzipReader();
+    ~GzipReader();
+    GzipReader(const GzipReader&) = delete;
+    GzipReader& operator=(const GzipReader&) = delete;
+
+    // Plain (uncompressed) files are passed through unchanged
+    bool open(const std::string& filename);
+    // Next chunk of decompressed data; false at the end of the stream
+    bool read(std::vector<char>& chunk);
+    // Stops the decompressor early and waits for its thread
+    void stop();
+
+    // Set once the compressed stream turned out to be corrupt or truncated
+    bool failed() const { return error.load(); }
+    // Fraction of the compressed file consumed so far
+    float progress() const;
+
+private:
+    void run();
+
+    gzFile_s* file = nullptr;
+    std::thread thread;
+    BoundedQueue<std::vector<char>> queue;
+    std::atomic<bool> error{false};
+    std::atomic<uint64_t> consumed{0};
+    uint64_t compressedSize = 0;
+};
+
+#endif
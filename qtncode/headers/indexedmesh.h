@@ -0,0 +1,32 @@
+#ifndef INDEXEDMESH_H
+#define INDEXEDMESH_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "triangle.h"
+
+// Triangle mesh with shared vertices: every triangle is three consecutive
+// entries of `indices` pointing into `vertices`.
+class IndexedMesh {
+public:
+    std::vector<POINT> vertices;
+    std::vector<uint32_t> indices;
+
+    size_t triangleCount() const { return indices.size() / 3; }
+    Triangle triangle(size_t i) const {
+        return Triangle(vertices[indices[3 * i]], vertices[indices[3 * i + 1]], vertices[indices[3 * i + 2]]);
+    }
+    // Expands back into a triangle soup
+    std::vector<Triangle> toTriangles() const;
+};
+
+// Builds an indexed mesh from a triangle soup by hash-based vertex welding.
+// Every vertex is merged into the first earlier kept vertex within
+// `tolerance` of it, searched in the grid cells around it; a tolerance of 0
+// merges only identical positions. Triangle order and count are preserved
+// (welded slivers are kept), and large inputs are welded on all cores, with
+// or without a tolerance.
+IndexedMesh weldVertices(const std::vector<Triangle>& triangles, float tolerance = 0.0f);
+
+#endif
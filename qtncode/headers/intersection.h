@@ -2,19 +2,124 @@
 #define INTERSECTION_H
 
 #include <vector>
+#include <memory>
+#include <utility>
+#include <cstdint>
 #include "triangle.h"
+#include "bvh.h"
+#include "transform.h"
 
-// Separate vectors for each triangle group (e.g., for two objects/meshes)
-extern std::vector<Triangle> trianglesA;
-extern std::vector<Triangle> trianglesB;
-
-// Intersection function declaration
+// Returns true if the triangles cross along a segment or overlap in a common
+// plane by more than a point: exactly the pairs intersectTrianglePair() draws
+// something for. Decided with exact predicates; no points are kept.
 bool trianglesIntersect(const Triangle& t1, const Triangle& t2);
 // Returns true if triangles are coplanar
 bool trianglesCoplanar(const Triangle& t1, const Triangle& t2);
 // Returns true if triangles intersect in 3D and sets segA, segB to the segment endpoints
 bool triangleTriangleIntersectionSegment(const Triangle& t1, const Triangle& t2, POINT& segA, POINT& segB);
 
-// Extensible: you can add more vectors like trianglesC, trianglesD, etc. in the future.
+// Endpoint of an intersection segment and where it lies on either triangle:
+// -1 inside, 0..2 on edge k (corner k to corner k + 1), 3..5 on corner k - 3.
+// The locations are decided exactly. A point that several pairs find (where
+// an edge crosses a triangle, or two edges cross) is computed the same way
+// by all of them, so their cuts meet bit for bit.
+struct SegmentEnd {
+    POINT p;
+    int8_t on1 = -1;
+    int8_t on2 = -1;
+};
+// Same, for non-coplanar triangles only, also reporting the locations
+bool triangleTriangleIntersectionSegment(const Triangle& t1, const Triangle& t2, SegmentEnd& segA, SegmentEnd& segB);
+// Overlap of two coplanar triangles as a convex polygon in 3D, found by
+// clipping t1 against t2 in the coordinate plane facing t1's normal most
+// directly. Its corners are corners of t1 or t2 or crossings of their edges,
+// computed as the edge-crossing tests compute them. Returns the vertex
+// count: 0 if they are disjoint or degenerate, 1 or 2 if they only touch at
+// a point or along a segment, at most 6.
+int coplanarOverlap(const Triangle& t1, const Triangle& t2, POINT out[6]);
+// Appends the intersection of one pair to segments (coplanar or not)
+void intersectTrianglePair(const Triangle& triA, const Triangle& triB, std::vector<std::pair<POINT, POINT>>& segments);
+// Intersection segments between two triangle soups. Candidate pairs come from
+// a dual traversal of the meshes' hierarchies; only triangles of overlapping
+// leaves whose own boxes overlap reach the exact test.
+void intersectMeshes(const std::vector<Triangle>& a, const BVH& bvhA,
+                     const std::vector<Triangle>& b, const BVH& bvhB,
+                     std::vector<std::pair<POINT, POINT>>& segments);
+// Same on the calling thread only, for callers that already run one query
+// per task (intersectBlocked)
+void intersectMeshesSerial(const std::vector<Triangle>& a, const BVH& bvhA,
+                           const std::vector<Triangle>& b, const BVH& bvhB,
+                           std::vector<std::pair<POINT, POINT>>& segments);
+// Whether intersectMeshes() would find any segment. Subtree pairs are
+// searched on all cores, one leaf pair at a time, and all of them stop once
+// any finds an intersecting triangle pair.
+bool meshesIntersect(const std::vector<Triangle>& a, const BVH& bvhA,
+                     const std::vector<Triangle>& b, const BVH& bvhB);
+// Number of triangle pairs that intersect (trianglesIntersect), found by the
+// same traversal and plane-side filter as intersectMeshes() but without
+// building or collecting segments
+size_t countIntersectingPairs(const std::vector<Triangle>& a, const BVH& bvhA,
+                              const std::vector<Triangle>& b, const BVH& bvhB);
+// Pairs (i << 32 | j) of triangles a[i], b[j] whose boxes overlap, found by
+// the same parallel dual traversal. The order does not depend on scheduling.
+std::vector<uint64_t> candidatePairs(const std::vector<Triangle>& a, const BVH& bvhA,
+                                     const std::vector<Triangle>& b, const BVH& bvhB);
+
+// Structure that finds the candidate pairs of two triangle soups
+enum class BroadPhase {
+    Tree, // BVH per mesh, dual traversal
+    Grid  // Uniform grid over both meshes (spatialhash.h)
+};
+
+// Where the time of one intersectMeshes() call went
+struct BroadPhaseStats {
+    double buildMs = 0.0; // Building the trees or the grid
+    double queryMs = 0.0; // Finding candidates plus the exact tests
+    size_t candidates = 0;
+    bool reused = false;  // Candidates kept from the previous call (RigidIntersection)
+};
+
+// Same, building the chosen broad phase structure first. The trees serve only
+// this query, so they use the cheaper median split.
+void intersectMeshes(const std::vector<Triangle>& a, const std::vector<Triangle>& b,
+                     std::vector<std::pair<POINT, POINT>>& segments,
+                     BroadPhase phase = BroadPhase::Tree, BroadPhaseStats* stats = nullptr);
+
+// Intersection of two meshes placed by rigid transforms, kept up to date
+// while they move but keep their shape. Each mesh's BVH is built once in its
+// own frame and only b's boxes are carried into a's frame during the
+// traversal. While b is moving, candidates are collected with its boxes grown
+// by a few of the recent steps (at most a quarter triangle); until no point
+// of b has moved further than that relative to a, later calls skip the broad
+// phase and rerun just the exact tests on the stored candidates.
+class RigidIntersection {
+public:
+    // Forgets the hierarchies and candidates; call when either mesh changes
+    // shape or is replaced
+    void reset();
+    // Segments, in world coordinates, between a placed by placeA and b placed by placeB.
+    // treeA and treeB are hierarchies already built over a and b (read from
+    // a mesh cache); they are used instead of building new ones.
+    void intersect(const std::vector<Triangle>& a, const RigidTransform& placeA,
+                   const std::vector<Triangle>& b, const RigidTransform& placeB,
+                   std::vector<std::pair<POINT, POINT>>& segments, BroadPhaseStats* stats = nullptr,
+                   std::shared_ptr<const BVH> treeA = nullptr, std::shared_ptr<const BVH> treeB = nullptr);
+
+private:
+    // Upper bound on how far any point of b moves between two placements in a's frame
+    float displacement(const RigidTransform& from, const RigidTransform& to) const;
+
+    std::shared_ptr<const BVH> bvhA, bvhB;
+    bool built = false;
+    float margin = 0.0f;    // Growth of b's boxes for the stored candidates
+    float maxMargin = 0.0f;
+    POINT centerB;        // Bounding sphere of b in its own frame
+    float radiusB = 0.0f;
+    RigidTransform candidateFrame; // b -> a when the candidates were collected
+    bool haveCandidates = false;
+    RigidTransform previousFrame;  // b -> a on the last call
+    bool havePrevious = false;
+    std::vector<std::vector<uint64_t>> taskPairs; // (i << 32 | j) per task
+};
 
 #endif
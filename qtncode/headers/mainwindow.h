@@ -9,10 +9,15 @@
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QFileDialog>
+#include <QProgressBar>
+#include <QCheckBox>
+#include <QListWidget>
+#include <QThreadPool>
 #include "openglwidget.h"
 #include "revolvebezier.h"
 #include "glwidget.h"
 #include "stlwidget.h"
+#include "stlimporter.h"
 
 class MainWindow : public QMainWindow
 {
@@ -30,18 +35,53 @@ private slots:
     void onAddCylinderSpecs();
     void onAddBezierIntersection();
 
+    void onExportButtonClicked();
+    void onExportSTLResult();
+
     void onImportSTL();
+    void onMeshLoaded(int job, bool ok);
+    void onImportFinished(int loaded, bool cancelled);
+    void onMeshItemChanged(QListWidgetItem *item);
+    void onMeshItemDoubleClicked(QListWidgetItem *item);
+    void onIntersectionPairChanged();
     void onFindIntersection();
+    void onIntersectionReady();
+    void onMeshBoolean();
+    void onMeasureDistance();
 
 private:
     OpenGLWidget* glWidget;
     BezierWidget* bezierWidget;
     QPushButton* pushButton;
     QPushButton* extrudeButton;
+    QPushButton* exportButton;
     QComboBox* comboBox;
     QString selectedShape = "";
 
     QPushButton *importButton;
     QPushButton *intersectionButton;
+    QPushButton *exportResultButton;
+    QPushButton *cancelImportButton;
+    QComboBox *storageCombo;
+    QComboBox *broadPhaseCombo;
+    QComboBox *booleanCombo;
+    QPushButton *booleanButton;
+    QPushButton *distanceButton;
+    QCheckBox *reorderCheck;
+    QProgressBar *importProgress;
     STLWidget* stlwidget;
+    STLImporter *importer;
+    QStringList importFailures;
+    // Find Intersection was pressed and its result has not been shown yet
+    bool intersectionReportPending = false;
+    // Runs Combine Meshes one at a time, off the GUI thread
+    struct BooleanJob;
+    QThreadPool booleanPool;
+    void onBooleanDone(BooleanJob &job);
+
+    // Mesh set panel: visibility/color list and the intersected pair
+    void refreshMeshList();
+    QListWidget *meshList = nullptr;
+    QComboBox *pairACombo = nullptr;
+    QComboBox *pairBCombo = nullptr;
 };
@@ -0,0 +1,41 @@
+#ifndef MESHBOOLEAN_H
+#define MESHBOOLEAN_H
+
+#include <vector>
+#include <cstddef>
+#include "triangle.h"
+
+// Set operation on two solids given as closed triangle meshes
+enum class BooleanOp {
+    Union,
+    Intersection,
+    Difference // a minus b
+};
+
+// Where the time of one meshBoolean() call went
+struct BooleanStats {
+    double intersectMs = 0.0;     // Trees, candidate pairs and cut segments
+    double retriangulateMs = 0.0; // Splitting the cut triangles
+    double classifyMs = 0.0;      // Inside/outside tests and assembly
+    size_t cutA = 0, cutB = 0;    // Triangles the other mesh passes through
+    size_t pieces = 0;            // Triangles those were split into
+    size_t regions = 0;           // Areas between cuts, each classified once
+};
+
+// Boolean of two closed meshes whose triangles wind counterclockwise seen
+// from outside. Triangles crossed by the other mesh are split along the
+// intersection curve (and along the outlines of coplanar overlaps). Each
+// area the cuts bound is then classified as a whole, as inside, outside or
+// on the other surface, by exact ray parity from its largest triangle. The
+// kept areas form the result, with those of b turned inside out for a
+// difference. Cut points are computed identically by every triangle pair
+// that finds them, so the result is closed wherever the inputs are.
+// Candidate pairs, cutting, splitting and classification run on all cores.
+// Returns false, with an empty result, if either mesh is empty, if some area
+// cannot be classified (every ray grazes the other mesh), or if a cut could
+// not be followed and the result would have holes; faces that touch along
+// diagonals running the other way can do that after rounding.
+bool meshBoolean(const std::vector<Triangle>& a, const std::vector<Triangle>& b, BooleanOp op,
+                 std::vector<Triangle>& result, BooleanStats* stats = nullptr);
+
+#endif
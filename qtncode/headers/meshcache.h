@@ -0,0 +1,92 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "triangle.h"
+#include "indexedmesh.h"
+#include "bvh.h"
+#include "mappedfile.h"
+#include "stlparser.h"
+
+// Preprocessed mesh cache (.stlc), written next to an imported STL.
+// A fixed header is followed by 64-byte aligned sections that can be used
+// in place from a memory mapping:
+//   vertices  POINT[vertexCount]
+//   indices   uint32_t[3 * triangleCount]
+//   normals   POINT[triangleCount]          (unit face normals)
+//   bvhNodes  BVHNode[bvhNodeCount]
+//   bvhPrims  uint32_t[bvhPrimitiveCount]
+// All values are little endian.
+struct MeshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t sourceSize;
+    AABB bounds;
+    uint64_t vertexCount;
+    uint64_t triangleCount;
+    uint64_t bvhNodeCount;
+    uint64_t bvhPrimitiveCount;
+    uint64_t verticesOffset;
+    uint64_t indicesOffset;
+    uint64_t normalsOffset;
+    uint64_t bvhNodesOffset;
+    uint64_t bvhPrimitivesOffset;
+    uint64_t reserved;
+};
+
+static const uint32_t MESH_CACHE_VERSION = 1;
+
+// "part.stl" -> "part.stlc"
+std::string meshCachePath(const std::string& sourcePath);
+// True if the cache exists, is newer than the source and was built from a
+// source of the same size
+bool meshCacheIsFresh(const std::string& sourcePath, const std::string& cachePath);
+
+// Welds the triangles, computes normals and a BVH, and writes the cache.
+// sourceSize is recorded to detect a replaced source file. Once `control` is
+// cancelled it stops between steps and leaves no file behind.
+bool writeMeshCache(const std::string& cachePath, const std::vector<Triangle>& triangles, uint64_t sourceSize,
+                    const STLLoadControl* control = nullptr);
+// Same for a mesh that is already indexed (OBJ/PLY input); it is not welded again
+bool writeMeshCache(const std::string& cachePath, const IndexedMesh& mesh, uint64_t sourceSize,
+                    const STLLoadControl* control = nullptr);
+
+// Read-only, memory-mapped view of a cache file
+class MeshCache {
+public:
+    // Fails unless every section fits the file, every index names a vertex
+    // and every BVH node and primitive is in range
+    bool open(const std::string& cachePath);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+
+    const AABB& bounds() const { return header->bounds; }
+    size_t vertexCount() const { return size_t(header->vertexCount); }
+    size_t triangleCount() const { return size_t(header->triangleCount); }
+    size_t bvhNodeCount() const { return size_t(header->bvhNodeCount); }
+    size_t bvhPrimitiveCount() const { return size_t(header->bvhPrimitiveCount); }
+
+    const POINT* vertices() const { return section<POINT>(header->verticesOffset); }
+    const uint32_t* indices() const { return section<uint32_t>(header->indicesOffset); }
+    const POINT* normals() const { return section<POINT>(header->normalsOffset); }
+    const BVHNode* bvhNodes() const { return section<BVHNode>(header->bvhNodesOffset); }
+    const uint32_t* bvhPrimitives() const { return section<uint32_t>(header->bvhPrimitivesOffset); }
+
+    // Expands the index buffer into a triangle soup (in parallel)
+    std::vector<Triangle> toTriangles() const;
+    IndexedMesh toIndexedMesh() const;
+    // The stored hierarchy, built over the triangles in toTriangles() order
+    BVH toBVH() const;
+
+private:
+    template <typename T>
+    const T* section(uint64_t offset) const { return reinterpret_cast<const T*>(file.data() + offset); }
+
+    MappedFile file;
+    const MeshCacheHeader* header = nullptr;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef MESHDISTANCE_H
+#define MESHDISTANCE_H
+
+#include <vector>
+#include "triangle.h"
+#include "bvh.h"
+
+// Result of a distance query and a pair of points that realizes it
+struct MeshDistance {
+    double distance = 0.0;
+    POINT onA; // On the first mesh
+    POINT onB; // On the second mesh
+};
+
+// Distance between two triangles (0 if they touch or intersect), with the
+// closest points. Tested as the smaller of the six corner-to-triangle and
+// nine edge-to-edge distances once an exact test rules out contact.
+double triangleDistance(const Triangle& a, const Triangle& b, POINT* onA = nullptr, POINT* onB = nullptr);
+
+// Smallest distance between the surfaces of a and b. Pairs of tree nodes
+// are visited nearest first and dropped once their boxes are farther apart
+// than the best pair found, so only the triangle pairs that can still win
+// reach the triangle kernel. Subtree pairs are searched on all cores,
+// sharing that bound. Returns false if either mesh is empty.
+bool minimumDistance(const std::vector<Triangle>& a, const BVH& bvhA, const std::vector<Triangle>& b,
+                     const BVH& bvhB, MeshDistance& result);
+
+// One-sided Hausdorff distance: how far a point of a's surface can be from
+// b. Corners are measured exactly; a triangle whose corners leave room for a
+// farther point inside it is subdivided until it cannot beat the maximum
+// found by more than tolerance (0 picks 1e-4 of a's largest extent). The
+// room is bounded both by how fast distance can change with position and by
+// the distance to the triangles of b nearest the corners. onA is the farthest point found and
+// onB the point of b closest to it. Runs on all cores. Returns false if
+// either mesh is empty.
+bool hausdorffDistance(const std::vector<Triangle>& a, const std::vector<Triangle>& b, const BVH& bvhB,
+                       MeshDistance& result, float tolerance = 0.0f);
+
+// Symmetric Hausdorff distance: the larger of the two one-sided distances.
+// The witnesses keep their meshes: onA on a, onB on b.
+bool symmetricHausdorffDistance(const std::vector<Triangle>& a, const BVH& bvhA, const std::vector<Triangle>& b,
+                                const BVH& bvhB, MeshDistance& result, float tolerance = 0.0f);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef MESHEXPORT_H
+#define MESHEXPORT_H
+
+#include <vector>
+#include <string>
+#include <utility>
+#include "triangle.h"
+#include "indexedmesh.h"
+
+// Streaming mesh writers. Output goes through one large write buffer with no
+// per-facet allocation; indexed meshes are written without expanding them
+// into a triangle soup first. All formats are binary little endian.
+
+bool writeBinarySTL(const std::string& filename, const std::vector<Triangle>& triangles);
+bool writeBinarySTL(const std::string& filename, const IndexedMesh& mesh);
+
+// PLY with float x/y/z vertices and uchar/uint face index lists. The soup
+// overload writes three vertices per triangle.
+bool writeBinaryPLY(const std::string& filename, const IndexedMesh& mesh);
+bool writeBinaryPLY(const std::string& filename, const std::vector<Triangle>& triangles);
+
+// Line segments (e.g. intersection curves) as a PLY with vertex and edge elements
+bool writeSegmentsPLY(const std::string& filename, const std::vector<std::pair<POINT, POINT>>& segments);
+
+// Picks PLY for a ".ply" extension and binary STL otherwise
+bool exportTriangles(const std::string& filename, const std::vector<Triangle>& triangles);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef MESHIMPORT_H
+#define MESHIMPORT_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include "triangle.h"
+#include "indexedmesh.h"
+#include "stlparser.h"
+
+// OBJ: "v" positions and "f" polygons (v, v/vt, v/vt/vn, v//vn; negative
+// indices count back from the last vertex). Polygons are fan-triangulated;
+// everything else is ignored.
+bool loadOBJ(const char* data, size_t size, IndexedMesh& mesh, const STLLoadControl* control = nullptr);
+
+// PLY in ascii, binary_little_endian or binary_big_endian format: x/y/z of
+// the "vertex" element and the vertex_indices (or vertex_index) list of the
+// "face" element, fan-triangulated. Other elements and properties are skipped.
+bool loadPLY(const char* data, size_t size, IndexedMesh& mesh, const STLLoadControl* control = nullptr);
+
+// True for the indexed formats above, judged by the file extension
+bool isIndexedMeshFile(const std::string& filename);
+// Maps an .obj or .ply file and reads it, keeping the file's own index buffer
+bool loadIndexedMeshFile(const std::string& filename, IndexedMesh& mesh, const STLLoadControl* control = nullptr);
+
+// Any supported format (STL, STL.gz, OBJ, PLY) as a triangle soup
+bool loadMeshFile(const std::string& filename, std::vector<Triangle>& triangles,
+                  const STLLoadControl* control = nullptr);
+
+#endif
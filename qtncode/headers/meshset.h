@@ -0,0 +1,84 @@
+#ifndef MESHSET_H
+#define MESHSET_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include "triangle.h"
+#include "blockedmesh.h"
+#include "transform.h"
+
+// One loaded mesh: either an in-memory triangle soup or a blocked
+// (out-of-core / compact) mesh, plus how it is displayed
+struct MeshEntry {
+    std::string name;
+    std::vector<Triangle> triangles;
+    std::unique_ptr<BlockedMesh> blocked;
+    // Hierarchy over `triangles` read from their mesh cache, or null
+    std::shared_ptr<const BVH> bvh;
+    float color[3] = { 0.8f, 0.8f, 0.8f };
+    bool visible = true;
+    // Placement in the scene. The triangles stay in the mesh's own frame, so
+    // moving it does not touch the geometry or its revision.
+    RigidTransform transform;
+    // Unique within the run (assigned by MeshSet::add); together with the
+    // revision it identifies the geometry results were computed from
+    uint64_t id = 0;
+    uint64_t revision = 0;
+
+    // Call after changing the geometry so cached results are recomputed
+    void touch() {
+        ++revision;
+        bvh.reset();
+    }
+
+    bool isBlocked() const { return blocked != nullptr; }
+    size_t triangleCount() const { return blocked ? blocked->triangleCount() : triangles.size(); }
+    // Every triangle as a soup (decodes blocked meshes)
+    std::vector<Triangle> toTriangles() const;
+    // The same, moved by `place`; pass a copy of `transform` when the mesh
+    // may be moved on the GUI thread meanwhile
+    std::vector<Triangle> placedTriangles(const RigidTransform& place) const;
+};
+
+// Named collection of loaded meshes. Entries keep their address while they
+// are in the set, and share() keeps one alive past its removal. Two of them
+// form the pair that is intersected ("A" and "B"); the first two meshes
+// added become that pair until it is changed.
+class MeshSet {
+public:
+    // Takes ownership, assigns the next palette color and returns the index
+    size_t add(std::unique_ptr<MeshEntry> mesh);
+    void remove(size_t index);
+    void clear();
+
+    size_t size() const { return meshes.size(); }
+    bool empty() const { return meshes.empty(); }
+    MeshEntry& operator[](size_t index) { return *meshes[index]; }
+    const MeshEntry& operator[](size_t index) const { return *meshes[index]; }
+    // Handle that stays valid after remove() or clear(), for work that still
+    // reads the entry on another thread
+    std::shared_ptr<const MeshEntry> share(size_t index) const { return meshes[index]; }
+    // Index of the first mesh called name, or -1
+    int find(const std::string& name) const;
+
+    // Intersection pair as indices, -1 while unset
+    void setIntersectionPair(int a, int b);
+    int pairA() const { return indexA; }
+    int pairB() const { return indexB; }
+    MeshEntry* meshA() { return indexA >= 0 ? meshes[indexA].get() : nullptr; }
+    MeshEntry* meshB() { return indexB >= 0 ? meshes[indexB].get() : nullptr; }
+
+private:
+    std::vector<std::shared_ptr<MeshEntry>> meshes;
+    size_t colorsUsed = 0;
+    uint64_t nextId = 1;
+    int indexA = -1;
+    int indexB = -1;
+};
+
+// Meshes loaded through the STL panel
+extern MeshSet meshSet;
+
+#endif
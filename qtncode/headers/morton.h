@@ -0,0 +1,26 @@
+#ifndef MORTON_H
+#define MORTON_H
+
+#include <vector>
+#include <cstdint>
+#include "triangle.h"
+#include "indexedmesh.h"
+#include "bvh.h"
+
+// 30-bit Morton (Z-order) code of p on a 1024^3 grid over box; points
+// outside the box are clamped to it
+uint32_t mortonCode(const POINT& p, const AABB& box);
+
+// Sorts keys of the form (code << 32 | index) by their code with a parallel
+// LSD radix sort. Equal codes keep their input order, so the result is the
+// same as std::sort on the whole keys when the indices ascend.
+void sortMortonKeys(std::vector<uint64_t>& keys);
+
+// Reorders a triangle soup along the Morton curve of the triangle centroids,
+// so that triangles close in space are close in memory
+void reorderMorton(std::vector<Triangle>& triangles);
+// Same for an indexed mesh; the vertices are reordered along the curve too
+// and the indices renumbered to match
+void reorderMorton(IndexedMesh& mesh);
+
+#endif
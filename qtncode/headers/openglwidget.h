@@ -32,6 +32,7 @@ public:
     void setSphereRadius(float r);
     void setCylinderSpecs(float r, float h);
     void extrudeCube(double height);
+    std::vector<Triangle> cubeTriangles() const;
 
 private:
     Sphere *sphere = nullptr;
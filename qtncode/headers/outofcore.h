@@ -0,0 +1,55 @@
+#ifndef OUTOFCORE_H
+#define OUTOFCORE_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include "triangle.h"
+#include "bvh.h"
+#include "blockedmesh.h"
+#include "mappedfile.h"
+#include "stlparser.h"
+
+// Triangle mesh that stays on disk. A binary STL or .stlc cache is memory
+// mapped, its triangles are grouped into spatially coherent blocks (Morton
+// order of the centroids), and blocks are decoded on demand into a
+// least-recently-used set bounded by a byte budget. Only the block index
+// (a uint32_t per triangle plus one AABB per block) stays resident.
+class OutOfCoreMesh : public BlockedMesh {
+public:
+    static const size_t BLOCK_TRIANGLES = 1 << 14;
+
+    // Maps the file and builds the block index
+    bool open(const std::string& filename, const STLLoadControl* control = nullptr);
+
+    size_t triangleCount() const override { return order.size(); }
+    size_t blockCount() const override { return blockBounds.size(); }
+    const AABB& bounds() const override { return meshBounds; }
+    const AABB& blockBound(size_t b) const override { return blockBounds[b]; }
+
+    // The returned handle keeps the block alive even if it is evicted from
+    // the resident set meanwhile.
+    Block block(size_t b) override;
+    bool isResident(size_t b) const override;
+
+    void setResidentBudget(size_t bytes) { residentBlocks.setBudget(bytes); }
+    size_t residentBytes() const { return residentBlocks.residentBytes(); }
+
+private:
+    Triangle triangle(size_t i) const;
+
+    MappedFile file;
+    // Binary STL records, or the vertex/index sections of a .stlc cache
+    const char* records = nullptr;
+    const POINT* cacheVertices = nullptr;
+    const uint32_t* cacheIndices = nullptr;
+    size_t cacheVertexCount = 0;
+
+    std::vector<uint32_t> order; // Triangle ids in block order
+    std::vector<AABB> blockBounds;
+    AABB meshBounds;
+    ResidentBlocks residentBlocks{ size_t(1) << 30 };
+};
+
+#endif
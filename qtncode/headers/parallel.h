@@ -0,0 +1,138 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Number of worker threads used by the data-parallel loops below
+inline unsigned workerCount() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+// Threads shared by the loops below, started on first use and kept until
+// exit, so a loop pays for waking them instead of creating them. A loop is a
+// job of numbered chunks that the calling thread and the pool threads claim
+// one at a time. The caller keeps claiming chunks of its own job until none
+// is left and only then waits for those still running, so a loop nested in
+// a chunk makes progress even when every pool thread is busy.
+class WorkerPool {
+public:
+    // The pool has workerCount() - 1 threads; the caller of run() is the last worker
+    static WorkerPool& instance();
+    ~WorkerPool();
+
+    // Calls call(context, chunk) for every chunk in [0, chunks) and returns
+    // once all of them have finished
+    void run(size_t chunks, void (*call)(void*, size_t), void* context);
+
+private:
+    struct Job;
+    WorkerPool();
+    void work();
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::shared_ptr<Job>> jobs; // Jobs with unclaimed chunks, oldest first
+    std::vector<std::thread> threads;
+    bool stopping = false;
+};
+
+// Runs fn(chunk) for every chunk in [0, chunks) on the worker pool. The
+// calling thread takes part, so a single chunk runs on it directly. Chunks
+// may run one after another, so they must not wait for each other.
+template <typename Fn>
+void parallelChunks(size_t chunks, Fn fn) {
+    if (chunks == 0)
+        return;
+    if (chunks == 1) {
+        fn(size_t(0));
+        return;
+    }
+    WorkerPool::instance().run(chunks, [](void* f, size_t c) { (*static_cast<Fn*>(f))(c); }, &fn);
+}
+
+// Splits [0, count) into contiguous ranges of at least `grain` items, one
+// per worker at most, and calls fn(begin, end) for each range on the pool.
+template <typename Fn>
+void parallelFor(size_t count, size_t grain, Fn fn) {
+    if (count == 0)
+        return;
+    size_t chunks = std::min<size_t>(workerCount(), (count + grain - 1) / std::max<size_t>(grain, 1));
+    chunks = std::max<size_t>(chunks, 1);
+    size_t step = (count + chunks - 1) / chunks;
+    parallelChunks(chunks, [&](size_t c) {
+        size_t begin = c * step;
+        size_t end = std::min(count, begin + step);
+        if (begin < end)
+            fn(begin, end);
+    });
+}
+
+// Runs fn(task) for every task in [0, count) on up to workerCount() pool
+// workers with work stealing. Each worker starts on its own contiguous run of tasks
+// and takes them from the front; a worker that runs dry steals the back half
+// of the largest remaining run. Suits tasks of very uneven cost. Which thread
+// runs a task is up to scheduling, so results should be stored per task.
+template <typename Fn>
+void parallelTasks(size_t count, Fn fn) {
+    if (count == 0)
+        return;
+    struct alignas(64) Run {
+        std::mutex lock;
+        size_t begin = 0, end = 0;
+    };
+    size_t workers = std::min<size_t>(workerCount(), count);
+    std::unique_ptr<Run[]> runs(new Run[workers]);
+    for (size_t w = 0; w < workers; ++w) {
+        runs[w].begin = count * w / workers;
+        runs[w].end = count * (w + 1) / workers;
+    }
+
+    parallelChunks(workers, [&](size_t self) {
+        Run& own = runs[self];
+        for (;;) {
+            size_t task;
+            {
+                std::lock_guard<std::mutex> guard(own.lock);
+                task = own.begin < own.end ? own.begin++ : count;
+            }
+            if (task < count) {
+                fn(task);
+                continue;
+            }
+            // Own run exhausted: steal the back half of the largest one
+            size_t victim = workers, largest = 0;
+            for (size_t w = 0; w < workers; ++w) {
+                std::lock_guard<std::mutex> guard(runs[w].lock);
+                if (runs[w].end - runs[w].begin > largest) {
+                    largest = runs[w].end - runs[w].begin;
+                    victim = w;
+                }
+            }
+            if (victim == workers)
+                return;
+            size_t stolenBegin, stolenEnd;
+            {
+                std::lock_guard<std::mutex> guard(runs[victim].lock);
+                size_t left = runs[victim].end - runs[victim].begin;
+                if (left == 0)
+                    continue;
+                stolenEnd = runs[victim].end;
+                stolenBegin = stolenEnd - (left + 1) / 2;
+                runs[victim].end = stolenBegin;
+            }
+            std::lock_guard<std::mutex> guard(own.lock);
+            own.begin = stolenBegin;
+            own.end = stolenEnd;
+        }
+    });
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef POLYLINE_H
+#define POLYLINE_H
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include "point.h"
+
+// Connected run of intersection segments
+struct Polyline {
+    std::vector<POINT> points;
+    bool closed = false; // The last point joins back to the first
+};
+
+// Summary of one chainSegments() call
+struct PolylineStats {
+    size_t loops = 0;      // Closed polylines
+    size_t open = 0;       // Polylines with two free ends
+    size_t vertices = 0;   // Distinct endpoints after welding
+    size_t dropped = 0;    // Segments that repeated another or collapsed to a point
+    double length = 0.0;   // Summed over all polylines
+};
+
+// Stitches unordered segments into polylines. Endpoints closer than
+// `tolerance` are welded through a grid hash with tolerance-sized cells
+// (0 picks 1e-5 of the segments' largest extent), repeated segments are
+// merged, and chains are followed through vertices shared by exactly two
+// segments. Vertices where three or more segments meet end the polylines
+// passing through them. The output order depends only on the input order.
+PolylineStats chainSegments(const std::vector<std::pair<POINT, POINT>>& segments,
+                            std::vector<Polyline>& polylines, float tolerance = 0.0f);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef PREDICATES_H
+#define PREDICATES_H
+
+#include "point.h"
+
+// Geometric orientation tests whose sign is always exact. Each first
+// evaluates the determinant in double precision and accepts the result when
+// it exceeds an error bound derived from the operands (a semi-static filter,
+// after Shewchuk). Only when the filter cannot decide is the determinant
+// recomputed exactly with floating-point expansions, so the common case costs
+// about as much as the plain formula.
+
+// Positive if a, b, c wind counterclockwise, negative if clockwise, zero if
+// they are collinear
+double orient2d(double ax, double ay, double bx, double by, double cx, double cy);
+// Same on the x and y coordinates of the points
+double orient2d(const POINT& a, const POINT& b, const POINT& c);
+
+// Positive if d lies below the plane through a, b, c (a, b, c appear
+// counterclockwise seen from above), negative if above, zero if the four
+// points are coplanar
+double orient3d(const POINT& a, const POINT& b, const POINT& c, const POINT& d);
+
+// Positive if q lies further than p in the direction from a to b, negative
+// if it lies less far, zero if they are level (the sign of (q - p) . (b - a))
+double alongLine(const POINT& a, const POINT& b, const POINT& p, const POINT& q);
+
+#endif
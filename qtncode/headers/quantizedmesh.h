@@ -0,0 +1,74 @@
+#ifndef QUANTIZEDMESH_H
+#define QUANTIZEDMESH_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "blockedmesh.h"
+#include "indexedmesh.h"
+
+// Compressed in-memory mesh. Vertex positions are quantized to 16 or 21 bits
+// per axis relative to the mesh bounding box (an error of half a grid step
+// per axis, plus float rounding), and each block of triangles stores its
+// indices as zigzag varints of the difference to the previous index. A welded
+// mesh takes about 8 bytes per triangle this way against 36 for a soup.
+//
+// Blocks are decoded on demand into a least-recently-used set bounded by a
+// byte budget. While the whole decoded mesh fits the budget every block counts
+// as resident, so drawing decodes each block once; otherwise only the blocks
+// held are, and the rest are drawn as boxes instead of being decoded again on
+// every repaint.
+class QuantizedMesh : public BlockedMesh {
+public:
+    static const size_t BLOCK_TRIANGLES = 1 << 14;
+
+    // bits is 16 (positions in three uint16 arrays) or 21 (one uint64 per
+    // vertex); anything else is treated as 16
+    static QuantizedMesh encode(const IndexedMesh& mesh, int bits = 16);
+
+    int bits() const { return quantBits; }
+    size_t vertexCount() const { return vertices; }
+    size_t triangleCount() const override { return triangles; }
+    size_t blockCount() const override { return blockBounds.size(); }
+    const AABB& bounds() const override { return meshBounds; }
+    const AABB& blockBound(size_t b) const override { return blockBounds[b]; }
+
+    Block block(size_t b) override;
+    bool isResident(size_t b) const override;
+
+    void setResidentBudget(size_t bytes) { decodedBlocks.setBudget(bytes); }
+    size_t residentBytes() const { return decodedBlocks.residentBytes(); }
+
+    // Dequantizes vertices [begin, end) into separate coordinate arrays
+    void decodeVertices(size_t begin, size_t end, float* x, float* y, float* z) const;
+    POINT vertex(size_t i) const;
+    // Half a grid step per axis: the quantization error bound
+    POINT maxError() const { return POINT(step[0] / 2, step[1] / 2, step[2] / 2); }
+
+    std::vector<Triangle> toTriangles() const;
+    IndexedMesh toIndexedMesh() const;
+    // Bytes held by the compressed arrays, not counting decoded blocks
+    size_t memoryBytes() const;
+
+private:
+    void decodeIndices(size_t b, std::vector<uint32_t>& out) const;
+    void decodeBlock(size_t b, Triangle* out) const;
+
+    int quantBits = 16;
+    size_t vertices = 0;
+    size_t triangles = 0;
+    float origin[3] = { 0, 0, 0 };
+    float step[3] = { 0, 0, 0 };
+
+    std::vector<uint16_t> qx, qy, qz; // 16-bit positions
+    std::vector<uint64_t> packed;     // 21-bit positions: x | y << 21 | z << 42
+
+    std::vector<uint8_t> indexStream;
+    std::vector<size_t> blockOffsets; // Start of each block in indexStream, plus the end
+    std::vector<AABB> blockBounds;
+    AABB meshBounds;
+
+    ResidentBlocks decodedBlocks{ size_t(256) << 20 };
+};
+
+#endif
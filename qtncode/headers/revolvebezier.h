@@ -5,12 +5,17 @@
 #include <QOpenGLFunctions>
 #include <QPushButton>
 #include <QMatrix4x4>
+#include <vector>
+#include "triangle.h"
  
 class BezierWidget : public QOpenGLWidget, protected QOpenGLFunctions {
     Q_OBJECT
  
 public:
     BezierWidget(QWidget *parent = nullptr);
+
+    // Two triangles per quad of the surface of revolution
+    std::vector<Triangle> revolutionTriangles() const;
  
 protected:
     void initializeGL() override;
@@ -27,6 +32,7 @@ private:
     QVector<QVector<QVector3D>> revolutionMesh;
  
     QPushButton *revolveButton;
+    QPushButton *exportButton;
     int draggedPointIndex = -1;
  
     void computeBezierCurve();
@@ -35,6 +41,7 @@ private:
     QVector3D rotatePointAroundAxis(const QVector3D &point, float angle, const QVector3D &axis);
     void drawRevolutionAxis();
     void handleRightClick();
+    void exportRevolution();
     QPointF mapToOpenGLCoordinates(const QPoint &mousePos);
 };
  
@@ -0,0 +1,93 @@
+#ifndef SOAMESH_H
+#define SOAMESH_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include "triangle.h"
+#include "bvh.h"
+
+// Allocator handing out 64-byte (cache line / AVX-512) aligned storage
+template <typename T>
+struct AlignedAllocator {
+    using value_type = T;
+    static const size_t alignment = 64;
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignment)));
+    }
+    void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t(alignment)); }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+class TriangleSoA;
+
+// Lightweight accessor for one triangle of a TriangleSoA. Converts to a
+// Triangle so code written against the array-of-structs layout keeps working.
+class TriangleView {
+public:
+    TriangleView(const TriangleSoA& mesh, size_t index) : mesh(&mesh), i(index) {}
+
+    POINT vertex(int k) const;
+    POINT p1() const { return vertex(0); }
+    POINT p2() const { return vertex(1); }
+    POINT p3() const { return vertex(2); }
+    AABB bounds() const;
+    size_t index() const { return i; }
+
+    operator Triangle() const { return Triangle(p1(), p2(), p3()); }
+
+private:
+    const TriangleSoA* mesh;
+    size_t i;
+};
+
+// Structure-of-arrays triangle storage. Corner k of triangle i lives at
+// x[k][i], y[k][i], z[k][i]; every array is 64-byte aligned so kernels can
+// stream over one coordinate at a time. Per-triangle bounds and the plane
+// n.p + d = 0 (n not normalized, as in trianglesCoplanar) are precomputed.
+class TriangleSoA {
+public:
+    AlignedVector<float> x[3], y[3], z[3];
+    AlignedVector<float> minX, minY, minZ, maxX, maxY, maxZ;
+    AlignedVector<float> nx, ny, nz, d;
+
+    TriangleSoA() = default;
+    explicit TriangleSoA(const std::vector<Triangle>& triangles) { build(triangles); }
+
+    // Fills all arrays from a triangle soup, in parallel for large inputs
+    void build(const std::vector<Triangle>& triangles);
+    void clear();
+
+    size_t size() const { return x[0].size(); }
+    bool empty() const { return x[0].empty(); }
+    TriangleView operator[](size_t i) const { return TriangleView(*this, i); }
+
+    // Appends the indices of all triangles whose bounds overlap box
+    void overlapping(const AABB& box, std::vector<uint32_t>& out) const;
+};
+
+inline POINT TriangleView::vertex(int k) const {
+    return POINT(mesh->x[k][i], mesh->y[k][i], mesh->z[k][i]);
+}
+
+inline AABB TriangleView::bounds() const {
+    AABB box;
+    box.min = POINT(mesh->minX[i], mesh->minY[i], mesh->minZ[i]);
+    box.max = POINT(mesh->maxX[i], mesh->maxY[i], mesh->maxZ[i]);
+    return box;
+}
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef SPATIALHASH_H
+#define SPATIALHASH_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include "triangle.h"
+#include "bvh.h"
+
+// Broad phase that bins the triangle boxes of two meshes into a uniform grid
+// of cubic cells. Only the region where the meshes' bounds overlap is
+// gridded; triangles outside it cannot meet the other mesh and are dropped.
+// Occupied cells are kept as a sorted list of (cell, triangle) entries rather
+// than a dense array, so empty space costs nothing. Suits meshes with fairly
+// uniform triangle sizes; a BVH copes better with widely varying ones.
+class UniformGrid {
+public:
+    // Cells are 21 bits per axis in the packed cell key
+    static const uint32_t MAX_CELLS_PER_AXIS = 1u << 21;
+
+    // cellSize <= 0 picks the mean of the largest box extent of the triangles
+    void build(const std::vector<Triangle>& a, const std::vector<Triangle>& b, float cellSize = 0.0f);
+
+    float cellSize() const { return cell; }
+    size_t entryCount() const { return entries.size(); }
+
+    // Calls fn(indexA, indexB) once for every pair of triangles whose boxes
+    // overlap. A pair sharing several cells is only reported from the cell
+    // holding the minimum corner of the boxes' intersection. Restricting the
+    // scan to entries [first, last) covers the cells starting in that range,
+    // so adjacent ranges split the pairs between them without overlap.
+    template <typename Fn>
+    void forEachCandidatePair(Fn fn, size_t first = 0, size_t last = SIZE_MAX) const;
+
+private:
+    // Triangles of mesh B have this bit set in Entry::index
+    static const uint32_t MESH_B = 1u << 31;
+
+    struct Entry {
+        uint64_t cell;
+        uint32_t index;
+        bool operator<(const Entry& e) const { return cell != e.cell ? cell < e.cell : index < e.index; }
+    };
+
+    uint32_t cellCoordinate(float v, int axis) const {
+        float origin = axis == 0 ? domain.min.x : (axis == 1 ? domain.min.y : domain.min.z);
+        float c = std::floor((v - origin) * inverseCell);
+        return c <= 0.0f ? 0u : (c >= float(MAX_CELLS_PER_AXIS - 1) ? MAX_CELLS_PER_AXIS - 1 : uint32_t(c));
+    }
+    uint64_t cellKey(const POINT& p) const {
+        return uint64_t(cellCoordinate(p.x, 0)) | uint64_t(cellCoordinate(p.y, 1)) << 21 |
+               uint64_t(cellCoordinate(p.z, 2)) << 42;
+    }
+
+    AABB domain;
+    float cell = 0.0f;
+    float inverseCell = 0.0f;
+    std::vector<AABB> boxesA, boxesB;
+    std::vector<Entry> entries; // Sorted; per cell the A entries come first
+};
+
+template <typename Fn>
+void UniformGrid::forEachCandidatePair(Fn fn, size_t first, size_t last) const {
+    // Move both ends forward to the start of a cell
+    auto cellStart = [this](size_t i) {
+        i = std::min(i, entries.size());
+        while (i > 0 && i < entries.size() && entries[i].cell == entries[i - 1].cell)
+            ++i;
+        return i;
+    };
+    size_t begin = cellStart(first);
+    last = cellStart(last);
+    while (begin < last) {
+        uint64_t key = entries[begin].cell;
+        size_t splitB = begin, end = begin;
+        while (end < entries.size() && entries[end].cell == key) {
+            if (!(entries[end].index & MESH_B))
+                splitB = end + 1;
+            ++end;
+        }
+        for (size_t i = begin; i < splitB; ++i) {
+            const AABB& boxA = boxesA[entries[i].index];
+            for (size_t j = splitB; j < end; ++j) {
+                uint32_t indexB = entries[j].index & ~MESH_B;
+                const AABB& boxB = boxesB[indexB];
+                if (!boxA.overlaps(boxB))
+                    continue;
+                POINT corner(std::max(boxA.min.x, boxB.min.x), std::max(boxA.min.y, boxB.min.y),
+                             std::max(boxA.min.z, boxB.min.z));
+                if (cellKey(corner) == key)
+                    fn(entries[i].index, indexB);
+            }
+        }
+        begin = end;
+    }
+}
+
+#endif
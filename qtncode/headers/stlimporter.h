@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "triangle.h"
+#include "stlparser.h"
+#include "indexedmesh.h"
+#include "meshset.h"
+
+// Loads STL (optionally gzipped), OBJ and PLY files on a thread pool so the
+// GUI stays responsive. Every file of a batch is a job of its own and runs
+// concurrently with the others; meshLoaded() is emitted on the GUI thread as
+// each one completes and its mesh can then be moved out with takeMesh().
+// progressChanged() reports the whole batch. A cache next to each file
+// (name + "c") is used when it is newer than the file. Otherwise it is
+// written once the mesh has been handed over; cancel() stops that as well.
+class STLImporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit STLImporter(QObject *parent = nullptr);
+    ~STLImporter();
+
+    enum Storage
+    {
+        InMemory,  // Plain triangle soup
+        OutOfCore, // Map the file and page it in blocks instead of loading it
+        Compact16, // Weld and quantize to 16 bits per axis
+        Compact21  // Weld and quantize to 21 bits per axis
+    };
+
+    bool start(const QStringList &fileNames, Storage storage = InMemory);
+    bool start(const QString &fileName, Storage storage = InMemory) { return start(QStringList{fileName}, storage); }
+    // Sort in-memory and compact meshes along the Morton curve after loading
+    // (out-of-core meshes always page their blocks in that order)
+    void setSpatialReorder(bool enabled) { spatialReorder = enabled; }
+    void cancel();
+    bool isRunning() const { return remaining > 0; }
+
+    int jobCount() const { return int(jobs.size()); }
+    QString fileName(int job) const { return jobs[job].fileName; }
+    std::unique_ptr<MeshEntry> takeMesh(int job);
+
+signals:
+    void progressChanged(int percent);
+    void meshLoaded(int job, bool ok);
+    // Emitted once the whole batch is done; loaded counts the successful jobs
+    void finished(int loaded, bool cancelled);
+
+private:
+    struct Job
+    {
+        QString fileName;
+        std::unique_ptr<MeshEntry> mesh;
+        bool ok = false;
+        std::atomic<int> permille{0};
+    };
+
+    void runJob(int job, Storage storage, bool reorder);
+    void jobDone(int job);
+    void reportProgress();
+
+    QThreadPool pool;
+    std::vector<Job> jobs;
+    int remaining = 0;
+    int loaded = 0;
+    bool spatialReorder = false;
+    std::atomic<bool> cancelRequested{false};
+    std::atomic<int> lastPercent{-1};
+};
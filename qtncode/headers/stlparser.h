@@ -3,8 +3,39 @@
 
 #include <vector>
 #include <string>
+#include <cstddef>
+#include <atomic>
+#include <functional>
 #include "triangle.h"
 
-bool loadSTLFile(const std::string& filename, std::vector<Triangle>& triangles);
+// Optional hooks for long-running loads. progress receives the fraction done
+// (0..1) and may be called from parser worker threads. Loading stops early
+// and returns false once *cancel becomes true.
+struct STLLoadControl {
+    std::function<void(float)> progress;
+    const std::atomic<bool>* cancel = nullptr;
+
+    bool cancelled() const { return cancel && cancel->load(std::memory_order_relaxed); }
+    void report(float fraction) const { if (progress) progress(fraction); }
+};
+
+// Loads a binary or ASCII STL; names ending in ".gz" go through loadGzipSTL
+bool loadSTLFile(const std::string& filename, std::vector<Triangle>& triangles,
+                 const STLLoadControl* control = nullptr);
+
+// Binary STL: 80-byte header, uint32 facet count, then 50-byte facet records
+// (normal, three vertices, uint16 attribute byte count), all little endian.
+// Returns true if the buffer looks like a binary STL (header + facet count check).
+bool isBinarySTL(const char* data, size_t size);
+// Decodes the facet records of a binary STL buffer straight into triangles
+bool loadBinarySTL(const char* data, size_t size, std::vector<Triangle>& triangles,
+                   const STLLoadControl* control = nullptr);
+// Parses an ASCII STL buffer in facet-aligned chunks, one worker thread per chunk
+bool loadAsciiSTL(const char* data, size_t size, std::vector<Triangle>& triangles,
+                  const STLLoadControl* control = nullptr);
+// Streams a gzip-compressed STL: a GzipReader thread inflates the file while
+// this thread parses the chunks it queues, without a temporary file
+bool loadGzipSTL(const std::string& filename, std::vector<Triangle>& triangles,
+                 const STLLoadControl* control = nullptr);
 
 #endif
@@ -7,6 +7,13 @@
 #include <QMatrix4x4>
 #include <QMouseEvent>
 #include <QWheelEvent>
+#include <QThreadPool>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "point.h"
+#include "intersection.h"
+#include "polyline.h"
 
 class STLWidget : public QOpenGLWidget, protected QOpenGLFunctions
 {
@@ -14,6 +21,32 @@ class STLWidget : public QOpenGLWidget, protected QOpenGLFunctions
 public:
     explicit STLWidget(QWidget *parent = nullptr);
     ~STLWidget();
+
+    // Segments of the current intersection pair; empty until
+    // computeIntersection() has run for it
+    const std::vector<std::pair<POINT, POINT>>& segments() const;
+    // The same segments chained into polylines, and their loop count and length
+    const std::vector<Polyline>& polylines() const;
+    const PolylineStats& polylineStats() const { return intersectionStats; }
+    // Timings and candidate count of the last full computation over in-memory
+    // meshes (left as they were by drag steps that reused the candidates)
+    const BroadPhaseStats& broadPhaseStats() const { return broadPhaseTimes; }
+    // Intersects meshes A and B of meshSet on a background thread unless the
+    // stored result is already for their current geometry, placement and
+    // broad phase; intersectionReady() is emitted once it is. A call made
+    // while a computation runs is taken up when that one ends, for whatever
+    // the pair and placement are by then. Repaints only ever draw the stored
+    // segments. Once a pair has been intersected, moving mesh B with the
+    // mouse (right-drag translates, Shift+drag rotates) recomputes it
+    // incrementally, skipping the steps made while a computation ran. Drag
+    // steps always go through RigidIntersection, also with the grid selected.
+    void computeIntersection();
+    bool isComputing() const { return computing; }
+    // Broad phase used for in-memory meshes by the next computation
+    void setBroadPhase(BroadPhase phase);
+signals:
+    // The stored result is now the one for the current pair and placement
+    void intersectionReady();
 protected:
     void initializeGL() override;
     void resizeGL(int w, int h) override;
@@ -29,6 +62,47 @@ private:
     QMatrix4x4 projection;
     QMatrix4x4 view;
     QMatrix4x4 model;
+    // What the stored segments were computed from
+    struct IntersectionKey {
+        uint64_t idA = 0, revisionA = 0, idB = 0, revisionB = 0;
+        RigidTransform placeA, placeB;
+        BroadPhase phase = BroadPhase::Tree;
+        bool sameGeometry(const IntersectionKey& k) const {
+            return idA == k.idA && revisionA == k.revisionA && idB == k.idB && revisionB == k.revisionB;
+        }
+        bool operator==(const IntersectionKey& k) const {
+            return sameGeometry(k) && placeA == k.placeA && placeB == k.placeB && phase == k.phase;
+        }
+    };
+    IntersectionKey currentKey() const;
+    // What a computation produces; handed back to the GUI thread as a whole
+    struct IntersectionResult {
+        IntersectionKey key;
+        std::vector<std::pair<POINT, POINT>> segments;
+        std::vector<Polyline> polylines;
+        PolylineStats stats;
+        BroadPhaseStats broadPhase;
+        bool measured = false; // broadPhase holds a full in-memory computation
+    };
+    void startIntersection(const IntersectionKey& key);
+    void storeIntersection(IntersectionResult& result);
+    // Moves mesh B by a mouse drag in the view plane
+    void dragMeshB(int dx, int dy, bool rotate);
+
+    std::vector<std::pair<POINT, POINT>> intersectionSegments;
+    std::vector<Polyline> intersectionPolylines;
+    PolylineStats intersectionStats;
+    BroadPhaseStats broadPhaseTimes;
+    IntersectionKey intersectionKey;
+    // Hierarchies and candidates of the pair, kept while mesh B is dragged.
+    // Only the running computation touches it.
+    RigidIntersection rigidIntersection;
+    // Runs one computation at a time
+    QThreadPool intersectionPool;
+    bool computing = false;
+    IntersectionKey computingKey;
+    POINT dragCenter; // Mesh B's own-frame center, taken when a drag starts
+    BroadPhase broadPhase = BroadPhase::Tree;
 };
 
 #endif
\ No newline at end of file
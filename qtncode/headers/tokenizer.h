@@ -0,0 +1,123 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+// Zero-copy tokenizer over a text buffer (typically a MappedFile). Tokens are
+// string_views into the buffer and numbers are parsed in place with
+// std::from_chars, so no per-line or per-token strings are allocated.
+// Shared by the ASCII STL, OBJ and PLY readers.
+class Tokenizer {
+public:
+    Tokenizer(const char* begin, const char* end) : p(begin), end(end) {}
+
+    static bool isSpace(char c) {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\v';
+    }
+    static bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v'; }
+
+    const char* position() const { return p; }
+    void seek(const char* position) { p = position; }
+    bool atEnd() const { return p >= end; }
+
+    // Skips all whitespace, line ends included
+    void skipSpace() {
+        while (p < end && isSpace(*p)) ++p;
+    }
+    // Skips whitespace up to (not past) the end of the current line
+    void skipBlanks() {
+        while (p < end && isBlank(*p)) ++p;
+    }
+    bool atLineEnd() {
+        skipBlanks();
+        return p >= end || *p == '\n';
+    }
+    // Moves past the next line end
+    void skipLine() {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+        p = nl ? nl + 1 : end;
+    }
+
+    // Next whitespace-delimited token, crossing line ends; empty at the end
+    std::string_view token() {
+        skipSpace();
+        return word();
+    }
+    // Next token on the current line; empty at the line end
+    std::string_view lineToken() {
+        skipBlanks();
+        return word();
+    }
+
+    // Parses a number at the current position (after blanks on this line).
+    // Floats too large for the type become +-inf and ones too small become 0
+    // (as with strtod), so that denormal input keeps its element. Integers
+    // out of range fail to parse.
+    bool number(float& value) { return parse(value); }
+    bool number(double& value) { return parse(value); }
+    bool number(long long& value) { return parse(value); }
+
+private:
+    std::string_view word() {
+        const char* start = p;
+        while (p < end && !isSpace(*p)) ++p;
+        return std::string_view(start, size_t(p - start));
+    }
+
+    template <typename T>
+    bool parse(T& value) {
+        skipBlanks();
+        if (p < end && *p == '+') ++p; // from_chars does not accept a leading '+'
+        auto result = std::from_chars(p, end, value);
+        if (result.ec == std::errc::invalid_argument)
+            return false;
+        if (result.ec == std::errc::result_out_of_range) {
+            if (!std::is_floating_point<T>::value)
+                return false;
+            if (!tooLarge(p, result.ptr))
+                value = T(0);
+            else
+                value = *p == '-' ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::infinity();
+        }
+        p = result.ptr;
+        return true;
+    }
+
+    // Whether the decimal number in [start, stop) is at least 1 in
+    // magnitude, from the place of its first significant digit and its
+    // exponent. Only asked about numbers out of range, which are far from 1.
+    static bool tooLarge(const char* start, const char* stop) {
+        long long place = 0; // Of the first significant digit: 1 for units, 0 for tenths
+        bool point = false, significant = false;
+        const char* s = start + (start < stop && *start == '-');
+        for (; s < stop && *s != 'e' && *s != 'E'; ++s) {
+            if (*s == '.') {
+                point = true;
+            } else if (!significant) {
+                significant = *s != '0';
+                if (significant ? !point : point)
+                    place += significant ? 1 : -1;
+            } else if (!point) {
+                ++place;
+            }
+        }
+        long long exponent = 0;
+        if (s < stop) {
+            ++s;
+            if (s < stop && *s == '+') ++s;
+            if (std::from_chars(s, stop, exponent).ec == std::errc::result_out_of_range)
+                return *s != '-';
+        }
+        return place + exponent > 0;
+    }
+
+    const char* p;
+    const char* end;
+};
+
+#endif
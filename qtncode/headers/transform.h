@@ -0,0 +1,71 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <cmath>
+#include "triangle.h"
+#include "bvh.h"
+
+// Rigid motion p -> r * p + t (rotation matrix r, row-major, and translation t)
+struct RigidTransform {
+    float r[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+    POINT t = POINT(0, 0, 0);
+
+    POINT rotate(const POINT& v) const {
+        return POINT(r[0][0] * v.x + r[0][1] * v.y + r[0][2] * v.z,
+                     r[1][0] * v.x + r[1][1] * v.y + r[1][2] * v.z,
+                     r[2][0] * v.x + r[2][1] * v.y + r[2][2] * v.z);
+    }
+    POINT apply(const POINT& p) const {
+        POINT q = rotate(p);
+        return POINT(q.x + t.x, q.y + t.y, q.z + t.z);
+    }
+    Triangle apply(const Triangle& tri) const { return Triangle(apply(tri.p1), apply(tri.p2), apply(tri.p3)); }
+
+    bool isIdentity() const { return *this == RigidTransform(); }
+    bool operator==(const RigidTransform& o) const {
+        for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 3; ++j)
+                if (r[i][j] != o.r[i][j])
+                    return false;
+        return t.x == o.t.x && t.y == o.t.y && t.z == o.t.z;
+    }
+    bool operator!=(const RigidTransform& o) const { return !(*this == o); }
+
+    RigidTransform inverse() const {
+        RigidTransform m;
+        for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 3; ++j)
+                m.r[i][j] = r[j][i];
+        POINT u = m.rotate(t);
+        m.t = POINT(-u.x, -u.y, -u.z);
+        return m;
+    }
+
+    // Column-major 4x4 matrix for glMultMatrixf
+    void toMatrix(float m[16]) const {
+        for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 3; ++j)
+                m[4 * j + i] = r[i][j];
+        m[3] = m[7] = m[11] = 0;
+        m[12] = t.x; m[13] = t.y; m[14] = t.z; m[15] = 1;
+    }
+
+    static RigidTransform translation(const POINT& d) {
+        RigidTransform m;
+        m.t = d;
+        return m;
+    }
+    // Rotation by angle (radians) about the axis through the origin
+    static RigidTransform rotation(const POINT& axis, float angle);
+};
+
+// Applies b first, then a. The rotation is re-orthonormalized so that long
+// chains of small steps (mouse drags) stay rigid.
+RigidTransform operator*(const RigidTransform& a, const RigidTransform& b);
+
+// Box around the moved corners of box, rounded outward so it also holds
+// every point of box as m.apply() places it in float (box itself for the
+// identity)
+AABB transformedBounds(const AABB& box, const RigidTransform& m);
+
+#endif
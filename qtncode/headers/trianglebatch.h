@@ -0,0 +1,40 @@
+#ifndef TRIANGLEBATCH_H
+#define TRIANGLEBATCH_H
+
+#include <cstdint>
+#include "triangle.h"
+
+// Up to WIDTH candidate triangles transposed into lanes (corner k of
+// candidate i at x[k][i], y[k][i], z[k][i]) so one triangle can be tested
+// against all of them with a single pass of vector instructions
+struct TriangleBatch {
+    static const int WIDTH = 16;
+
+    alignas(64) float x[3][WIDTH] = {};
+    alignas(64) float y[3][WIDTH] = {};
+    alignas(64) float z[3][WIDTH] = {};
+    int count = 0;
+
+    bool full() const { return count == WIDTH; }
+    void clear() { count = 0; }
+    void add(const Triangle& t) {
+        x[0][count] = t.p1.x; y[0][count] = t.p1.y; z[0][count] = t.p1.z;
+        x[1][count] = t.p2.x; y[1][count] = t.p2.y; z[1][count] = t.p2.z;
+        x[2][count] = t.p3.x; y[2][count] = t.p3.y; z[2][count] = t.p3.z;
+        ++count;
+    }
+};
+
+// Möller's plane-side rejection of a whole batch: a candidate is dropped when
+// all its corners lie strictly on one side of tri's plane, or all of tri's
+// corners strictly on one side of the candidate's plane. Bit i of the result
+// is set for every candidate that survives and needs the exact test. The
+// margins cover the rounding of the float distances, so no pair
+// intersectTrianglePair() would report (coplanar ones included) is dropped.
+uint32_t planeSideSurvivors(const Triangle& tri, const TriangleBatch& batch);
+
+// Instruction set planeSideSurvivors() runs on, picked once at startup
+// ("AVX-512", "AVX2" or "SSE2"/"generic" as the baseline)
+const char* triangleBatchKernel();
+
+#endif
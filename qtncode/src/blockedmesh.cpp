@@ -0,0 +1,136 @@
+#include "blockedmesh.h"
+#include "intersection.h"
+#include "parallel.h"
+
+ResidentBlocks::ResidentBlocks(ResidentBlocks&& other) {
+    std::lock_guard<std::mutex> lock(other.mutex);
+    budget = other.budget;
+    resident = other.resident;
+    lru = std::move(other.lru); // Iterators in the index stay valid
+    index = std::move(other.index);
+    other.resident = 0;
+    other.lru.clear();
+    other.index.clear();
+}
+
+BlockedMesh::Block ResidentBlocks::find(size_t b) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(b);
+    if (it == index.end())
+        return nullptr;
+    lru.splice(lru.begin(), lru, it->second);
+    return it->second->second;
+}
+
+BlockedMesh::Block ResidentBlocks::insert(size_t b, BlockedMesh::Block decoded) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(b);
+    if (it != index.end())
+        return it->second->second; // Another thread won the race
+    lru.emplace_front(b, decoded);
+    index[b] = lru.begin();
+    resident += decoded->size() * sizeof(Triangle);
+    evict();
+    return decoded;
+}
+
+bool ResidentBlocks::contains(size_t b) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return index.count(b) != 0;
+}
+
+void ResidentBlocks::setBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    budget = bytes;
+    evict();
+}
+
+size_t ResidentBlocks::budgetBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return budget;
+}
+
+size_t ResidentBlocks::residentBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return resident;
+}
+
+// Caller holds the mutex
+void ResidentBlocks::evict() {
+    while (resident > budget && lru.size() > 1) {
+        resident -= lru.back().second->size() * sizeof(Triangle);
+        index.erase(lru.back().first);
+        lru.pop_back();
+    }
+}
+
+// Triangles of block whose bounds overlap box
+static std::vector<Triangle> trianglesIn(const std::vector<Triangle>& block, const AABB& box) {
+    std::vector<Triangle> out;
+    for (const Triangle& t : block)
+        if (triangleBounds(t).overlaps(box))
+            out.push_back(t);
+    return out;
+}
+
+// Runs runTask(task, buffer) for every task on the work-stealing pool and
+// appends the buffers to segments in task order
+template <typename Fn>
+static void collectBlockSegments(size_t tasks, std::vector<std::pair<POINT, POINT>>& segments, Fn runTask) {
+    std::vector<std::vector<std::pair<POINT, POINT>>> buffers(tasks);
+    parallelTasks(tasks, [&](size_t task) { runTask(task, buffers[task]); });
+    for (const auto& buffer : buffers)
+        segments.insert(segments.end(), buffer.begin(), buffer.end());
+}
+
+void intersectBlocked(BlockedMesh& a, BlockedMesh& b, std::vector<std::pair<POINT, POINT>>& segments) {
+    std::vector<size_t> blocksA;
+    for (size_t ia = 0; ia < a.blockCount(); ++ia)
+        if (a.blockBound(ia).overlaps(b.bounds()))
+            blocksA.push_back(ia);
+    // Blocks of b overlapping each of those
+    std::vector<std::vector<size_t>> partners(blocksA.size());
+    parallelFor(blocksA.size(), 16, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k)
+            for (size_t ib = 0; ib < b.blockCount(); ++ib)
+                if (a.blockBound(blocksA[k]).overlaps(b.blockBound(ib)))
+                    partners[k].push_back(ib);
+    });
+    // One task per block of a. Trees are built only over the triangles of
+    // either block inside the other's bounds: blocks are spatially coherent,
+    // so where two meet is usually a thin slice of each.
+    collectBlockSegments(blocksA.size(), segments, [&](size_t k, std::vector<std::pair<POINT, POINT>>& out) {
+        if (partners[k].empty())
+            return;
+        BlockedMesh::Block blockA = a.block(blocksA[k]);
+        BVH bvhA, bvhB;
+        for (size_t ib : partners[k]) {
+            std::vector<Triangle> nearA = trianglesIn(*blockA, b.blockBound(ib));
+            std::vector<Triangle> nearB = trianglesIn(*b.block(ib), a.blockBound(blocksA[k]));
+            if (nearA.empty() || nearB.empty())
+                continue;
+            bvhA.build(nearA, false, BVH::Split::Median);
+            bvhB.build(nearB, false, BVH::Split::Median);
+            intersectMeshesSerial(nearA, bvhA, nearB, bvhB, out);
+        }
+    });
+}
+
+void intersectBlocked(BlockedMesh& a, const std::vector<Triangle>& b, std::vector<std::pair<POINT, POINT>>& segments) {
+    if (b.empty())
+        return;
+    BVH bvhB;
+    bvhB.build(b);
+    std::vector<size_t> blocksA;
+    for (size_t ia = 0; ia < a.blockCount(); ++ia)
+        if (a.blockBound(ia).overlaps(bvhB.nodes[0].bounds))
+            blocksA.push_back(ia);
+    collectBlockSegments(blocksA.size(), segments, [&](size_t k, std::vector<std::pair<POINT, POINT>>& out) {
+        std::vector<Triangle> nearA = trianglesIn(*a.block(blocksA[k]), bvhB.nodes[0].bounds);
+        if (nearA.empty())
+            return;
+        BVH bvhA;
+        bvhA.build(nearA, false, BVH::Split::Median);
+        intersectMeshesSerial(nearA, bvhA, b, bvhB, out);
+    });
+}
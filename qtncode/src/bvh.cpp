@@ -0,0 +1,268 @@
+#include "bvh.h"
+#include "parallel.h"
+#include <atomic>
+
+AABB triangleBounds(const Triangle& t) {
+    AABB box;
+    box.expand(t.p1);
+    box.expand(t.p2);
+    box.expand(t.p3);
+    return box;
+}
+
+static float axisOf(const POINT& p, int axis) {
+    return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+}
+
+struct BVHBuildData {
+    std::vector<AABB> boxes;
+    std::vector<POINT> centroids;
+    std::vector<uint32_t>& primitives;
+    BVH::Split split;
+};
+
+struct BuildTask { uint32_t node, begin, end; };
+
+// Bounds of a range of primitives and of their centroids
+struct RangeBounds {
+    AABB bounds, centroids;
+    void merge(const RangeBounds& r) {
+        if (!r.bounds.empty()) {
+            bounds.expand(r.bounds);
+            centroids.expand(r.centroids);
+        }
+    }
+};
+
+// SAH bins of a range along all three axes
+struct RangeBins {
+    AABB bounds[3][BVH::SAH_BINS];
+    uint32_t counts[3][BVH::SAH_BINS] = {};
+    void merge(const RangeBins& r) {
+        for (int axis = 0; axis < 3; ++axis)
+            for (int k = 0; k < BVH::SAH_BINS; ++k)
+                if (r.counts[axis][k]) {
+                    bounds[axis][k].expand(r.bounds[axis][k]);
+                    counts[axis][k] += r.counts[axis][k];
+                }
+    }
+};
+
+// Runs fn(begin, end, partial) over [begin, end), in one chunk per worker when
+// `parallel` is set, and merges the partial results
+template <typename T, typename Fn>
+static T reduceRange(uint32_t begin, uint32_t end, bool parallel, Fn fn) {
+    T total;
+    if (!parallel) {
+        fn(begin, end, total);
+        return total;
+    }
+    size_t chunks = workerCount();
+    size_t step = (end - begin + chunks - 1) / chunks;
+    std::vector<T> partial(chunks);
+    parallelChunks(chunks, [&](size_t c) {
+        size_t b = begin + c * step;
+        size_t e = std::min<size_t>(end, b + step);
+        if (b < e)
+            fn(uint32_t(b), uint32_t(e), partial[c]);
+    });
+    for (const T& p : partial)
+        total.merge(p);
+    return total;
+}
+
+static int binOf(float centroid, float lo, float scale) {
+    return std::min(BVH::SAH_BINS - 1, std::max(0, int((centroid - lo) * scale)));
+}
+
+// Sets the bounds of the node over [begin, end). Returns false if it should be
+// a leaf, otherwise partitions the range at the cheapest of the binned split
+// planes (or at the centroid median) and returns the split position in `mid`.
+static bool splitNode(BVHBuildData& d, uint32_t begin, uint32_t end, bool parallel, AABB& bounds, uint32_t& mid) {
+    RangeBounds rb = reduceRange<RangeBounds>(begin, end, parallel, [&](uint32_t b, uint32_t e, RangeBounds& r) {
+        for (uint32_t i = b; i < e; ++i) {
+            r.bounds.expand(d.boxes[d.primitives[i]]);
+            r.centroids.expand(d.centroids[d.primitives[i]]);
+        }
+    });
+    bounds = rb.bounds;
+    uint32_t count = end - begin;
+    if (count <= BVH::MAX_LEAF_SIZE)
+        return false;
+
+    if (d.split == BVH::Split::Median) {
+        POINT extent(rb.centroids.max.x - rb.centroids.min.x, rb.centroids.max.y - rb.centroids.min.y,
+                     rb.centroids.max.z - rb.centroids.min.z);
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        mid = begin + count / 2;
+        std::nth_element(d.primitives.begin() + begin, d.primitives.begin() + mid, d.primitives.begin() + end,
+                         [&](uint32_t a, uint32_t b) { return axisOf(d.centroids[a], axis) < axisOf(d.centroids[b], axis); });
+        return true;
+    }
+
+    float lo[3], scale[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        lo[axis] = axisOf(rb.centroids.min, axis);
+        float extent = axisOf(rb.centroids.max, axis) - lo[axis];
+        scale[axis] = extent > 0.0f ? BVH::SAH_BINS / extent : 0.0f;
+    }
+    RangeBins bins = reduceRange<RangeBins>(begin, end, parallel, [&](uint32_t b, uint32_t e, RangeBins& r) {
+        for (uint32_t i = b; i < e; ++i) {
+            uint32_t prim = d.primitives[i];
+            for (int axis = 0; axis < 3; ++axis) {
+                int k = binOf(axisOf(d.centroids[prim], axis), lo[axis], scale[axis]);
+                r.bounds[axis][k].expand(d.boxes[prim]);
+                ++r.counts[axis][k];
+            }
+        }
+    });
+
+    // Cost of a split after bin k-1: area(left) * count(left) + area(right) * count(right)
+    float bestCost = std::numeric_limits<float>::max();
+    int bestAxis = -1, bestSplit = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (scale[axis] == 0.0f)
+            continue;
+        float rightCost[BVH::SAH_BINS];
+        AABB acc;
+        uint32_t n = 0;
+        for (int k = BVH::SAH_BINS - 1; k > 0; --k) {
+            if (bins.counts[axis][k])
+                acc.expand(bins.bounds[axis][k]);
+            n += bins.counts[axis][k];
+            rightCost[k] = acc.halfArea() * float(n);
+        }
+        acc = AABB();
+        n = 0;
+        for (int k = 1; k < BVH::SAH_BINS; ++k) {
+            if (bins.counts[axis][k - 1])
+                acc.expand(bins.bounds[axis][k - 1]);
+            n += bins.counts[axis][k - 1];
+            float cost = acc.halfArea() * float(n) + rightCost[k];
+            if (n > 0 && n < count && cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = k;
+            }
+        }
+    }
+
+    auto first = d.primitives.begin() + begin, last = d.primitives.begin() + end;
+    if (bestAxis >= 0) {
+        auto split = std::partition(first, last, [&](uint32_t prim) {
+            return binOf(axisOf(d.centroids[prim], bestAxis), lo[bestAxis], scale[bestAxis]) < bestSplit;
+        });
+        mid = uint32_t(split - d.primitives.begin());
+    } else {
+        // All centroids coincide; any halving is as good as another
+        mid = begin + count / 2;
+    }
+    return true;
+}
+
+// Builds the subtree over [begin, end) into `nodes`, rooted at nodes[root]
+static void buildSubtree(BVHBuildData& d, std::vector<BVHNode>& nodes, uint32_t root, uint32_t begin, uint32_t end) {
+    std::vector<BuildTask> stack;
+    stack.push_back({ root, begin, end });
+    while (!stack.empty()) {
+        BuildTask task = stack.back();
+        stack.pop_back();
+        AABB bounds;
+        uint32_t mid;
+        bool split = splitNode(d, task.begin, task.end, false, bounds, mid);
+        nodes[task.node].bounds = bounds;
+        if (!split) {
+            nodes[task.node].first = task.begin;
+            nodes[task.node].count = task.end - task.begin;
+            continue;
+        }
+        uint32_t left = uint32_t(nodes.size());
+        nodes.emplace_back();
+        nodes.emplace_back();
+        nodes[task.node].first = left;
+        nodes[task.node].count = 0;
+        stack.push_back({ left, task.begin, mid });
+        stack.push_back({ left + 1, mid, task.end });
+    }
+}
+
+void BVH::build(const std::vector<Triangle>& triangles, bool parallel, Split split) {
+    nodes.clear();
+    primitives.resize(triangles.size());
+    if (triangles.empty())
+        return;
+
+    BVHBuildData d{ std::vector<AABB>(triangles.size()), std::vector<POINT>(triangles.size()), primitives, split };
+    parallelFor(triangles.size(), parallel ? 1 << 14 : triangles.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            d.boxes[i] = triangleBounds(triangles[i]);
+            d.centroids[i] = d.boxes[i].center();
+            primitives[i] = uint32_t(i);
+        }
+    });
+
+    // Top levels: split on this thread (binning large nodes in parallel) until
+    // every remaining range is small enough to be one worker's subtree
+    const uint32_t total = uint32_t(triangles.size());
+    const uint32_t subtreeSize = parallel ? std::max<uint32_t>(4096, total / (8 * workerCount())) : total;
+    std::vector<BuildTask> stack, subtrees;
+    nodes.reserve(2 * triangles.size() / MAX_LEAF_SIZE + 1);
+    nodes.emplace_back();
+    stack.push_back({ 0, 0, total });
+    while (!stack.empty()) {
+        BuildTask task = stack.back();
+        stack.pop_back();
+        if (task.end - task.begin <= subtreeSize && total > subtreeSize) {
+            subtrees.push_back(task);
+            continue;
+        }
+        AABB bounds;
+        uint32_t mid;
+        bool split = splitNode(d, task.begin, task.end, parallel && task.end - task.begin >= (1u << 16), bounds, mid);
+        nodes[task.node].bounds = bounds;
+        if (!split) {
+            nodes[task.node].first = task.begin;
+            nodes[task.node].count = task.end - task.begin;
+            continue;
+        }
+        uint32_t left = uint32_t(nodes.size());
+        nodes.emplace_back();
+        nodes.emplace_back();
+        nodes[task.node].first = left;
+        nodes[task.node].count = 0;
+        stack.push_back({ left, task.begin, mid });
+        stack.push_back({ left + 1, mid, task.end });
+    }
+    if (subtrees.empty())
+        return;
+
+    // Subtrees own disjoint primitive ranges, so they are built concurrently
+    // into private node arrays, largest first
+    std::sort(subtrees.begin(), subtrees.end(),
+              [](const BuildTask& a, const BuildTask& b) { return a.end - a.begin > b.end - b.begin; });
+    std::vector<std::vector<BVHNode>> built(subtrees.size());
+    std::atomic<size_t> next{0};
+    parallelChunks(std::min<size_t>(workerCount(), subtrees.size()), [&](size_t) {
+        for (size_t s; (s = next++) < subtrees.size();) {
+            built[s].reserve(2 * (subtrees[s].end - subtrees[s].begin) / MAX_LEAF_SIZE + 1);
+            built[s].emplace_back();
+            buildSubtree(d, built[s], 0, subtrees[s].begin, subtrees[s].end);
+        }
+    });
+
+    // Splice: a subtree's root replaces its placeholder, the other nodes are
+    // appended with their child links shifted
+    for (size_t s = 0; s < subtrees.size(); ++s) {
+        const std::vector<BVHNode>& sub = built[s];
+        uint32_t shift = uint32_t(nodes.size()) - 1;
+        for (size_t i = 0; i < sub.size(); ++i) {
+            BVHNode node = sub[i];
+            if (!node.isLeaf())
+                node.first += shift;
+            if (i == 0)
+                nodes[subtrees[s].node] = node;
+            else
+                nodes.push_back(node);
+        }
+    }
+}
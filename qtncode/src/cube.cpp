@@ -78,3 +78,34 @@ void Cube::draw() const
 
     glEnd();
 }
+
+
+std::vector<Triangle> Cube::toTriangles() const
+{
+    std::vector<Triangle> triangles;
+    if (basePoints.size() < 3)
+        return triangles;
+
+    auto toPOINT = [](const Point& p) { return POINT(float(p.getX()), float(p.getY()), float(p.getZ())); };
+    size_t n = basePoints.size();
+
+    // Bottom face as a fan, wound to face away from the extrusion
+    for (size_t i = 1; i + 1 < n; ++i)
+        triangles.emplace_back(toPOINT(basePoints[0]), toPOINT(basePoints[i + 1]), toPOINT(basePoints[i]));
+
+    if (extrudedPoints.size() != n)
+        return triangles;
+
+    // Top face
+    for (size_t i = 1; i + 1 < n; ++i)
+        triangles.emplace_back(toPOINT(extrudedPoints[0]), toPOINT(extrudedPoints[i]), toPOINT(extrudedPoints[i + 1]));
+
+    // Side walls, two triangles per base edge
+    for (size_t i = 0; i < n; ++i)
+    {
+        size_t j = (i + 1) % n;
+        triangles.emplace_back(toPOINT(basePoints[i]), toPOINT(basePoints[j]), toPOINT(extrudedPoints[j]));
+        triangles.emplace_back(toPOINT(basePoints[i]), toPOINT(extrudedPoints[j]), toPOINT(extrudedPoints[i]));
+    }
+    return triangles;
+}
@@ -0,0 +1,70 @@
+#include "gzipreader.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <zlib.h>
+
+GzipReader::GzipReader() : queue(QUEUE_CHUNKS) {}
+
+GzipReader::~GzipReader() {
+    stop();
+}
+
+bool GzipReader::open(const std::string& filename) {
+    std::error_code ec;
+    compressedSize = std::filesystem::file_size(filename, ec);
+    file = gzopen(filename.c_str(), "rb");
+    if (!file) {
+        std::cerr << "Error: Cannot open file " << filename << "\n";
+        return false;
+    }
+    gzbuffer(file, 1 << 17);
+    thread = std::thread(&GzipReader::run, this);
+    return true;
+}
+
+void GzipReader::run() {
+    while (true) {
+        std::vector<char> chunk(CHUNK_SIZE);
+        int n = gzread(file, chunk.data(), unsigned(chunk.size()));
+        if (n < 0) {
+            int code;
+            std::cerr << "Error: Decompression failed: " << gzerror(file, &code) << "\n";
+            error = true;
+            break;
+        }
+        if (n == 0) {
+            // gzread reports a cut-off stream as a plain end of file
+            int code;
+            gzerror(file, &code);
+            if (code != Z_OK) {
+                std::cerr << "Error: Compressed stream is truncated\n";
+                error = true;
+            }
+            break;
+        }
+        consumed = uint64_t(std::max<z_off_t>(gzoffset(file), 0));
+        chunk.resize(size_t(n));
+        if (!queue.push(std::move(chunk)))
+            break; // Consumer stopped
+    }
+    queue.close();
+}
+
+bool GzipReader::read(std::vector<char>& chunk) {
+    return queue.pop(chunk);
+}
+
+void GzipReader::stop() {
+    queue.close();
+    if (thread.joinable())
+        thread.join();
+    if (file) {
+        gzclose(file);
+        file = nullptr;
+    }
+}
+
+float GzipReader::progress() const {
+    return compressedSize ? std::min(1.0f, float(consumed.load()) / float(compressedSize)) : 0.0f;
+}
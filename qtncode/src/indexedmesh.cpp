@@ -0,0 +1,354 @@
+#include "indexedmesh.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+
+std::vector<Triangle> IndexedMesh::toTriangles() const {
+    std::vector<Triangle> triangles(triangleCount());
+    parallelFor(triangles.size(), 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            triangles[i] = triangle(i);
+    });
+    return triangles;
+}
+
+// Below this many vertices welding runs on the calling thread only
+static const size_t WELD_PARALLEL_THRESHOLD = 1 << 16;
+
+namespace {
+
+// Integer grid cell of a vertex, or its raw float bits for exact welding
+struct CellKey {
+    int64_t x, y, z;
+    bool operator==(const CellKey& o) const { return x == o.x && y == o.y && z == o.z; }
+};
+
+struct CellHash {
+    size_t operator()(const CellKey& k) const {
+        uint64_t h = uint64_t(k.x) * 0x9E3779B97F4A7C15ull;
+        h ^= uint64_t(k.y) * 0xC2B2AE3D27D4EB4Full;
+        h ^= uint64_t(k.z) * 0x165667B19E3779F9ull;
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ull;
+        return size_t(h ^ (h >> 32));
+    }
+};
+
+// Key of an exact position
+struct PositionKey {
+    CellKey operator()(const POINT& p) const { return CellKey{ floatBits(p.x), floatBits(p.y), floatBits(p.z) }; }
+
+private:
+    static int64_t floatBits(float v) {
+        if (v == 0.0f)
+            v = 0.0f; // -0 and +0 are the same position
+        uint32_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        return bits;
+    }
+};
+
+} // namespace
+
+static const POINT& corner(const std::vector<Triangle>& triangles, size_t vertex) {
+    const Triangle& t = triangles[vertex / 3];
+    switch (vertex % 3) {
+    case 0: return t.p1;
+    case 1: return t.p2;
+    default: return t.p3;
+    }
+}
+
+static double distance(const POINT& p, const POINT& q) {
+    double dx = double(p.x) - q.x, dy = double(p.y) - q.y, dz = double(p.z) - q.z;
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+namespace {
+
+// Cell of a vertex in a grid of cells twice the tolerance wide, and the
+// nearer neighbour on each axis. A vertex's matches can only lie in the 8
+// cells these span.
+struct WeldCell {
+    int64_t cell[3], side[3];
+
+    WeldCell(const POINT& p, double inverse) {
+        const float coords[3] = { p.x, p.y, p.z };
+        for (int d = 0; d < 3; ++d) {
+            double scaled = coords[d] * inverse;
+            cell[d] = int64_t(std::floor(scaled));
+            side[d] = scaled - double(cell[d]) < 0.5 ? -1 : 1;
+        }
+    }
+    CellKey own() const { return CellKey{ cell[0], cell[1], cell[2] }; }
+    CellKey searched(int k) const {
+        return CellKey{ cell[0] + (k & 1) * side[0], cell[1] + (k >> 1 & 1) * side[1], cell[2] + (k >> 2) * side[2] };
+    }
+};
+
+// Heads of the vertex chains of one cell, newest first
+struct CellChains {
+    uint32_t reps = UINT32_MAX; // Representatives, linked through nextRep
+    uint32_t all = UINT32_MAX;  // Every vertex, linked through nextAll
+};
+
+typedef std::unordered_map<CellKey, CellChains, CellHash> CellMap;
+
+} // namespace
+
+// Points every vertex at the first earlier representative within tolerance,
+// or at itself; which vertex absorbs which depends on their order.
+//
+// The grid is cut into slabs of cell columns along one axis, with about the
+// same number of vertices each, and every slab is welded on its own thread
+// from its own vertices. Only vertices whose search reaches into the next
+// slab can come out wrong there. They are decided again afterwards in index
+// order against all slabs, and whenever one changes whether it is a
+// representative, the later vertices that can see it are decided again as
+// well. The result is the same as welding all vertices in order.
+static void weldWithin(const std::vector<Triangle>& triangles, float tolerance, size_t slabCount,
+                       std::vector<uint32_t>& rep) {
+    const uint32_t none = UINT32_MAX;
+    const size_t n = rep.size();
+    const double inverse = 0.5 / tolerance;
+    auto cellOf = [&](size_t i) { return WeldCell(corner(triangles, i), inverse); };
+
+    // Slab s holds the columns [bounds[s], bounds[s + 1]) along the axis
+    // where a sample of the vertices spreads over the most cells; inner
+    // bounds are quantiles of the sample
+    int axis = 0;
+    std::vector<int64_t> bounds{ INT64_MIN };
+    if (slabCount > 1) {
+        std::vector<int64_t> sample[3];
+        const size_t stride = std::max<size_t>(1, n / (slabCount * 256));
+        for (size_t i = 0; i < n; i += stride) {
+            WeldCell cell = cellOf(i);
+            for (int d = 0; d < 3; ++d)
+                sample[d].push_back(cell.cell[d]);
+        }
+        for (int d = 0; d < 3; ++d)
+            std::sort(sample[d].begin(), sample[d].end());
+        auto spread = [&](int d) { return sample[d].back() - sample[d].front(); };
+        for (int d = 1; d < 3; ++d)
+            if (spread(d) > spread(axis))
+                axis = d;
+        for (size_t s = 1; s < slabCount; ++s)
+            bounds.push_back(sample[axis][s * sample[axis].size() / slabCount]);
+    }
+    bounds.push_back(INT64_MAX);
+    const size_t slabs = bounds.size() - 1;
+    auto slabOf = [&](int64_t column) {
+        return size_t(std::upper_bound(bounds.begin(), bounds.end(), column) - bounds.begin()) - 1;
+    };
+    auto columnOf = [&](const CellKey& key) { return axis == 0 ? key.x : axis == 1 ? key.y : key.z; };
+
+    // Vertex ids of each slab, ascending, as gathered by each chunk
+    const size_t chunks = slabs;
+    std::vector<std::vector<std::vector<uint32_t>>> local(chunks, std::vector<std::vector<uint32_t>>(slabs));
+    if (slabs > 1) {
+        parallelChunks(chunks, [&](size_t c) {
+            for (size_t i = c * n / chunks; i < (c + 1) * n / chunks; ++i)
+                local[c][slabOf(cellOf(i).cell[axis])].push_back(uint32_t(i));
+        });
+    }
+
+    std::vector<CellMap> cells(slabs);
+    std::vector<uint32_t> nextRep(n, none), nextAll(n, none);
+    // Earliest representative before vertex i within tolerance, among its
+    // own cell's chains and the other cells that lookup(key) finds
+    auto earliestMatch = [&](uint32_t i, const WeldCell& c, const CellChains& own, auto lookup) {
+        const POINT& p = corner(triangles, i);
+        uint32_t match = none;
+        for (int k = 0; k < 8; ++k) {
+            const CellChains* chains = k == 0 ? &own : lookup(c.searched(k));
+            if (!chains)
+                continue;
+            for (uint32_t v = chains->reps; v != none; v = nextRep[v])
+                if (v < i && (match == none || v < match) && distance(corner(triangles, v), p) <= tolerance)
+                    match = v;
+        }
+        return match;
+    };
+
+    // 1. Every slab on its own; vertices that search past its edge are kept
+    std::vector<std::vector<uint32_t>> seams(slabs);
+    parallelFor(slabs, 1, [&](size_t first, size_t last) {
+        for (size_t s = first; s < last; ++s) {
+            CellMap& map = cells[s];
+            map.reserve(n / slabs / 4);
+            auto lookup = [&](const CellKey& key) -> const CellChains* {
+                auto it = map.find(key);
+                return it == map.end() ? nullptr : &it->second;
+            };
+            auto place = [&](uint32_t i) {
+                WeldCell cell = cellOf(i);
+                CellChains& own = map[cell.own()];
+                uint32_t match = earliestMatch(i, cell, own, lookup);
+                nextAll[i] = own.all;
+                own.all = i;
+                if (match == none) {
+                    nextRep[i] = own.reps;
+                    own.reps = i;
+                }
+                rep[i] = match == none ? i : match;
+                int64_t reach = cell.cell[axis] + cell.side[axis];
+                if (reach < bounds[s] || reach >= bounds[s + 1])
+                    seams[s].push_back(i);
+            };
+            if (slabs == 1) {
+                for (size_t i = 0; i < n; ++i)
+                    place(uint32_t(i));
+                continue;
+            }
+            for (size_t c = 0; c < chunks; ++c) {
+                for (uint32_t i : local[c][s])
+                    place(i);
+                std::vector<uint32_t>().swap(local[c][s]);
+            }
+        }
+    });
+
+    // 2. Seam vertices, and whatever their corrections reach, in index order
+    auto find = [&](const CellKey& key) -> CellChains* {
+        CellMap& map = cells[slabOf(columnOf(key))];
+        auto it = map.find(key);
+        return it == map.end() ? nullptr : &it->second;
+    };
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> pending;
+    for (const auto& seam : seams)
+        for (uint32_t i : seam)
+            pending.push(i);
+    uint32_t previous = none;
+    while (!pending.empty()) {
+        uint32_t i = pending.top();
+        pending.pop();
+        if (i == previous)
+            continue;
+        previous = i;
+        WeldCell cell = cellOf(i);
+        CellChains& own = *find(cell.own());
+        uint32_t match = earliestMatch(i, cell, own, find);
+        bool wasRep = rep[i] == i;
+        rep[i] = match == none ? i : match;
+        if (wasRep == (match == none))
+            continue;
+
+        if (wasRep) {
+            uint32_t* link = &own.reps;
+            while (*link != i)
+                link = &nextRep[*link];
+            *link = nextRep[i];
+        } else {
+            nextRep[i] = own.reps;
+            own.reps = i;
+        }
+        // Later vertices whose search covers this cell
+        for (int64_t dx = -1; dx <= 1; ++dx)
+            for (int64_t dy = -1; dy <= 1; ++dy)
+                for (int64_t dz = -1; dz <= 1; ++dz) {
+                    const CellChains* chains = find(CellKey{ cell.cell[0] + dx, cell.cell[1] + dy, cell.cell[2] + dz });
+                    for (uint32_t v = chains ? chains->all : none; v != none; v = nextAll[v])
+                        if (v > i)
+                            pending.push(v);
+                }
+    }
+}
+
+IndexedMesh weldVertices(const std::vector<Triangle>& triangles, float tolerance) {
+    IndexedMesh mesh;
+    const size_t n = triangles.size() * 3;
+    if (n == 0)
+        return mesh;
+
+    const size_t chunks = n < WELD_PARALLEL_THRESHOLD ? 1 : workerCount();
+    const size_t step = (n + chunks - 1) / chunks;
+    std::vector<uint32_t> rep(n);
+    std::vector<uint32_t> order(n);
+    if (tolerance > 0.0f) {
+        weldWithin(triangles, tolerance, chunks, rep);
+    } else {
+        PositionKey keyOf;
+        CellHash hasher;
+
+        // 1. Partition vertex ids into hash buckets so each bucket can be welded
+        //    independently. The scatter is stable, so ids stay ascending per bucket.
+        const size_t buckets = n < WELD_PARALLEL_THRESHOLD ? 1 : chunks * 4;
+        std::vector<uint16_t> bucketOf(n);
+        std::vector<size_t> counts(chunks * buckets, 0);
+        parallelChunks(chunks, [&](size_t c) {
+            size_t* count = &counts[c * buckets];
+            for (size_t i = c * step, end = std::min(n, i + step); i < end; ++i) {
+                uint16_t b = uint16_t((hasher(keyOf(corner(triangles, i))) >> 48) % buckets);
+                bucketOf[i] = b;
+                ++count[b];
+            }
+        });
+
+        std::vector<size_t> bucketStart(buckets + 1, 0);
+        std::vector<size_t> offsets(chunks * buckets);
+        size_t running = 0;
+        for (size_t b = 0; b < buckets; ++b) {
+            bucketStart[b] = running;
+            for (size_t c = 0; c < chunks; ++c) {
+                offsets[c * buckets + b] = running;
+                running += counts[c * buckets + b];
+            }
+        }
+        bucketStart[buckets] = running;
+
+        parallelChunks(chunks, [&](size_t c) {
+            size_t* offset = &offsets[c * buckets];
+            for (size_t i = c * step, end = std::min(n, i + step); i < end; ++i)
+                order[offset[bucketOf[i]]++] = uint32_t(i);
+        });
+        std::vector<uint16_t>().swap(bucketOf);
+
+        // 2. Weld within each bucket: every vertex points at the first vertex of its position
+        parallelFor(buckets, 1, [&](size_t first, size_t last) {
+            for (size_t b = first; b < last; ++b) {
+                std::unordered_map<CellKey, uint32_t, CellHash> cells;
+                cells.reserve(bucketStart[b + 1] - bucketStart[b]);
+                for (size_t k = bucketStart[b]; k < bucketStart[b + 1]; ++k) {
+                    uint32_t id = order[k];
+                    rep[id] = cells.emplace(keyOf(corner(triangles, id)), id).first->second;
+                }
+            }
+        });
+    }
+
+    // 3. Number the representatives in first-appearance order (blocked prefix sum),
+    //    reusing `order` for the new vertex ids
+    std::vector<uint32_t>& newId = order;
+    std::vector<size_t> uniquePerChunk(chunks + 1, 0);
+    parallelChunks(chunks, [&](size_t c) {
+        size_t count = 0;
+        for (size_t i = c * step, end = std::min(n, i + step); i < end; ++i)
+            count += rep[i] == i;
+        uniquePerChunk[c + 1] = count;
+    });
+    for (size_t c = 0; c < chunks; ++c)
+        uniquePerChunk[c + 1] += uniquePerChunk[c];
+
+    mesh.vertices.resize(uniquePerChunk[chunks]);
+    parallelChunks(chunks, [&](size_t c) {
+        uint32_t next = uint32_t(uniquePerChunk[c]);
+        for (size_t i = c * step, end = std::min(n, i + step); i < end; ++i) {
+            if (rep[i] == i) {
+                newId[i] = next;
+                mesh.vertices[next++] = corner(triangles, i);
+            }
+        }
+    });
+
+    // 4. Representatives always precede the vertices they absorb, so their ids are final
+    mesh.indices.resize(n);
+    parallelFor(n, WELD_PARALLEL_THRESHOLD, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            mesh.indices[i] = newId[rep[i]];
+    });
+    return mesh;
+}
@@ -1,153 +1,746 @@
 #include "intersection.h"
+#include "spatialhash.h"
+#include "parallel.h"
+#include "trianglebatch.h"
+#include "predicates.h"
 #include <algorithm>
+#include <tuple>
 #include <cmath>
+#include <atomic>
+#include <chrono>
 
 
-std::vector<Triangle> trianglesA;
-std::vector<Triangle> trianglesB;
-
-// Helper function: orientation for 2D POINTs
-static int orientation(const POINT& p, const POINT& q, const POINT& r) {
-    float val = (q.y - p.y) * (r.x - q.x) -
-                (q.x - p.x) * (r.y - q.y);
-    if (val == 0) return 0;  // colinear
-    return (val > 0) ? 1 : 2; // clock or counterclock wise
+// Exact sides of the corners of t against the plane through `plane`
+// (orient3d signs; all zero when `plane` is degenerate)
+static void planeSides(const Triangle& plane, const Triangle& t, double sides[3]) {
+    sides[0] = orient3d(plane.p1, plane.p2, plane.p3, t.p1);
+    sides[1] = orient3d(plane.p1, plane.p2, plane.p3, t.p2);
+    sides[2] = orient3d(plane.p1, plane.p2, plane.p3, t.p3);
 }
 
-// Helper function: check if q lies on segment pr
-static bool onSegment(const POINT& p, const POINT& q, const POINT& r) {
-    return q.x <= std::max(p.x, r.x) && q.x >= std::min(p.x, r.x) &&
-           q.y <= std::max(p.y, r.y) && q.y >= std::min(p.y, r.y);
+static bool strictlyOneSide(const double sides[3]) {
+    return (sides[0] > 0 && sides[1] > 0 && sides[2] > 0) || (sides[0] < 0 && sides[1] < 0 && sides[2] < 0);
 }
 
-// 2D segment intersection test (ignoring z)
-static bool segmentsIntersect2D(const POINT& p1, const POINT& q1, const POINT& p2, const POINT& q2) {
-    int o1 = orientation(p1, q1, p2);
-    int o2 = orientation(p1, q1, q2);
-    int o3 = orientation(p2, q2, p1);
-    int o4 = orientation(p2, q2, q1);
-
-    // General case
-    if (o1 != o2 && o3 != o4)
-        return true;
+// Helper: check coplanarity (exact: every point of t2 on t1's plane)
+bool trianglesCoplanar(const Triangle& t1, const Triangle& t2) {
+    double sides[3];
+    planeSides(t1, t2, sides);
+    return sides[0] == 0 && sides[1] == 0 && sides[2] == 0;
+}
 
-    // Special Cases
-    if (o1 == 0 && onSegment(p1, p2, q1)) return true;
-    if (o2 == 0 && onSegment(p1, q2, q1)) return true;
-    if (o3 == 0 && onSegment(p2, p1, q2)) return true;
-    if (o4 == 0 && onSegment(p2, q1, q2)) return true;
+// Coordinates of p in the plane that drops the given axis (0 = x, 1 = y, 2 = z)
+static void project(const POINT& p, int axis, double& u, double& v) {
+    u = axis == 0 ? p.y : p.x;
+    v = axis == 2 ? p.y : p.z;
+}
 
-    return false;
+static bool lessPoint(const POINT* a, const POINT* b) {
+    return std::tie(a->x, a->y, a->z) < std::tie(b->x, b->y, b->z);
 }
 
-// Check if any edge of t1 intersects any edge of t2 (2D)
-bool trianglesIntersect(const Triangle& t1, const Triangle& t2) {
-    const POINT* t1_pts[3] = { &t1.p1, &t1.p2, &t1.p3 };
-    const POINT* t2_pts[3] = { &t2.p1, &t2.p2, &t2.p3 };
-    // For each edge in t1
-    for (int i = 0; i < 3; ++i) {
-        const POINT& a1 = *t1_pts[i];
-        const POINT& a2 = *t1_pts[(i+1)%3];
-        // For each edge in t2
-        for (int j = 0; j < 3; ++j) {
-            const POINT& b1 = *t2_pts[j];
-            const POINT& b2 = *t2_pts[(j+1)%3];
-            if (segmentsIntersect2D(a1, a2, b1, b2)) {
-                return true;
-            }
-        }
+// Sets the coordinates that all count points share on p as well: a crossing
+// with an axis-aligned triangle or edge then lies exactly in it, however the
+// interpolation rounded.
+static void keepShared(POINT& p, const POINT* const* points, int count) {
+    float POINT::*axes[3] = { &POINT::x, &POINT::y, &POINT::z };
+    for (auto axis : axes) {
+        bool shared = true;
+        for (int i = 1; i < count && shared; ++i)
+            shared = points[i]->*axis == points[0]->*axis;
+        if (shared)
+            p.*axis = points[0]->*axis;
     }
-    return false;
 }
 
-// Helper: cross product
-static POINT cross(const POINT& a, const POINT& b) {
-    return POINT(
-        a.y * b.z - a.z * b.y,
-        a.z * b.x - a.x * b.z,
-        a.x * b.y - a.y * b.x
-    );
+// Where segments a0-a1 and b0-b1, known to meet, cross. The result depends
+// only on the two segments, not on their order or direction, so every
+// triangle pair that finds this crossing gets the same point.
+static POINT edgeCrossing(const POINT* a0, const POINT* a1, const POINT* b0, const POINT* b1) {
+    if (lessPoint(a1, a0)) std::swap(a0, a1);
+    if (lessPoint(b1, b0)) std::swap(b0, b1);
+    if (lessPoint(b0, a0) || (!lessPoint(a0, b0) && lessPoint(b1, a1))) {
+        std::swap(a0, b0);
+        std::swap(a1, b1);
+    }
+    // Work in the plane both segments span, seen along its largest normal component
+    double dx = double(a1->x) - a0->x, dy = double(a1->y) - a0->y, dz = double(a1->z) - a0->z;
+    double ex = double(b1->x) - b0->x, ey = double(b1->y) - b0->y, ez = double(b1->z) - b0->z;
+    double nx = std::fabs(dy * ez - dz * ey), ny = std::fabs(dz * ex - dx * ez), nz = std::fabs(dx * ey - dy * ex);
+    int axis = nx >= ny && nx >= nz ? 0 : ny >= nz ? 1 : 2;
+    double u[4], v[4];
+    project(*a0, axis, u[0], v[0]);
+    project(*a1, axis, u[1], v[1]);
+    project(*b0, axis, u[2], v[2]);
+    project(*b1, axis, u[3], v[3]);
+    double s0 = orient2d(u[2], v[2], u[3], v[3], u[0], v[0]);
+    double s1 = orient2d(u[2], v[2], u[3], v[3], u[1], v[1]);
+    if (s0 == s1) return *a0;
+    double t = s0 / (s0 - s1);
+    bool clamped = !(t >= 0 && t <= 1);
+    t = std::min(1.0, std::max(0.0, t));
+    POINT p(float(a0->x + t * dx), float(a0->y + t * dy), float(a0->z + t * dz));
+    const POINT* ends[4] = { a0, a1, b0, b1 };
+    keepShared(p, ends, 2);
+    if (!clamped) // Otherwise p is not on b's line
+        keepShared(p, ends + 2, 2);
+    return p;
 }
-// Helper: dot product
-static float dot(const POINT& a, const POINT& b) {
-    return a.x * b.x + a.y * b.y + a.z * b.z;
+
+// Location code of a point on the corner shared by edges i and j
+static int8_t sharedCorner(int i, int j) {
+    return int8_t(3 + (j == (i + 1) % 3 ? j : i));
 }
-// Helper: subtract
-static POINT sub(const POINT& a, const POINT& b) {
-    return POINT(a.x - b.x, a.y - b.y, a.z - b.z);
+
+// Where edge p0-q, whose endpoints lie on sides s0 and s1 of tri's plane,
+// crosses tri, if it does. Whether it does is decided exactly; only the
+// crossing point itself is computed in floating point, from the smaller
+// endpoint so that both triangles sharing the edge get the same point.
+// onTri receives where on tri the crossing lies (see SegmentEnd).
+static bool edgeHit(const POINT* p0, const POINT* q, double s0, double s1, const Triangle& tri, POINT& isect,
+                    int8_t& onTri) {
+    if ((s0 > 0 && s1 > 0) || (s0 < 0 && s1 < 0)) return false; // not within segment
+    if (s0 == 0 && s1 == 0) return false; // in the plane (coplanar case)
+    // The edge crosses the plane; it passes inside the triangle when it sees
+    // all three of the triangle's edges with the same orientation
+    double e[3] = { orient3d(*p0, *q, tri.p1, tri.p2), orient3d(*p0, *q, tri.p2, tri.p3),
+                    orient3d(*p0, *q, tri.p3, tri.p1) };
+    if ((e[0] < 0 || e[1] < 0 || e[2] < 0) && (e[0] > 0 || e[1] > 0 || e[2] > 0)) return false;
+    onTri = -1;
+    for (int k = 0; k < 3; ++k)
+        if (e[k] == 0)
+            onTri = onTri < 0 ? int8_t(k) : sharedCorner(onTri, k);
+    // Crossings through an edge or corner of tri are placed from those, so
+    // they agree with what tri's neighbours and coplanar overlaps compute
+    const POINT* corners[3] = { &tri.p1, &tri.p2, &tri.p3 };
+    if (onTri >= 3) {
+        isect = *corners[onTri - 3];
+        return true;
+    }
+    // An endpoint in the plane is the crossing itself; interpolating to it
+    // can round away from it by an ulp
+    if (s0 == 0 || s1 == 0) {
+        isect = s0 == 0 ? *p0 : *q;
+        return true;
+    }
+    if (onTri >= 0) {
+        isect = edgeCrossing(p0, q, corners[onTri], corners[(onTri + 1) % 3]);
+        return true;
+    }
+    if (lessPoint(q, p0)) {
+        std::swap(p0, q);
+        std::swap(s0, s1);
+    }
+    double t = s0 / (s0 - s1);
+    isect = POINT(float(p0->x + t * (double(q->x) - p0->x)),
+                  float(p0->y + t * (double(q->y) - p0->y)),
+                  float(p0->z + t * (double(q->z) - p0->z)));
+    keepShared(isect, corners, 3);
+    return true;
 }
-// Helper: check coplanarity
-bool trianglesCoplanar(const Triangle& t1, const Triangle& t2) {
-    // Plane normal for t1
-    POINT n1 = cross(sub(t1.p2, t1.p1), sub(t1.p3, t1.p1));
-    float d1 = -dot(n1, t1.p1);
-    // Check all POINTs of t2 in t1's plane
-    float dist1 = dot(n1, t2.p1) + d1;
-    float dist2 = dot(n1, t2.p2) + d1;
-    float dist3 = dot(n1, t2.p3) + d1;
-    float eps = 1e-5f;
-    return (fabs(dist1) < eps && fabs(dist2) < eps && fabs(dist3) < eps);
+
+// Combines two location codes of the same point on one triangle
+static int8_t mergeLocation(int8_t a, int8_t b) {
+    if (a < 0 || a == b) return b;
+    if (b < 0) return a;
+    if (a >= 3) return a;
+    if (b >= 3) return b;
+    return sharedCorner(a, b);
 }
 
-// Compute intersection segment of two triangles in 3D (returns true if intersect, and sets segA, segB)
-bool triangleTriangleIntersectionSegment(const Triangle& t1, const Triangle& t2, POINT& segA, POINT& segB) {
-    // Möller–Trumbore style: test all edges of t1 against t2 and vice versa
-    // Collect intersection POINTs
-    std::vector<POINT> isects;
-    auto segmentIntersectTriangle = [](const POINT& p0, const POINT& p1, const Triangle& tri, POINT& isect) -> bool {
-        // Plane of triangle
-        POINT u = sub(tri.p2, tri.p1);
-        POINT v = sub(tri.p3, tri.p1);
-        POINT n = cross(u, v);
-        if (n.x == 0 && n.y == 0 && n.z == 0) return false; // degenerate
-        POINT dir = sub(p1, p0);
-        float denom = dot(n, dir);
-        if (fabs(denom) < 1e-6f) return false; // parallel
-        float t = (dot(n, sub(tri.p1, p0))) / denom;
-        if (t < 0.0f || t > 1.0f) return false; // not within segment
-        POINT P = POINT(p0.x + t*dir.x, p0.y + t*dir.y, p0.z + t*dir.z);
-        // Inside-triangle test (barycentric)
-        POINT w = sub(P, tri.p1);
-        float uu = dot(u, u), uv = dot(u, v), vv = dot(v, v);
-        float wu = dot(w, u), wv = dot(w, v);
-        float D = uv * uv - uu * vv;
-        float s = (uv * wv - vv * wu) / D;
-        float t2 = (uv * wu - uu * wv) / D;
-        if (s >= -1e-5f && t2 >= -1e-5f && (s + t2) <= 1.0f + 1e-5f) {
-            isect = P;
-            return true;
-        }
+// Segment of two non-coplanar triangles given the sides of t1's corners
+// against t2's plane and of t2's corners against t1's plane
+static bool intersectionSegment(const Triangle& t1, const Triangle& t2, const double sides1[3], const double sides2[3],
+                                SegmentEnd& segA, SegmentEnd& segB) {
+    // Möller: a triangle strictly on one side of the other's plane misses it
+    if (strictlyOneSide(sides1) || strictlyOneSide(sides2))
         return false;
-    };
-    // t1 edges vs t2
+    // Test all edges of t1 against t2 and vice versa. At most six hits, so
+    // they are collected on the stack.
+    SegmentEnd isects[6];
+    int hits = 0;
     const POINT* t1_pts[3] = { &t1.p1, &t1.p2, &t1.p3 };
     for (int i = 0; i < 3; ++i) {
-        POINT isect;
-        if (segmentIntersectTriangle(*t1_pts[i], *t1_pts[(i+1)%3], t2, isect))
-            isects.push_back(isect);
+        SegmentEnd& hit = isects[hits];
+        if (edgeHit(t1_pts[i], t1_pts[(i+1)%3], sides1[i], sides1[(i+1)%3], t2, hit.p, hit.on2)) {
+            hit.on1 = sides1[i] == 0 ? int8_t(3 + i) : sides1[(i+1)%3] == 0 ? int8_t(3 + (i+1)%3) : int8_t(i);
+            ++hits;
+        }
     }
-    // t2 edges vs t1
     const POINT* t2_pts[3] = { &t2.p1, &t2.p2, &t2.p3 };
     for (int i = 0; i < 3; ++i) {
-        POINT isect;
-        if (segmentIntersectTriangle(*t2_pts[i], *t2_pts[(i+1)%3], t1, isect))
-            isects.push_back(isect);
-    }
-    // Remove duplicates (within epsilon)
-    float eps = 1e-5f;
-    auto same = [eps](const POINT& a, const POINT& b) {
-        return fabs(a.x-b.x)<eps && fabs(a.y-b.y)<eps && fabs(a.z-b.z)<eps;
+        SegmentEnd& hit = isects[hits];
+        if (edgeHit(t2_pts[i], t2_pts[(i+1)%3], sides2[i], sides2[(i+1)%3], t1, hit.p, hit.on1)) {
+            hit.on2 = sides2[i] == 0 ? int8_t(3 + i) : sides2[(i+1)%3] == 0 ? int8_t(3 + (i+1)%3) : int8_t(i);
+            ++hits;
+        }
+    }
+    // Remove duplicates, keeping everything known about where they lie. A
+    // point found from both triangles (a corner, or two edges crossing) is
+    // computed the same way both times, so the copies are bit-identical;
+    // a tolerance here would collapse genuine short segments on fine meshes.
+    auto same = [](const POINT& a, const POINT& b) {
+        return a.x == b.x && a.y == b.y && a.z == b.z;
     };
-    std::vector<POINT> unique;
-    for (const auto& p : isects) {
+    SegmentEnd unique[6];
+    int uniqueCount = 0;
+    for (int i = 0; i < hits; ++i) {
         bool found = false;
-        for (const auto& q : unique) if (same(p, q)) { found = true; break; }
-        if (!found) unique.push_back(p);
+        for (int j = 0; j < uniqueCount; ++j) {
+            if (same(isects[i].p, unique[j].p)) {
+                unique[j].on1 = mergeLocation(unique[j].on1, isects[i].on1);
+                unique[j].on2 = mergeLocation(unique[j].on2, isects[i].on2);
+                found = true;
+                break;
+            }
+        }
+        if (!found) unique[uniqueCount++] = isects[i];
     }
-    if (unique.size() == 2) {
+    if (uniqueCount == 2) {
         segA = unique[0];
         segB = unique[1];
         return true;
     }
     return false;
-}
\ No newline at end of file
+}
+
+bool triangleTriangleIntersectionSegment(const Triangle& t1, const Triangle& t2, SegmentEnd& segA, SegmentEnd& segB) {
+    double sides1[3], sides2[3];
+    planeSides(t2, t1, sides1);
+    planeSides(t1, t2, sides2);
+    return intersectionSegment(t1, t2, sides1, sides2, segA, segB);
+}
+
+// Compute intersection segment of two triangles in 3D (returns true if intersect, and sets segA, segB)
+bool triangleTriangleIntersectionSegment(const Triangle& t1, const Triangle& t2, POINT& segA, POINT& segB) {
+    SegmentEnd endA, endB;
+    if (!triangleTriangleIntersectionSegment(t1, t2, endA, endB))
+        return false;
+    segA = endA.p;
+    segB = endB.p;
+    return true;
+}
+
+// Axis along which the triangle's normal is largest, or -1 if it is degenerate
+static int dominantAxis(const Triangle& t) {
+    double ux = t.p2.x - t.p1.x, uy = t.p2.y - t.p1.y, uz = t.p2.z - t.p1.z;
+    double vx = t.p3.x - t.p1.x, vy = t.p3.y - t.p1.y, vz = t.p3.z - t.p1.z;
+    double nx = std::fabs(uy * vz - uz * vy);
+    double ny = std::fabs(uz * vx - ux * vz);
+    double nz = std::fabs(ux * vy - uy * vx);
+    if (nx == 0 && ny == 0 && nz == 0) return -1;
+    if (nx >= ny && nx >= nz) return 0;
+    return ny >= nz ? 1 : 2;
+}
+
+int coplanarOverlap(const Triangle& t1, const Triangle& t2, POINT out[6]) {
+    int axis = dominantAxis(t1);
+    if (axis < 0) return 0;
+    const POINT* clip[3] = { &t2.p1, &t2.p2, &t2.p3 };
+    double cu[3], cv[3];
+    for (int i = 0; i < 3; ++i) project(*clip[i], axis, cu[i], cv[i]);
+    // Projection may mirror the winding; orient the half-planes to match
+    double winding = orient2d(cu[0], cv[0], cu[1], cv[1], cu[2], cv[2]);
+    if (winding == 0) return 0;
+
+    // Sutherland-Hodgman: a triangle clipped by three half-planes keeps at
+    // most six vertices, and no intermediate polygon grows past that. Each
+    // polygon edge remembers the edge of t1 (0-2) or t2 (3-5) it runs along,
+    // so a crossing is either an exact corner of t2 or the crossing of two
+    // original edges, which neighbouring pairs compute identically.
+    const POINT* own[3] = { &t1.p1, &t1.p2, &t1.p3 };
+    POINT bufA[6], bufB[6];
+    int8_t labelA[6], labelB[6];
+    POINT* poly = bufA;
+    POINT* next = bufB;
+    int8_t* label = labelA;
+    int8_t* nextLabel = labelB;
+    poly[0] = t1.p1; poly[1] = t1.p2; poly[2] = t1.p3;
+    label[0] = 0; label[1] = 1; label[2] = 2;
+    int count = 3;
+    for (int e = 0; e < 3 && count > 0; ++e) {
+        int f = (e + 1) % 3;
+        double sides[6];
+        for (int i = 0; i < count; ++i) {
+            double u, v;
+            project(poly[i], axis, u, v);
+            double s = orient2d(cu[e], cv[e], cu[f], cv[f], u, v);
+            sides[i] = winding > 0 ? s : -s;
+        }
+        int kept = 0;
+        for (int i = 0; i < count && kept < 6; ++i) {
+            int j = (i + 1) % count;
+            double si = sides[i], sj = sides[j];
+            if (si >= 0) {
+                nextLabel[kept] = si == 0 && sj < 0 ? int8_t(3 + e) : label[i];
+                next[kept++] = poly[i];
+            }
+            if (((si > 0 && sj < 0) || (si < 0 && sj > 0)) && kept < 6) {
+                int8_t along = label[i];
+                if (along >= 3) // Two edges of t2 meet at their shared corner
+                    next[kept] = *clip[(along - 3) == f ? f : e];
+                else
+                    next[kept] = edgeCrossing(own[along], own[(along + 1) % 3], clip[e], clip[f]);
+                nextLabel[kept++] = si > 0 ? int8_t(3 + e) : along;
+            }
+        }
+        std::swap(poly, next);
+        std::swap(label, nextLabel);
+        count = kept;
+    }
+
+    // Vertices lying on a clipping edge come out twice
+    int unique = 0;
+    for (int i = 0; i < count; ++i) {
+        const POINT& p = poly[i];
+        if (unique > 0) {
+            const POINT& q = out[unique - 1];
+            if (p.x == q.x && p.y == q.y && p.z == q.z) continue;
+        }
+        out[unique++] = p;
+    }
+    if (unique > 1) {
+        const POINT& p = out[unique - 1];
+        const POINT& q = out[0];
+        if (p.x == q.x && p.y == q.y && p.z == q.z) --unique;
+    }
+    return unique;
+}
+
+// Appends the intersection of one triangle pair: the crossing segment for
+// non-coplanar pairs, or the outline of the overlap for coplanar ones.
+void intersectTrianglePair(const Triangle& triA, const Triangle& triB, std::vector<std::pair<POINT, POINT>>& segments) {
+    double sidesB[3];
+    planeSides(triA, triB, sidesB);
+    if (sidesB[0] == 0 && sidesB[1] == 0 && sidesB[2] == 0) {
+        POINT overlap[6];
+        int count = coplanarOverlap(triA, triB, overlap);
+        if (count == 2) {
+            segments.emplace_back(overlap[0], overlap[1]);
+        } else if (count > 2) {
+            for (int i = 0; i < count; ++i)
+                segments.emplace_back(overlap[i], overlap[(i + 1) % count]);
+        }
+    } else {
+        // Non-coplanar: collect intersection segment endpoints as a line
+        double sidesA[3];
+        planeSides(triB, triA, sidesA);
+        SegmentEnd segA, segB;
+        if (intersectionSegment(triA, triB, sidesA, sidesB, segA, segB)) {
+            segments.emplace_back(segA.p, segB.p);
+        }
+    }
+}
+
+// Exact 3D test: true for the pairs intersectTrianglePair() appends anything
+// for, a crossing segment or a coplanar overlap wider than a point
+bool trianglesIntersect(const Triangle& t1, const Triangle& t2) {
+    double sides2[3];
+    planeSides(t1, t2, sides2);
+    if (sides2[0] == 0 && sides2[1] == 0 && sides2[2] == 0) {
+        POINT overlap[6];
+        return coplanarOverlap(t1, t2, overlap) >= 2;
+    }
+    if (strictlyOneSide(sides2))
+        return false;
+    double sides1[3];
+    planeSides(t2, t1, sides1);
+    SegmentEnd segA, segB;
+    return intersectionSegment(t1, t2, sides1, sides2, segA, segB);
+}
+
+namespace {
+
+// Mesh b as seen from mesh a when both are in the same frame
+struct SameFrame {
+    SameFrameBounds node;
+    AABB triangle(const Triangle& t) const { return triangleBounds(t); }
+    const Triangle& place(const Triangle& t) const { return t; }
+};
+
+// Mesh b placed into a's frame by bToA. Its boxes are grown by margin so the
+// candidates also cover every placement that moves no point further than that.
+struct MovedFrame {
+    struct Bounds {
+        RigidTransform bToA;
+        float margin;
+        AABB operator()(const AABB& box) const { return grow(transformedBounds(box, bToA), margin); }
+    } node;
+    AABB triangle(const Triangle& t) const { return grow(triangleBounds(node.bToA.apply(t)), node.margin); }
+    Triangle place(const Triangle& t) const { return node.bToA.apply(t); }
+
+    static AABB grow(AABB box, float margin) {
+        box.min = POINT(box.min.x - margin, box.min.y - margin, box.min.z - margin);
+        box.max = POINT(box.max.x + margin, box.max.y + margin, box.max.z + margin);
+        return box;
+    }
+};
+
+} // namespace
+
+// Calls fn(i, j) for the triangles of overlapping leaves below the node pair
+// (rootA, rootB) whose boxes overlap, with b's boxes taken in a's frame
+template <typename Frame, typename Fn>
+static void forEachTreeCandidate(const std::vector<Triangle>& a, const BVH& bvhA,
+                                 const std::vector<Triangle>& b, const BVH& bvhB,
+                                 uint32_t rootA, uint32_t rootB, const Frame& frame, Fn fn) {
+    forEachOverlappingLeafPair(bvhA, bvhB, [&](const BVHNode& leafA, const BVHNode& leafB) {
+        const AABB& leafBoxB = frame.node(leafB.bounds);
+        for (uint32_t i = leafA.first; i < leafA.first + leafA.count; ++i) {
+            uint32_t ia = bvhA.primitives[i];
+            AABB boxA = triangleBounds(a[ia]);
+            if (!boxA.overlaps(leafBoxB))
+                continue;
+            for (uint32_t j = leafB.first; j < leafB.first + leafB.count; ++j) {
+                uint32_t ib = bvhB.primitives[j];
+                if (boxA.overlaps(frame.triangle(b[ib])))
+                    fn(ia, ib);
+            }
+        }
+    }, rootA, rootB, frame.node);
+}
+
+// Cuts the dual traversal into independent node pairs by opening overlapping
+// pairs level by level until there are about `target` of them
+template <typename Frame>
+static std::vector<std::pair<uint32_t, uint32_t>> treeTasks(const BVH& a, const BVH& b, size_t target,
+                                                            const Frame& frame) {
+    std::vector<std::pair<uint32_t, uint32_t>> frontier, next;
+    if (a.empty() || b.empty() || !a.nodes[0].bounds.overlaps(frame.node(b.nodes[0].bounds)))
+        return frontier;
+    frontier.push_back({ 0, 0 });
+    bool opened = true;
+    while (opened && frontier.size() < target) {
+        opened = false;
+        next.clear();
+        for (auto [ia, ib] : frontier) {
+            const BVHNode& na = a.nodes[ia];
+            const BVHNode& nb = b.nodes[ib];
+            std::pair<uint32_t, uint32_t> children[2];
+            if (na.isLeaf() && nb.isLeaf()) {
+                next.push_back({ ia, ib });
+                continue;
+            } else if (nb.isLeaf() || (!na.isLeaf() && na.bounds.halfArea() >= frame.node(nb.bounds).halfArea())) {
+                children[0] = { na.first, ib };
+                children[1] = { na.first + 1, ib };
+            } else {
+                children[0] = { ia, nb.first };
+                children[1] = { ia, nb.first + 1 };
+            }
+            opened = true;
+            for (auto child : children)
+                if (a.nodes[child.first].bounds.overlaps(frame.node(b.nodes[child.second].bounds)))
+                    next.push_back(child);
+        }
+        frontier.swap(next);
+    }
+    return frontier;
+}
+
+// Runs runTask(task, buffer) for every task on the work-stealing pool, each
+// into a buffer of its own, and appends the buffers to segments in task order
+// so the output does not depend on scheduling
+template <typename Fn>
+static void collectSegments(size_t tasks, std::vector<std::pair<POINT, POINT>>& segments, Fn runTask) {
+    std::vector<std::vector<std::pair<POINT, POINT>>> buffers(tasks);
+    parallelTasks(tasks, [&](size_t task) { runTask(task, buffers[task]); });
+    std::vector<size_t> offsets(tasks + 1, segments.size());
+    for (size_t t = 0; t < tasks; ++t)
+        offsets[t + 1] = offsets[t] + buffers[t].size();
+    segments.resize(offsets[tasks]);
+    parallelFor(tasks, 64, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t)
+            std::copy(buffers[t].begin(), buffers[t].end(), segments.begin() + offsets[t]);
+    });
+}
+
+// Calls fn(i, placedB) for the candidate pairs (i << 32 | j) that survive the
+// plane-side test. Pairs are grouped by their triangle of a, which is tested
+// against up to TriangleBatch::WIDTH triangles of b per kernel call. fn
+// returns false to stop; so does this function then.
+template <typename Frame, typename Fn>
+static bool forEachSurvivor(const std::vector<Triangle>& a, const std::vector<Triangle>& b, const Frame& frame,
+                            std::vector<uint64_t>& pairs, Fn fn) {
+    std::sort(pairs.begin(), pairs.end());
+    TriangleBatch batch;
+    Triangle placed[TriangleBatch::WIDTH];
+    for (size_t p = 0; p < pairs.size();) {
+        const uint32_t i = uint32_t(pairs[p] >> 32);
+        batch.clear();
+        while (p < pairs.size() && uint32_t(pairs[p] >> 32) == i && !batch.full()) {
+            placed[batch.count] = frame.place(b[uint32_t(pairs[p])]);
+            batch.add(placed[batch.count]);
+            ++p;
+        }
+        uint32_t survivors = planeSideSurvivors(a[i], batch);
+        for (int k = 0; k < batch.count; ++k)
+            if ((survivors >> k & 1) && !fn(a[i], placed[k]))
+                return false;
+    }
+    return true;
+}
+
+// Narrow phase over the candidate pairs of one task; only the plane-side
+// survivors reach intersectTrianglePair. Segments come out in a's frame.
+template <typename Frame>
+static void narrowPhase(const std::vector<Triangle>& a, const std::vector<Triangle>& b, const Frame& frame,
+                        std::vector<uint64_t>& pairs, std::vector<std::pair<POINT, POINT>>& out) {
+    forEachSurvivor(a, b, frame, pairs, [&](const Triangle& triA, const Triangle& triB) {
+        intersectTrianglePair(triA, triB, out);
+        return true;
+    });
+}
+
+// Enough tasks per worker for stealing to even out dense regions
+static size_t taskTarget() {
+    return 64 * size_t(workerCount());
+}
+
+// Intersects the candidates that forEachCandidate(task, emit) reports for
+// every task and returns how many there were
+template <typename Fn>
+static size_t intersectTasks(size_t tasks, const std::vector<Triangle>& a, const std::vector<Triangle>& b,
+                             std::vector<std::pair<POINT, POINT>>& segments, Fn forEachCandidate) {
+    std::atomic<size_t> candidates{0};
+    collectSegments(tasks, segments, [&](size_t task, std::vector<std::pair<POINT, POINT>>& out) {
+        std::vector<uint64_t> pairs;
+        forEachCandidate(task, [&](uint32_t i, uint32_t j) { pairs.push_back(uint64_t(i) << 32 | j); });
+        candidates += pairs.size();
+        narrowPhase(a, b, SameFrame(), pairs, out);
+    });
+    return candidates;
+}
+
+void intersectMeshes(const std::vector<Triangle>& a, const BVH& bvhA,
+                     const std::vector<Triangle>& b, const BVH& bvhB,
+                     std::vector<std::pair<POINT, POINT>>& segments) {
+    auto tasks = treeTasks(bvhA, bvhB, taskTarget(), SameFrame());
+    intersectTasks(tasks.size(), a, b, segments, [&](size_t task, auto emit) {
+        forEachTreeCandidate(a, bvhA, b, bvhB, tasks[task].first, tasks[task].second, SameFrame(), emit);
+    });
+}
+
+std::vector<uint64_t> candidatePairs(const std::vector<Triangle>& a, const BVH& bvhA,
+                                     const std::vector<Triangle>& b, const BVH& bvhB) {
+    auto tasks = treeTasks(bvhA, bvhB, taskTarget(), SameFrame());
+    std::vector<std::vector<uint64_t>> perTask(tasks.size());
+    parallelTasks(tasks.size(), [&](size_t task) {
+        forEachTreeCandidate(a, bvhA, b, bvhB, tasks[task].first, tasks[task].second, SameFrame(),
+                             [&](uint32_t i, uint32_t j) { perTask[task].push_back(uint64_t(i) << 32 | j); });
+    });
+    std::vector<size_t> offsets(tasks.size() + 1, 0);
+    for (size_t t = 0; t < tasks.size(); ++t)
+        offsets[t + 1] = offsets[t] + perTask[t].size();
+    std::vector<uint64_t> pairs(offsets[tasks.size()]);
+    parallelFor(tasks.size(), 64, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t)
+            std::copy(perTask[t].begin(), perTask[t].end(), pairs.begin() + offsets[t]);
+    });
+    return pairs;
+}
+
+void intersectMeshesSerial(const std::vector<Triangle>& a, const BVH& bvhA,
+                           const std::vector<Triangle>& b, const BVH& bvhB,
+                           std::vector<std::pair<POINT, POINT>>& segments) {
+    if (bvhA.empty() || bvhB.empty())
+        return;
+    std::vector<uint64_t> pairs;
+    forEachTreeCandidate(a, bvhA, b, bvhB, 0, 0, SameFrame(),
+                         [&](uint32_t i, uint32_t j) { pairs.push_back(uint64_t(i) << 32 | j); });
+    narrowPhase(a, b, SameFrame(), pairs, segments);
+}
+
+bool meshesIntersect(const std::vector<Triangle>& a, const BVH& bvhA,
+                     const std::vector<Triangle>& b, const BVH& bvhB) {
+    auto tasks = treeTasks(bvhA, bvhB, taskTarget(), SameFrame());
+    std::atomic<bool> found{false};
+    parallelTasks(tasks.size(), [&](size_t task) {
+        std::vector<uint64_t> pairs;
+        // Leaf pair by leaf pair, so a hit ends every task within one leaf pair
+        forEachOverlappingLeafPair(bvhA, bvhB, [&](const BVHNode& leafA, const BVHNode& leafB) {
+            if (found.load(std::memory_order_relaxed))
+                return false;
+            pairs.clear();
+            for (uint32_t i = leafA.first; i < leafA.first + leafA.count; ++i) {
+                uint32_t ia = bvhA.primitives[i];
+                AABB boxA = triangleBounds(a[ia]);
+                if (!boxA.overlaps(leafB.bounds))
+                    continue;
+                for (uint32_t j = leafB.first; j < leafB.first + leafB.count; ++j) {
+                    uint32_t ib = bvhB.primitives[j];
+                    if (boxA.overlaps(triangleBounds(b[ib])))
+                        pairs.push_back(uint64_t(ia) << 32 | ib);
+                }
+            }
+            bool clear = forEachSurvivor(a, b, SameFrame(), pairs, [](const Triangle& triA, const Triangle& triB) {
+                return !trianglesIntersect(triA, triB);
+            });
+            if (!clear)
+                found = true;
+            return clear;
+        }, tasks[task].first, tasks[task].second);
+    });
+    return found;
+}
+
+size_t countIntersectingPairs(const std::vector<Triangle>& a, const BVH& bvhA,
+                              const std::vector<Triangle>& b, const BVH& bvhB) {
+    auto tasks = treeTasks(bvhA, bvhB, taskTarget(), SameFrame());
+    std::atomic<size_t> count{0};
+    parallelTasks(tasks.size(), [&](size_t task) {
+        std::vector<uint64_t> pairs;
+        forEachTreeCandidate(a, bvhA, b, bvhB, tasks[task].first, tasks[task].second, SameFrame(),
+                             [&](uint32_t i, uint32_t j) { pairs.push_back(uint64_t(i) << 32 | j); });
+        size_t local = 0;
+        forEachSurvivor(a, b, SameFrame(), pairs, [&](const Triangle& triA, const Triangle& triB) {
+            local += trianglesIntersect(triA, triB);
+            return true;
+        });
+        count += local;
+    });
+    return count;
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void intersectMeshes(const std::vector<Triangle>& a, const std::vector<Triangle>& b,
+                     std::vector<std::pair<POINT, POINT>>& segments,
+                     BroadPhase phase, BroadPhaseStats* stats) {
+    BroadPhaseStats local;
+    BroadPhaseStats& s = stats ? *stats : local;
+    s = BroadPhaseStats();
+    if (a.empty() || b.empty())
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+    if (phase == BroadPhase::Grid) {
+        UniformGrid grid;
+        grid.build(a, b);
+        s.buildMs = millisecondsSince(start);
+        start = std::chrono::steady_clock::now();
+        // Equal entry ranges; each task covers the cells starting in its range
+        size_t tasks = std::min(taskTarget(), std::max<size_t>(grid.entryCount() / 256, 1));
+        s.candidates = intersectTasks(tasks, a, b, segments, [&](size_t task, auto emit) {
+            grid.forEachCandidatePair(emit, grid.entryCount() * task / tasks, grid.entryCount() * (task + 1) / tasks);
+        });
+    } else {
+        // Both trees answer this one query only, so the cheaper build wins
+        BVH bvhA, bvhB;
+        bvhA.build(a, true, BVH::Split::Median);
+        bvhB.build(b, true, BVH::Split::Median);
+        s.buildMs = millisecondsSince(start);
+        start = std::chrono::steady_clock::now();
+        auto tasks = treeTasks(bvhA, bvhB, taskTarget(), SameFrame());
+        s.candidates = intersectTasks(tasks.size(), a, b, segments, [&](size_t task, auto emit) {
+            forEachTreeCandidate(a, bvhA, b, bvhB, tasks[task].first, tasks[task].second, SameFrame(), emit);
+        });
+    }
+    s.queryMs = millisecondsSince(start);
+}
+
+void RigidIntersection::reset() {
+    bvhA.reset();
+    bvhB.reset();
+    built = false;
+    haveCandidates = false;
+    taskPairs.clear();
+    havePrevious = false;
+}
+
+float RigidIntersection::displacement(const RigidTransform& from, const RigidTransform& to) const {
+    // A point p = centerB + q with |q| <= radiusB moves by
+    // (to.r - from.r) * centerB + (to.t - from.t) + (to.r - from.r) * q
+    double frobenius = 0.0;
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j) {
+            double d = double(to.r[i][j]) - from.r[i][j];
+            frobenius += d * d;
+        }
+    POINT p = to.apply(centerB);
+    POINT q = from.apply(centerB);
+    double dx = double(p.x) - q.x, dy = double(p.y) - q.y, dz = double(p.z) - q.z;
+    return float(std::sqrt(dx * dx + dy * dy + dz * dz) + std::sqrt(frobenius) * radiusB);
+}
+
+void RigidIntersection::intersect(const std::vector<Triangle>& a, const RigidTransform& placeA,
+                                  const std::vector<Triangle>& b, const RigidTransform& placeB,
+                                  std::vector<std::pair<POINT, POINT>>& segments, BroadPhaseStats* stats,
+                                  std::shared_ptr<const BVH> treeA, std::shared_ptr<const BVH> treeB) {
+    BroadPhaseStats local;
+    BroadPhaseStats& s = stats ? *stats : local;
+    s = BroadPhaseStats();
+    segments.clear();
+    if (a.empty() || b.empty())
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+    if (!built) {
+        auto buildOver = [](const std::vector<Triangle>& triangles) {
+            auto tree = std::make_shared<BVH>();
+            tree->build(triangles);
+            return std::shared_ptr<const BVH>(std::move(tree));
+        };
+        bvhA = treeA ? std::move(treeA) : buildOver(a);
+        bvhB = treeB ? std::move(treeB) : buildOver(b);
+        const AABB& box = bvhB->nodes[0].bounds;
+        centerB = box.center();
+        float dx = box.max.x - box.min.x, dy = box.max.y - box.min.y, dz = box.max.z - box.min.z;
+        radiusB = 0.5f * std::sqrt(dx * dx + dy * dy + dz * dz);
+        // A quarter of the mean largest extent of b's triangles: a wider
+        // margin multiplies the candidates faster than it saves traversals
+        double sum = 0.0;
+        for (const Triangle& t : b) {
+            AABB tb = triangleBounds(t);
+            sum += std::max(tb.max.x - tb.min.x, std::max(tb.max.y - tb.min.y, tb.max.z - tb.min.z));
+        }
+        maxMargin = float(0.25 * sum / double(b.size()));
+        built = true;
+        haveCandidates = false;
+        havePrevious = false;
+    }
+    s.buildMs = millisecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    RigidTransform bToA = placeA.inverse() * placeB;
+    // How far b moved since the last call predicts the next step
+    float step = havePrevious ? displacement(previousFrame, bToA) : 0.0f;
+    previousFrame = bToA;
+    havePrevious = true;
+    MovedFrame frame{ { bToA, 0.0f } };
+    if (haveCandidates && displacement(candidateFrame, bToA) <= margin) {
+        s.reused = true;
+    } else {
+        // Collect the candidates of the new placement with room for a few
+        // more steps like the last one. Without motion, or when the steps are
+        // too long to reuse anything, the boxes stay tight.
+        margin = step > 0.0f && step < maxMargin ? std::min(4.0f * step, maxMargin) : 0.0f;
+        frame.node.margin = margin;
+        const BVH& treeA = *bvhA;
+        const BVH& treeB = *bvhB;
+        auto tasks = treeTasks(treeA, treeB, taskTarget(), frame);
+        taskPairs.assign(tasks.size(), std::vector<uint64_t>());
+        parallelTasks(tasks.size(), [&](size_t task) {
+            std::vector<uint64_t>& pairs = taskPairs[task];
+            forEachTreeCandidate(a, treeA, b, treeB, tasks[task].first, tasks[task].second, frame,
+                                 [&](uint32_t i, uint32_t j) { pairs.push_back(uint64_t(i) << 32 | j); });
+        });
+        candidateFrame = bToA;
+        haveCandidates = true;
+        frame.node.margin = 0.0f;
+    }
+    for (const auto& pairs : taskPairs)
+        s.candidates += pairs.size();
+
+    collectSegments(taskPairs.size(), segments, [&](size_t task, std::vector<std::pair<POINT, POINT>>& out) {
+        narrowPhase(a, b, frame, taskPairs[task], out);
+    });
+    if (!placeA.isIdentity()) {
+        parallelFor(segments.size(), 1 << 14, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k)
+                segments[k] = { placeA.apply(segments[k].first), placeA.apply(segments[k].second) };
+        });
+    }
+    s.queryMs = millisecondsSince(start);
+}
@@ -6,11 +6,25 @@
 #include "intersection.h"
 #include "stlwidget.h"
 #include "stlparser.h"
+#include "meshexport.h"
+#include "meshset.h"
+#include "meshboolean.h"
+#include "meshdistance.h"
+#include "outofcore.h"
+#include "trianglebatch.h"
+#include <QApplication>
+#include <QColorDialog>
+#include <QDebug>
+#include <QFileInfo>
+#include <QLabel>
+#include <QPixmap>
+#include <QSignalBlocker>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
 {
     qDebug() << "MainWindow constructor called.";
+    booleanPool.setMaxThreadCount(1);
     resize(1024, 768);
     setWindowTitle("OpenGL & QT");
 
@@ -32,13 +46,21 @@ MainWindow::MainWindow(QWidget *parent)
     extrudeButton = new QPushButton("Extrude", this);
     layout->addWidget(extrudeButton);
 
+    exportButton = new QPushButton("Export", this);
+    layout->addWidget(exportButton);
+
     connect(pushButton, &QPushButton::clicked, this, &MainWindow::onAddShapeButtonClicked);
     connect(extrudeButton, &QPushButton::clicked, this, &MainWindow::onExtrudeButtonClicked);
+    connect(exportButton, &QPushButton::clicked, this, &MainWindow::onExportButtonClicked);
     selectedShape = comboBox->currentText();
 
     connect(comboBox, &QComboBox::currentTextChanged, this, [this](const QString &text)
             { selectedShape = text; });
 
+    importer = new STLImporter(this);
+    connect(importer, &STLImporter::meshLoaded, this, &MainWindow::onMeshLoaded);
+    connect(importer, &STLImporter::finished, this, &MainWindow::onImportFinished);
+
     mainWidget->setLayout(layout);
     setCentralWidget(mainWidget);
     qDebug() << "MainWindow setup complete.";
@@ -46,6 +68,8 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    // The running boolean calls back into the window; its result is dropped
+    booleanPool.waitForDone();
 }
 
 void MainWindow::onExtrudeButtonClicked()
@@ -65,6 +89,24 @@ void MainWindow::onExtrudeButtonClicked()
     }
 }
 
+void MainWindow::onExportButtonClicked()
+{
+    if (selectedShape != "Cube" || !glWidget)
+    {
+        QMessageBox::information(this, "Info", "Export is available for cubes here; revolutions and STL results have their own export buttons.");
+        return;
+    }
+    std::vector<Triangle> triangles = glWidget->cubeTriangles();
+    if (triangles.empty())
+    {
+        QMessageBox::information(this, "Export", "Draw a cube first.");
+        return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(this, "Export Cube", "", "Binary STL (*.stl);;Binary PLY (*.ply)");
+    if (!fileName.isEmpty() && !exportTriangles(fileName.toStdString(), triangles))
+        QMessageBox::warning(this, "Export", "Failed to write " + fileName);
+}
+
 void MainWindow::onAddShapeButtonClicked()
 {
     if (!glWidget)
@@ -112,14 +154,62 @@ void MainWindow::onAddShapeButtonClicked()
         QWidget *centralWidget = new QWidget(this);
         QHBoxLayout *layout = new QHBoxLayout(centralWidget);
 
-        importButton = new QPushButton("Import STL File", this);
+        importButton = new QPushButton("Import Mesh Files", this);
         intersectionButton = new QPushButton("Intersect Shapes", this);
+        exportResultButton = new QPushButton("Export...", this);
         stlwidget = new STLWidget(this);
 
+        // Progress of a running import; hidden while idle
+        importProgress = new QProgressBar(this);
+        importProgress->setRange(0, 100);
+        importProgress->hide();
+        cancelImportButton = new QPushButton("Cancel Import", this);
+        cancelImportButton->hide();
+        // Order matches STLImporter::Storage
+        storageCombo = new QComboBox(this);
+        storageCombo->addItems({"Full precision", "Out-of-core", "Compact 16-bit", "Compact 21-bit"});
+        storageCombo->setToolTip("Out-of-core keeps binary STL / .stlc meshes on disk and pages them in blocks; "
+                                 "compact modes hold quantized meshes in memory");
+        // Order matches BroadPhase
+        broadPhaseCombo = new QComboBox(this);
+        broadPhaseCombo->addItems({"BVH broad phase", "Grid broad phase"});
+        broadPhaseCombo->setToolTip("How candidate triangle pairs are found; the grid suits meshes with uniform triangle sizes");
+        // Order matches BooleanOp
+        booleanCombo = new QComboBox(this);
+        booleanCombo->addItems({"A union B", "A intersect B", "A minus B"});
+        booleanButton = new QPushButton("Combine A and B", this);
+        booleanButton->setToolTip("Adds the result as a new mesh; both meshes should be closed");
+        distanceButton = new QPushButton("Measure Distance", this);
+        distanceButton->setToolTip("Minimum and Hausdorff distances between A and B");
+        reorderCheck = new QCheckBox("Spatial reorder", this);
+        reorderCheck->setToolTip("Sort triangles along a Morton curve after loading for cache-friendly passes");
+
+        // Loaded meshes: checkbox toggles visibility, double-click picks a color
+        meshList = new QListWidget(this);
+        pairACombo = new QComboBox(this);
+        pairBCombo = new QComboBox(this);
+        pairBCombo->setToolTip("Right-drag in the view moves mesh B, Shift+drag rotates it");
+        QHBoxLayout *pairLayout = new QHBoxLayout();
+        pairLayout->addWidget(new QLabel("A:", this));
+        pairLayout->addWidget(pairACombo, 1);
+        pairLayout->addWidget(new QLabel("B:", this));
+        pairLayout->addWidget(pairBCombo, 1);
+
         // Create a vertical layout for the buttons
         QVBoxLayout *buttonLayout = new QVBoxLayout();
         buttonLayout->addWidget(importButton);
+        buttonLayout->addWidget(storageCombo);
+        buttonLayout->addWidget(reorderCheck);
+        buttonLayout->addWidget(meshList, 1);
+        buttonLayout->addLayout(pairLayout);
+        buttonLayout->addWidget(broadPhaseCombo);
         buttonLayout->addWidget(intersectionButton);
+        buttonLayout->addWidget(booleanCombo);
+        buttonLayout->addWidget(booleanButton);
+        buttonLayout->addWidget(distanceButton);
+        buttonLayout->addWidget(exportResultButton);
+        buttonLayout->addWidget(importProgress);
+        buttonLayout->addWidget(cancelImportButton);
 
         layout->addWidget(stlwidget, 1);
         layout->addLayout(buttonLayout); // Add the vertical layout to the horizontal layout
@@ -128,6 +218,19 @@ void MainWindow::onAddShapeButtonClicked()
 
         connect(importButton, &QPushButton::clicked, this, &MainWindow::onImportSTL);
         connect(intersectionButton, &QPushButton::clicked, this, &MainWindow::onFindIntersection);
+        connect(stlwidget, &STLWidget::intersectionReady, this, &MainWindow::onIntersectionReady);
+        connect(booleanButton, &QPushButton::clicked, this, &MainWindow::onMeshBoolean);
+        connect(distanceButton, &QPushButton::clicked, this, &MainWindow::onMeasureDistance);
+        connect(exportResultButton, &QPushButton::clicked, this, &MainWindow::onExportSTLResult);
+        connect(cancelImportButton, &QPushButton::clicked, importer, &STLImporter::cancel);
+        connect(importer, &STLImporter::progressChanged, importProgress, &QProgressBar::setValue);
+        connect(meshList, &QListWidget::itemChanged, this, &MainWindow::onMeshItemChanged);
+        connect(meshList, &QListWidget::itemDoubleClicked, this, &MainWindow::onMeshItemDoubleClicked);
+        connect(pairACombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::onIntersectionPairChanged);
+        connect(pairBCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::onIntersectionPairChanged);
+        connect(broadPhaseCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this,
+                [this](int index) { stlwidget->setBroadPhase(BroadPhase(index)); });
+        refreshMeshList();
 
         stlwidget->setAttribute(Qt::WA_DeleteOnClose);
         stlwidget->resize(800, 600);
@@ -391,36 +494,297 @@ void MainWindow::onAddCylinderSpecs()
 
 void MainWindow::onImportSTL()
 {
-    static bool loadToA = true;
-    QString fileName = QFileDialog::getOpenFileName(this, "Open STL File", "", "STL Files (*.stl)");
-    if (!fileName.isEmpty())
+    if (importer->isRunning())
     {
-        std::vector<Triangle> tris;
-        if (loadSTLFile(fileName.toStdString(), tris))
-        {
-            if (loadToA)
-            {
-                trianglesA = tris;
-                QMessageBox::information(this, "Import STL", "Loaded as A: " + fileName);
-            }
-            else
-            {
-                trianglesB = tris;
-                QMessageBox::information(this, "Import STL", "Loaded as B: " + fileName);
-            }
-            loadToA = !loadToA;
-            stlwidget->update();
-        }
-        else
-        {
-            QMessageBox::warning(this, "Import STL", "Failed to load STL file.");
-        }
+        QMessageBox::information(this, "Import STL", "An import is already running.");
+        return;
+    }
+    auto storage = STLImporter::Storage(storageCombo->currentIndex());
+    QString filter = storage == STLImporter::OutOfCore ? "Binary STL or mesh cache (*.stl *.stlc)" : "Mesh Files (*.stl *.stl.gz *.obj *.ply)";
+    QStringList fileNames = QFileDialog::getOpenFileNames(this, "Open Mesh Files", "", filter);
+    if (!fileNames.isEmpty())
+    {
+        // The files are parsed concurrently on the importer's pool; every
+        // finished one arrives in onMeshLoaded
+        importFailures.clear();
+        importProgress->setValue(0);
+        importProgress->show();
+        cancelImportButton->show();
+        importButton->setEnabled(false);
+        importer->setSpatialReorder(reorderCheck->isChecked());
+        importer->start(fileNames, storage);
+    }
+}
+
+void MainWindow::onMeshLoaded(int job, bool ok)
+{
+    std::unique_ptr<MeshEntry> mesh = importer->takeMesh(job);
+    if (!ok || !mesh)
+    {
+        importFailures << QFileInfo(importer->fileName(job)).fileName();
+        return;
+    }
+    meshSet.add(std::move(mesh));
+    refreshMeshList();
+    stlwidget->update();
+}
+
+void MainWindow::onImportFinished(int loaded, bool cancelled)
+{
+    importProgress->hide();
+    cancelImportButton->hide();
+    importButton->setEnabled(true);
+
+    if (cancelled)
+        QMessageBox::information(this, "Import STL", QString("Import cancelled; %1 mesh(es) loaded.").arg(loaded));
+    else if (!importFailures.isEmpty())
+        QMessageBox::warning(this, "Import STL", "Failed to load: " + importFailures.join(", "));
+}
+
+// Rebuilds the list and pair selectors from meshSet
+void MainWindow::refreshMeshList()
+{
+    if (!meshList)
+        return;
+    QSignalBlocker blockList(meshList);
+    QSignalBlocker blockA(pairACombo);
+    QSignalBlocker blockB(pairBCombo);
+    meshList->clear();
+    pairACombo->clear();
+    pairBCombo->clear();
+    for (size_t i = 0; i < meshSet.size(); ++i)
+    {
+        const MeshEntry &mesh = meshSet[i];
+        QString name = QString::fromStdString(mesh.name);
+        QPixmap swatch(12, 12);
+        swatch.fill(QColor::fromRgbF(mesh.color[0], mesh.color[1], mesh.color[2]));
+        auto *item = new QListWidgetItem(QIcon(swatch), QString("%1 (%2 triangles)").arg(name).arg(mesh.triangleCount()), meshList);
+        item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
+        item->setCheckState(mesh.visible ? Qt::Checked : Qt::Unchecked);
+        pairACombo->addItem(name);
+        pairBCombo->addItem(name);
     }
+    pairACombo->setCurrentIndex(meshSet.pairA());
+    pairBCombo->setCurrentIndex(meshSet.pairB());
+}
+
+void MainWindow::onMeshItemChanged(QListWidgetItem *item)
+{
+    int row = meshList->row(item);
+    if (row < 0 || row >= int(meshSet.size()))
+        return;
+    meshSet[row].visible = item->checkState() == Qt::Checked;
+    stlwidget->update();
+}
+
+void MainWindow::onMeshItemDoubleClicked(QListWidgetItem *item)
+{
+    int row = meshList->row(item);
+    if (row < 0 || row >= int(meshSet.size()))
+        return;
+    MeshEntry &mesh = meshSet[row];
+    QColor color = QColorDialog::getColor(QColor::fromRgbF(mesh.color[0], mesh.color[1], mesh.color[2]), this,
+                                          "Color of " + QString::fromStdString(mesh.name));
+    if (!color.isValid())
+        return;
+    mesh.color[0] = float(color.redF());
+    mesh.color[1] = float(color.greenF());
+    mesh.color[2] = float(color.blueF());
+    refreshMeshList();
+    stlwidget->update();
+}
+
+void MainWindow::onIntersectionPairChanged()
+{
+    meshSet.setIntersectionPair(pairACombo->currentIndex(), pairBCombo->currentIndex());
+    stlwidget->update();
+}
+
+void MainWindow::onExportSTLResult()
+{
+    QStringList options;
+    for (size_t i = 0; i < meshSet.size(); ++i)
+        options << QString::fromStdString(meshSet[i].name);
+    options << "Intersection curve";
+    bool ok;
+    QString choice = QInputDialog::getItem(this, "Export", "What to export:", options, options.size() - 1, false, &ok);
+    if (!ok)
+        return;
+
+    int index = options.indexOf(choice);
+    if (index == options.size() - 1)
+    {
+        QString fileName = QFileDialog::getSaveFileName(this, "Export Intersection Curve", "", "Binary PLY (*.ply)");
+        if (!fileName.isEmpty() && !writeSegmentsPLY(fileName.toStdString(), stlwidget->segments()))
+            QMessageBox::warning(this, "Export", "Failed to write " + fileName);
+        return;
+    }
+
+    const MeshEntry &mesh = meshSet[index];
+    if (dynamic_cast<OutOfCoreMesh *>(mesh.blocked.get()))
+    {
+        QMessageBox::information(this, "Export", "Out-of-core meshes are exported from their source file.");
+        return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(this, "Export " + choice, "", "Binary STL (*.stl);;Binary PLY (*.ply)");
+    if (!fileName.isEmpty() && !exportTriangles(fileName.toStdString(), mesh.toTriangles()))
+        QMessageBox::warning(this, "Export", "Failed to write " + fileName);
 }
 
 void MainWindow::onFindIntersection()
 {
-    // Just update the GLWidget to show intersection (if any) between trianglesA and trianglesB
+    // Computed once per pair and geometry; orbiting the view only redraws it
+    if (!meshSet.meshA() || !meshSet.meshB())
+    {
+        QMessageBox::information(this, "Find Intersection", "Load two meshes first.");
+        return;
+    }
+    // The view stays usable meanwhile; the result is shown once it is ready
+    if (!intersectionReportPending)
+        QApplication::setOverrideCursor(Qt::BusyCursor);
+    intersectionReportPending = true;
+    stlwidget->computeIntersection();
+}
+
+void MainWindow::onIntersectionReady()
+{
+    // Drag steps are ready too, but only a Find Intersection gets a report
+    if (!intersectionReportPending)
+        return;
+    intersectionReportPending = false;
+    QApplication::restoreOverrideCursor();
+    const PolylineStats& stats = stlwidget->polylineStats();
+    QString text = QString("%1 intersection segment(s) chained into %2 polyline(s), %3 closed, total length %4.")
+                       .arg(stlwidget->segments().size())
+                       .arg(stlwidget->polylines().size())
+                       .arg(stats.loops)
+                       .arg(stats.length);
+    const MeshEntry *meshA = meshSet.meshA(), *meshB = meshSet.meshB();
+    if (meshA && meshB && !meshA->blocked && !meshB->blocked)
+    {
+        const BroadPhaseStats& broad = stlwidget->broadPhaseStats();
+        text += QString("\n%1: build %2 ms, query %3 ms, %4 candidate pair(s); narrow phase on %5.")
+                    .arg(broadPhaseCombo->currentText())
+                    .arg(broad.buildMs, 0, 'f', 1)
+                    .arg(broad.queryMs, 0, 'f', 1)
+                    .arg(broad.candidates)
+                    .arg(triangleBatchKernel());
+    }
+    QMessageBox::information(this, "Find Intersection", text);
+}
+
+// A boolean computed on booleanPool, handed back to the GUI thread
+struct MainWindow::BooleanJob
+{
+    std::unique_ptr<MeshEntry> result = std::make_unique<MeshEntry>();
+    bool ok = false;
+};
+
+// The pair and its placements are taken here, so the meshes can be moved or
+// removed while the boolean runs; the result is added when it is done
+void MainWindow::onMeshBoolean()
+{
+    MeshEntry *meshA = meshSet.meshA();
+    MeshEntry *meshB = meshSet.meshB();
+    if (!meshA || !meshB || meshA == meshB)
+    {
+        QMessageBox::information(this, "Combine Meshes", "Pick two different meshes as A and B first.");
+        return;
+    }
+    if (meshA->triangleCount() == 0 || meshB->triangleCount() == 0)
+    {
+        QMessageBox::warning(this, "Combine Meshes", "Both meshes need triangles.");
+        return;
+    }
+    static const char *const symbols[] = { "+", "*", "-" };
+    BooleanOp op = BooleanOp(booleanCombo->currentIndex());
+
+    auto job = std::make_shared<BooleanJob>();
+    job->result->name = meshA->name + " " + symbols[int(op)] + " " + meshB->name;
+    std::shared_ptr<const MeshEntry> a = meshSet.share(size_t(meshSet.pairA()));
+    std::shared_ptr<const MeshEntry> b = meshSet.share(size_t(meshSet.pairB()));
+    RigidTransform placeA = meshA->transform, placeB = meshB->transform;
+    booleanButton->setEnabled(false);
+    QApplication::setOverrideCursor(Qt::BusyCursor);
+    booleanPool.start([this, job, a, b, placeA, placeB, op]()
+    {
+        job->ok = meshBoolean(a->placedTriangles(placeA), b->placedTriangles(placeB), op, job->result->triangles);
+        QMetaObject::invokeMethod(this, [this, job]() { onBooleanDone(*job); }, Qt::QueuedConnection);
+    });
+}
+
+// Runs on the GUI thread once the boolean has returned
+void MainWindow::onBooleanDone(BooleanJob &job)
+{
+    QApplication::restoreOverrideCursor();
+    booleanButton->setEnabled(true);
+    if (!job.ok)
+    {
+        QMessageBox::warning(this, "Combine Meshes",
+                             "The meshes could not be combined exactly: faces touch where rounding moves the cut, "
+                             "or a region lies only on edges of the other mesh. Moving one mesh slightly may help.");
+        return;
+    }
+    if (job.result->triangles.empty())
+    {
+        QMessageBox::information(this, "Combine Meshes", "The result is empty.");
+        return;
+    }
+    meshSet.add(std::move(job.result));
+    refreshMeshList();
     stlwidget->update();
-    QMessageBox::information(this, "Find Intersection", "Intersection (if any) is now shown in the view.");
-}
\ No newline at end of file
+}
+
+// Hierarchy over a mesh's placed triangles: the one from its cache while it
+// is still in its own frame, otherwise one built into `built`
+static const BVH &placedHierarchy(const MeshEntry &mesh, const std::vector<Triangle> &placed, BVH &built)
+{
+    if (mesh.bvh && mesh.transform.isIdentity() && !mesh.blocked)
+        return *mesh.bvh;
+    built.build(placed);
+    return built;
+}
+
+static QString pointText(const POINT &p)
+{
+    return QString("(%1, %2, %3)").arg(p.x).arg(p.y).arg(p.z);
+}
+
+void MainWindow::onMeasureDistance()
+{
+    MeshEntry *meshA = meshSet.meshA();
+    MeshEntry *meshB = meshSet.meshB();
+    if (!meshA || !meshB || meshA == meshB)
+    {
+        QMessageBox::information(this, "Measure Distance", "Pick two different meshes as A and B first.");
+        return;
+    }
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    std::vector<Triangle> a = meshA->placedTriangles(meshA->transform);
+    std::vector<Triangle> b = meshB->placedTriangles(meshB->transform);
+    BVH builtA, builtB;
+    const BVH &bvhA = placedHierarchy(*meshA, a, builtA);
+    const BVH &bvhB = placedHierarchy(*meshB, b, builtB);
+    MeshDistance closest, forward, backward;
+    bool ok = minimumDistance(a, bvhA, b, bvhB, closest) && hausdorffDistance(a, b, bvhB, forward) &&
+              hausdorffDistance(b, a, bvhA, backward);
+    QApplication::restoreOverrideCursor();
+    if (!ok)
+    {
+        QMessageBox::warning(this, "Measure Distance", "Both meshes need triangles.");
+        return;
+    }
+    QMessageBox::information(this, "Measure Distance",
+                             QString("Minimum distance %1, from %2 on A to %3 on B.\n"
+                                     "Hausdorff A to B %4, farthest at %5.\n"
+                                     "Hausdorff B to A %6, farthest at %7.\n"
+                                     "Symmetric Hausdorff %8.")
+                                 .arg(closest.distance)
+                                 .arg(pointText(closest.onA))
+                                 .arg(pointText(closest.onB))
+                                 .arg(forward.distance)
+                                 .arg(pointText(forward.onA))
+                                 .arg(backward.distance)
+                                 .arg(pointText(backward.onA))
+                                 .arg(std::max(forward.distance, backward.distance)));
+}
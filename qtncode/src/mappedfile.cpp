@@ -0,0 +1,127 @@
+#include "mappedfile.h"
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other) {
+        close();
+        std::swap(ptr, other.ptr);
+        std::swap(len, other.len);
+        std::swap(opened, other.opened);
+#ifdef _WIN32
+        std::swap(fileHandle, other.fileHandle);
+        std::swap(mapHandle, other.mapHandle);
+#endif
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& filename)
+{
+    close();
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    opened = true;
+    len = static_cast<size_t>(fileSize.QuadPart);
+    if (len == 0)
+        return true; // Empty files cannot be mapped but are still valid
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        close();
+        return false;
+    }
+    mapHandle = mapping;
+    ptr = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!ptr) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (ptr)
+        UnmapViewOfFile(ptr);
+    if (mapHandle)
+        CloseHandle(static_cast<HANDLE>(mapHandle));
+    if (fileHandle)
+        CloseHandle(static_cast<HANDLE>(fileHandle));
+    ptr = nullptr;
+    mapHandle = nullptr;
+    fileHandle = nullptr;
+    len = 0;
+    opened = false;
+}
+
+#else
+
+bool MappedFile::open(const std::string& filename)
+{
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    opened = true;
+    len = static_cast<size_t>(st.st_size);
+    if (len == 0) {
+        ::close(fd); // Empty files cannot be mapped but are still valid
+        return true;
+    }
+
+    void* p = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping keeps its own reference to the file
+    if (p == MAP_FAILED) {
+        len = 0;
+        opened = false;
+        return false;
+    }
+    ptr = static_cast<const char*>(p);
+    madvise(p, len, MADV_SEQUENTIAL);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (ptr)
+        munmap(const_cast<char*>(ptr), len);
+    ptr = nullptr;
+    len = 0;
+    opened = false;
+}
+
+#endif
@@ -0,0 +1,1129 @@
+#include "meshboolean.h"
+#include "intersection.h"
+#include "indexedmesh.h"
+#include "parallel.h"
+#include "predicates.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <tuple>
+#include <utility>
+
+// Location code of points whose place on the triangle is found
+// geometrically (corners of coplanar overlaps)
+static const int8_t LOCATE = -2;
+// No neighbouring face across an edge
+static const uint32_t NONE = UINT32_MAX;
+
+namespace {
+
+// Piece of the intersection curve, or of a coplanar overlap outline, on one triangle
+struct Cut {
+    uint32_t triangle;
+    POINT p, q;
+    int8_t onP, onQ; // Where p and q lie on the triangle (SegmentEnd codes) or LOCATE
+};
+
+// Point placed on edge k of a triangle (corner k to corner k + 1)
+struct EdgePoint {
+    POINT p;
+    int8_t edge;
+};
+
+// Where a point lies relative to the other solid. Same and Opposite mean on
+// its surface, with the normals facing the same or the opposite way.
+enum class Side : uint8_t { Outside, Inside, Same, Opposite };
+
+struct Vec3 {
+    double x, y, z;
+};
+
+Vec3 normalOf(const Triangle& t) {
+    double ux = double(t.p2.x) - t.p1.x, uy = double(t.p2.y) - t.p1.y, uz = double(t.p2.z) - t.p1.z;
+    double vx = double(t.p3.x) - t.p1.x, vy = double(t.p3.y) - t.p1.y, vz = double(t.p3.z) - t.p1.z;
+    return Vec3{ uy * vz - uz * vy, uz * vx - ux * vz, ux * vy - uy * vx };
+}
+
+double coord(const POINT& p, int axis) {
+    return axis == 0 ? p.x : axis == 1 ? p.y : p.z;
+}
+
+// Axis along which the normal is largest, or -1 for a degenerate triangle
+int dominantAxis(const Triangle& t) {
+    Vec3 n = normalOf(t);
+    double ax = std::fabs(n.x), ay = std::fabs(n.y), az = std::fabs(n.z);
+    if (ax == 0 && ay == 0 && az == 0)
+        return -1;
+    if (ax >= ay && ax >= az)
+        return 0;
+    return ay >= az ? 1 : 2;
+}
+
+// Orientation of a, b, c seen along axis (the other two coordinates in
+// right-handed order, so the sign matches the normal's component on axis)
+double orientAlong(int axis, const POINT& a, const POINT& b, const POINT& c) {
+    int u = (axis + 1) % 3, v = (axis + 2) % 3;
+    return orient2d(coord(a, u), coord(a, v), coord(b, u), coord(b, v), coord(c, u), coord(c, v));
+}
+
+bool lessPoint(const POINT& a, const POINT& b) {
+    return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+}
+
+bool samePoint(const POINT& a, const POINT& b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+// Subdivision of one triangle along constraint segments. It works in the
+// coordinate plane the triangle faces most directly, with every face kept
+// counterclockwise there and linked to its neighbours. Points on the
+// triangle's edges split the edge itself, so neighbouring triangles that get
+// the same points stay conforming. Constraints never add vertices of their
+// own (see addConstraint).
+class TriangleSplitter {
+public:
+    // False for a degenerate triangle, which is kept whole
+    bool start(const Triangle& t) {
+        axis = dominantAxis(t);
+        if (axis < 0)
+            return false;
+        points = { t.p1, t.p2, t.p3 };
+        onEdge = { -1, -1, -1 };
+        double o = orientAlong(axis, t.p1, t.p2, t.p3);
+        if (o == 0)
+            return false;
+        flipped = o < 0;
+        faces.clear();
+        constrained.clear();
+        faces.push_back(flipped ? Face{ { 0, 2, 1 }, { NONE, NONE, NONE } } : Face{ { 0, 1, 2 }, { NONE, NONE, NONE } });
+        vertexFace = { 0, 0, 0 };
+        lastFace = 0;
+        return true;
+    }
+
+    // Vertex for p, which lies where `on` says (SegmentEnd code or LOCATE)
+    uint32_t addPoint(const POINT& p, int8_t on) {
+        if (on >= 3)
+            return uint32_t(on - 3);
+        if (on >= 0) {
+            uint32_t v = insertOnBoundary(p, on);
+            if (v != NONE)
+                return v;
+        }
+        return insertLocated(p);
+    }
+
+    // Makes the segment a-b a union of face edges. Edges it crosses are
+    // flipped out of the way rather than split, so no vertex is added that
+    // the other mesh's copy of the segment would not have. Returns false if
+    // rounded points left the faces too inconsistent to find the way to b;
+    // the constraint is then (partly) left out.
+    bool addConstraint(uint32_t a, uint32_t b) {
+        for (size_t guard = 0; a != b && guard < points.size(); ++guard) {
+            uint32_t first = NONE, c1 = NONE, c2 = NONE;
+            bool found = anyFaceAround(a, [&](uint32_t f, int i) {
+                const Face& face = faces[f];
+                uint32_t u = face.v[(i + 1) % 3], w = face.v[(i + 2) % 3];
+                if (u == b || w == b) {
+                    a = markConstrained(a, b);
+                    return true;
+                }
+                double o1 = orient(a, u, b), o2 = orient(a, b, w);
+                if (o1 == 0 && ahead(a, b, u)) {
+                    a = markConstrained(a, u);
+                    return true;
+                }
+                if (o2 == 0 && ahead(a, b, w)) {
+                    a = markConstrained(a, w);
+                    return true;
+                }
+                if (o1 > 0 && o2 > 0) {
+                    first = f;
+                    c1 = u;
+                    c2 = w;
+                    return true;
+                }
+                return false;
+            });
+            if (!found)
+                return false;
+            if (first == NONE)
+                continue;
+
+            // Edges crossed on the way to b, or to a vertex lying exactly on a-b
+            crossing.clear();
+            crossing.emplace_back(c1, c2);
+            uint32_t f = first, target = NONE;
+            while (target == NONE) {
+                int e = edgeIndex(f, c1, c2);
+                uint32_t g = faces[f].n[e];
+                if (g == NONE)
+                    return false;
+                int k = edgeIndex(g, c2, c1);
+                uint32_t w = faces[g].v[(k + 2) % 3];
+                double side = w == b ? 0.0 : orient(a, b, w);
+                if (side == 0)
+                    target = w;
+                else if (side > 0)
+                    crossing.emplace_back(c1, c2 = w);
+                else
+                    crossing.emplace_back(c1 = w, c2);
+                f = g;
+            }
+            if (!flipAway(a, target))
+                return false;
+            a = markConstrained(a, target);
+        }
+        return a == b;
+    }
+
+    // Appends the faces with the triangle's original winding, and for each
+    // the edges that run along a constraint (bit k for edge k)
+    void emit(std::vector<Triangle>& out, std::vector<uint8_t>& cutEdges) const {
+        for (const Face& f : faces) {
+            uint8_t bits[3];
+            for (int e = 0; e < 3; ++e)
+                bits[e] = isConstrained(f.v[e], f.v[(e + 1) % 3]);
+            if (flipped) {
+                out.emplace_back(points[f.v[0]], points[f.v[2]], points[f.v[1]]);
+                cutEdges.push_back(uint8_t(bits[2] | bits[1] << 1 | bits[0] << 2));
+            } else {
+                out.emplace_back(points[f.v[0]], points[f.v[1]], points[f.v[2]]);
+                cutEdges.push_back(uint8_t(bits[0] | bits[1] << 1 | bits[2] << 2));
+            }
+        }
+    }
+
+    // Appends the vertices added on the triangle's own edges
+    void boundaryPoints(std::vector<EdgePoint>& out) const {
+        for (uint32_t v = 3; v < points.size(); ++v)
+            if (onEdge[v] >= 0)
+                out.push_back(EdgePoint{ points[v], onEdge[v] });
+    }
+
+private:
+    struct Face {
+        uint32_t v[3];
+        uint32_t n[3]; // Neighbour across edge v[k] -> v[k + 1]
+    };
+
+    double orient(uint32_t a, uint32_t b, uint32_t c) const {
+        return orientAlong(axis, points[a], points[b], points[c]);
+    }
+    double orient(uint32_t a, uint32_t b, const POINT& c) const {
+        return orientAlong(axis, points[a], points[b], c);
+    }
+    uint32_t markConstrained(uint32_t a, uint32_t b) {
+        constrained.emplace_back(std::min(a, b), std::max(a, b));
+        return b;
+    }
+    bool isConstrained(uint32_t a, uint32_t b) const {
+        return std::find(constrained.begin(), constrained.end(), std::make_pair(std::min(a, b), std::max(a, b))) !=
+               constrained.end();
+    }
+
+    // Whether c lies on the ray from a through b (given it is on the line)
+    bool ahead(uint32_t a, uint32_t b, uint32_t c) const {
+        const POINT& pa = points[a];
+        const POINT& pb = points[b];
+        const POINT& pc = points[c];
+        return (double(pb.x) - pa.x) * (double(pc.x) - pa.x) + (double(pb.y) - pa.y) * (double(pc.y) - pa.y) +
+                   (double(pb.z) - pa.z) * (double(pc.z) - pa.z) > 0;
+    }
+
+    uint32_t newVertex(const POINT& p, int8_t edge) {
+        points.push_back(p);
+        onEdge.push_back(edge);
+        vertexFace.push_back(NONE);
+        return uint32_t(points.size() - 1);
+    }
+
+    void setFace(uint32_t f, uint32_t a, uint32_t b, uint32_t c, uint32_t nab, uint32_t nbc, uint32_t nca) {
+        if (f == faces.size())
+            faces.push_back(Face());
+        faces[f] = Face{ { a, b, c }, { nab, nbc, nca } };
+        vertexFace[a] = vertexFace[b] = vertexFace[c] = f;
+    }
+
+    void replaceNeighbour(uint32_t f, uint32_t from, uint32_t to) {
+        if (f == NONE)
+            return;
+        for (uint32_t& n : faces[f].n)
+            if (n == from)
+                n = to;
+    }
+
+    uint32_t splitFace(uint32_t f, const POINT& p) {
+        uint32_t x = newVertex(p, -1);
+        Face old = faces[f];
+        uint32_t f1 = uint32_t(faces.size()), f2 = f1 + 1;
+        setFace(f, old.v[0], old.v[1], x, old.n[0], f1, f2);
+        setFace(f1, old.v[1], old.v[2], x, old.n[1], f2, f);
+        setFace(f2, old.v[2], old.v[0], x, old.n[2], f, f1);
+        replaceNeighbour(old.n[1], f, f1);
+        replaceNeighbour(old.n[2], f, f2);
+        lastFace = f;
+        return x;
+    }
+
+    // Splits edge e of face f (and the face across it) at p
+    uint32_t splitEdge(uint32_t f, int e, const POINT& p, int8_t boundaryEdge = -1) {
+        uint32_t x = newVertex(p, boundaryEdge);
+        Face t = faces[f];
+        uint32_t a = t.v[e], b = t.v[(e + 1) % 3], c = t.v[(e + 2) % 3];
+        uint32_t nbc = t.n[(e + 1) % 3], nca = t.n[(e + 2) % 3];
+        uint32_t u = t.n[e];
+        uint32_t f2 = uint32_t(faces.size());
+        if (u == NONE) {
+            setFace(f, a, x, c, NONE, f2, nca);
+            setFace(f2, x, b, c, NONE, nbc, f);
+            replaceNeighbour(nbc, f, f2);
+        } else {
+            Face w = faces[u];
+            int g = 0;
+            while (w.n[g] != f)
+                ++g;
+            uint32_t d = w.v[(g + 2) % 3]; // w is (b, a, d)
+            uint32_t nad = w.n[(g + 1) % 3], ndb = w.n[(g + 2) % 3];
+            uint32_t u2 = f2 + 1;
+            setFace(f, a, x, c, u2, f2, nca);
+            setFace(f2, x, b, c, u, nbc, f);
+            setFace(u, b, x, d, f2, u2, ndb);
+            setFace(u2, x, a, d, f, nad, u);
+            replaceNeighbour(nbc, f, f2);
+            replaceNeighbour(nad, u, u2);
+        }
+        lastFace = f;
+        return x;
+    }
+
+    // Index of the directed edge u -> v in face f
+    int edgeIndex(uint32_t f, uint32_t u, uint32_t v) const {
+        const Face& face = faces[f];
+        for (int e = 0; e < 3; ++e)
+            if (face.v[e] == u && face.v[(e + 1) % 3] == v)
+                return e;
+        return -1;
+    }
+
+    // Replaces the edge e of face f and its twin by the other diagonal of
+    // the quadrilateral they form
+    void flipEdge(uint32_t f, int e) {
+        Face t = faces[f];
+        uint32_t g = t.n[e];
+        uint32_t u = t.v[e], v = t.v[(e + 1) % 3], p = t.v[(e + 2) % 3];
+        Face w = faces[g];
+        int k = edgeIndex(g, v, u);
+        uint32_t q = w.v[(k + 2) % 3];
+        uint32_t nvp = t.n[(e + 1) % 3], npu = t.n[(e + 2) % 3];
+        uint32_t nuq = w.n[(k + 1) % 3], nqv = w.n[(k + 2) % 3];
+        setFace(f, p, u, q, npu, nuq, g);
+        setFace(g, q, v, p, nqv, nvp, f);
+        replaceNeighbour(nuq, g, f);
+        replaceNeighbour(nvp, f, g);
+        lastFace = f;
+    }
+
+    // Flips the queued edges crossing a-b until none is left (Sloan's
+    // method): an edge whose quadrilateral is not convex waits for its
+    // neighbours to be flipped first
+    bool flipAway(uint32_t a, uint32_t b) {
+        size_t budget = 8 * crossing.size() * crossing.size() + 64;
+        for (size_t next = 0; next < crossing.size(); ++next) {
+            if (--budget == 0)
+                return false;
+            uint32_t u = crossing[next].first, v = crossing[next].second;
+            uint32_t f = NONE;
+            int e = -1;
+            anyFaceAround(u, [&](uint32_t g, int i) {
+                if (faces[g].v[(i + 1) % 3] != v)
+                    return false;
+                f = g;
+                e = i;
+                return true;
+            });
+            if (f == NONE || faces[f].n[e] == NONE)
+                return false;
+            uint32_t p = faces[f].v[(e + 2) % 3];
+            uint32_t g = faces[f].n[e];
+            uint32_t q = faces[g].v[(edgeIndex(g, v, u) + 2) % 3];
+            double ou = orient(p, q, u), ov = orient(p, q, v);
+            if (!((ou < 0 && ov > 0) || (ou > 0 && ov < 0))) {
+                crossing.emplace_back(u, v); // Not convex yet
+                continue;
+            }
+            flipEdge(f, e);
+            double op = orient(a, b, p), oq = orient(a, b, q);
+            if ((op < 0 && oq > 0) || (op > 0 && oq < 0))
+                crossing.emplace_back(p, q);
+        }
+        return true;
+    }
+
+    // Calls fn(face, index of v in it) for the faces around v until it returns true
+    template <typename Fn>
+    bool anyFaceAround(uint32_t v, Fn fn) {
+        uint32_t start = vertexFace[v];
+        if (start == NONE)
+            return false;
+        auto indexIn = [&](uint32_t f) {
+            const Face& face = faces[f];
+            return face.v[0] == v ? 0 : face.v[1] == v ? 1 : 2;
+        };
+        // Clockwise across the edge ending at v, then counterclockwise if a boundary stopped it
+        uint32_t f = start;
+        do {
+            int i = indexIn(f);
+            if (fn(f, i))
+                return true;
+            f = faces[f].n[(i + 2) % 3];
+        } while (f != NONE && f != start);
+        if (f == start)
+            return false;
+        f = faces[start].n[indexIn(start)];
+        while (f != NONE && f != start) {
+            int i = indexIn(f);
+            if (fn(f, i))
+                return true;
+            f = faces[f].n[i];
+        }
+        return false;
+    }
+
+    bool onOriginalEdge(uint32_t v, int k) const {
+        return v == uint32_t(k) || v == uint32_t((k + 1) % 3) || onEdge[v] == k;
+    }
+
+    // Splits the piece of the triangle's edge k that contains p. The order
+    // along the edge is decided exactly: a point a rounding step away from a
+    // vertex is still a vertex of its own, as it is in the neighbours.
+    uint32_t insertOnBoundary(const POINT& p, int8_t k) {
+        const POINT& c0 = points[k];
+        const POINT& c1 = points[(k + 1) % 3];
+        for (uint32_t f = 0; f < faces.size(); ++f) {
+            for (int e = 0; e < 3; ++e) {
+                if (faces[f].n[e] != NONE)
+                    continue;
+                uint32_t a = faces[f].v[e], b = faces[f].v[(e + 1) % 3];
+                if (!onOriginalEdge(a, k) || !onOriginalEdge(b, k))
+                    continue;
+                if (samePoint(p, points[a]))
+                    return a;
+                if (samePoint(p, points[b]))
+                    return b;
+                // Level with a counts as just past it towards b
+                double sa = alongLine(c0, c1, points[a], p), sb = alongLine(c0, c1, points[b], p);
+                if ((sa >= 0 && sb < 0) || (sa <= 0 && sb > 0))
+                    return splitEdge(f, e, p, k);
+            }
+        }
+        return NONE;
+    }
+
+    // Inserts p wherever the exact orientation tests place it
+    uint32_t insertLocated(const POINT& p) {
+        uint32_t f = lastFace < faces.size() ? lastFace : 0;
+        uint32_t outside = NONE;
+        int outsideEdge = -1;
+        // Visibility walk; falls back to a scan if it fails to settle, leaves
+        // the triangle, or meets a face that a rounded boundary point made
+        // flat (every edge of one looks like a wall)
+        for (size_t step = 0; step < 4 * faces.size() + 16 && !flat(f); ++step) {
+            const Face& face = faces[f];
+            double o[3];
+            int negative = -1;
+            for (int e = 0; e < 3 && negative < 0; ++e) {
+                o[e] = orient(face.v[e], face.v[(e + 1) % 3], p);
+                if (o[e] < 0)
+                    negative = e;
+            }
+            if (negative >= 0) {
+                if (face.n[negative] == NONE) {
+                    outside = f;
+                    outsideEdge = negative;
+                    break;
+                }
+                f = face.n[negative];
+                continue;
+            }
+            return insertInFace(f, o, p);
+        }
+        for (uint32_t g = 0; g < faces.size(); ++g) {
+            if (flat(g))
+                continue;
+            const Face& face = faces[g];
+            double o[3];
+            int negative = -1, count = 0;
+            for (int e = 0; e < 3; ++e) {
+                o[e] = orient(face.v[e], face.v[(e + 1) % 3], p);
+                if (o[e] < 0) {
+                    negative = e;
+                    ++count;
+                }
+            }
+            if (count == 0)
+                return insertInFace(g, o, p);
+            if (count == 1 && outside == NONE && face.n[negative] == NONE) {
+                outside = g;
+                outsideEdge = negative;
+            }
+        }
+        if (outside != NONE) // Rounded just outside
+            return splitEdge(outside, outsideEdge, p, boundaryEdgeOf(outside, outsideEdge));
+        return NONE;
+    }
+
+    bool flat(uint32_t f) const {
+        return orient(faces[f].v[0], faces[f].v[1], faces[f].v[2]) <= 0;
+    }
+
+    uint32_t insertInFace(uint32_t f, const double o[3], const POINT& p) {
+        int zeros = (o[0] == 0) + (o[1] == 0) + (o[2] == 0);
+        if (zeros >= 2) {
+            // On a vertex: the one shared by the two edges it lies on
+            for (int e = 0; e < 3; ++e)
+                if (o[e] == 0 && o[(e + 1) % 3] == 0)
+                    return faces[f].v[(e + 1) % 3];
+        }
+        if (zeros == 1) {
+            int e = o[0] == 0 ? 0 : o[1] == 0 ? 1 : 2;
+            return splitEdge(f, e, p, faces[f].n[e] == NONE ? boundaryEdgeOf(f, e) : int8_t(-1));
+        }
+        return splitFace(f, p);
+    }
+
+    // Which edge of the original triangle a boundary edge of face f lies on
+    int8_t boundaryEdgeOf(uint32_t f, int e) const {
+        uint32_t a = faces[f].v[e], b = faces[f].v[(e + 1) % 3];
+        for (int k = 0; k < 3; ++k)
+            if (onOriginalEdge(a, k) && onOriginalEdge(b, k))
+                return int8_t(k);
+        return -1;
+    }
+
+    int axis = 2;
+    bool flipped = false;
+    std::vector<POINT> points;
+    std::vector<int8_t> onEdge;       // Edge of the original triangle a vertex was put on, or -1
+    std::vector<uint32_t> vertexFace; // Some face around each vertex
+    std::vector<Face> faces;
+    std::vector<std::pair<uint32_t, uint32_t>> crossing;    // Edges still in a constraint's way
+    std::vector<std::pair<uint32_t, uint32_t>> constrained; // Edges made from constraints
+    uint32_t lastFace = 0;
+};
+
+// Splits t along its cuts (all for this triangle), and at the extra points
+// on its edges, into out. The points that end up on t's edges are appended
+// to boundary. Returns false if a cut could not be made an edge of the
+// pieces (see TriangleSplitter::addConstraint).
+bool splitAlongCuts(const Triangle& t, const Cut* cuts, size_t count, const std::vector<EdgePoint>& extra,
+                    TriangleSplitter& splitter, std::vector<Triangle>& out, std::vector<uint8_t>& cutEdges,
+                    std::vector<EdgePoint>& boundary) {
+    // Distinct endpoints, each with the most specific location any cut gave it
+    struct End {
+        POINT p;
+        int8_t on;
+        uint32_t vertex;
+    };
+    std::vector<End> ends;
+    ends.reserve(2 * count + extra.size());
+    for (size_t c = 0; c < count; ++c) {
+        ends.push_back(End{ cuts[c].p, cuts[c].onP, NONE });
+        ends.push_back(End{ cuts[c].q, cuts[c].onQ, NONE });
+    }
+    for (const EdgePoint& e : extra)
+        ends.push_back(End{ e.p, e.edge, NONE });
+    std::sort(ends.begin(), ends.end(), [](const End& x, const End& y) {
+        if (lessPoint(x.p, y.p)) return true;
+        if (lessPoint(y.p, x.p)) return false;
+        return x.on > y.on;
+    });
+
+    // A point put on two of the edges, or on one edge and (after rounding)
+    // the line of another, is their shared corner off by rounding. The
+    // triangle is split as if that corner were the point, and the point is
+    // reported on both edges so the neighbours on either side take it too.
+    Triangle corners = t;
+    POINT* corner[3] = { &corners.p1, &corners.p2, &corners.p3 };
+    const POINT* original[3] = { &t.p1, &t.p2, &t.p3 };
+    const int axis = dominantAxis(t);
+    bool snapped[3] = { false, false, false };
+    for (size_t first = 0, last; first < ends.size(); first = last) {
+        int8_t k1 = ends[first].on, k2 = -1;
+        for (last = first + 1; last < ends.size() && samePoint(ends[last].p, ends[first].p); ++last)
+            if (ends[last].on >= 0 && ends[last].on != k1)
+                k2 = ends[last].on;
+        if (k1 < 0 || k1 >= 3 || axis < 0)
+            continue;
+        for (int j = (k1 + 1) % 3; k2 < 0 && j != k1; j = (j + 1) % 3)
+            if (orientAlong(axis, *original[j], *original[(j + 1) % 3], ends[first].p) == 0)
+                k2 = int8_t(j);
+        if (k2 < 0)
+            continue;
+        int8_t c = (k1 + 1) % 3 == k2 ? k2 : k1;
+        if (samePoint(ends[first].p, *original[c])) {
+            for (size_t e = first; e < last; ++e)
+                ends[e].on = int8_t(3 + c);
+            continue;
+        }
+        if (snapped[c])
+            continue;
+        snapped[c] = true;
+        *corner[c] = ends[first].p;
+        for (size_t e = first; e < last; ++e)
+            ends[e].on = int8_t(3 + c);
+    }
+    if (!splitter.start(corners)) {
+        out.push_back(t);
+        cutEdges.push_back(0);
+        return true;
+    }
+    ends.erase(std::unique(ends.begin(), ends.end(), [](const End& x, const End& y) { return samePoint(x.p, y.p); }),
+               ends.end());
+
+    // Points on the triangle's edges first, so interior points never land on
+    // a boundary piece that is about to be split
+    for (End& e : ends)
+        if (e.on >= 0)
+            e.vertex = splitter.addPoint(e.p, e.on);
+    for (End& e : ends)
+        if (e.on < 0)
+            e.vertex = splitter.addPoint(e.p, e.on);
+
+    auto vertexOf = [&](const POINT& p) {
+        auto it = std::lower_bound(ends.begin(), ends.end(), p,
+                                   [](const End& e, const POINT& q) { return lessPoint(e.p, q); });
+        return it->vertex;
+    };
+    bool complete = true;
+    for (size_t c = 0; c < count; ++c) {
+        uint32_t a = vertexOf(cuts[c].p), b = vertexOf(cuts[c].q);
+        if (a == NONE || b == NONE || !splitter.addConstraint(a, b))
+            complete = false;
+    }
+    splitter.emit(out, cutEdges);
+    splitter.boundaryPoints(boundary);
+    for (int c = 0; c < 3; ++c)
+        if (snapped[c]) {
+            boundary.push_back(EdgePoint{ *corner[c], int8_t(c) });
+            boundary.push_back(EdgePoint{ *corner[c], int8_t((c + 2) % 3) });
+        }
+    return complete;
+}
+
+// Parity of the crossings of the ray from p along axis d (direction +1 or
+// -1) with mesh, decided exactly. Returns false if the ray grazes an edge or
+// a vertex. If p itself lies on the mesh, side says which way that surface
+// faces compared with `facing`.
+bool castRay(const POINT& p, const Vec3& facing, const std::vector<Triangle>& mesh, const BVH& bvh, int d, int dir,
+             Side& side) {
+    const int u = (d + 1) % 3, v = (d + 2) % 3;
+    const double pd = coord(p, d), pu = coord(p, u), pv = coord(p, v);
+    bool inside = false;
+    std::vector<uint32_t> stack;
+    stack.push_back(0);
+    while (!stack.empty()) {
+        const BVHNode& node = bvh.nodes[stack.back()];
+        stack.pop_back();
+        const AABB& box = node.bounds;
+        if (pu < coord(box.min, u) || pu > coord(box.max, u) || pv < coord(box.min, v) || pv > coord(box.max, v))
+            continue;
+        if (dir > 0 ? coord(box.max, d) < pd : coord(box.min, d) > pd)
+            continue;
+        if (!node.isLeaf()) {
+            stack.push_back(node.first);
+            stack.push_back(node.first + 1);
+            continue;
+        }
+        for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+            const Triangle& t = mesh[bvh.primitives[k]];
+            double nd = orientAlong(d, t.p1, t.p2, t.p3);
+            double e0 = orientAlong(d, t.p1, t.p2, p), e1 = orientAlong(d, t.p2, t.p3, p);
+            double e2 = orientAlong(d, t.p3, t.p1, p);
+            double height = orient3d(t.p1, t.p2, t.p3, p);
+            if (nd == 0) {
+                // Parallel to the ray: only matters when the ray runs inside its plane
+                if (height == 0 && !((e0 > 0 && e1 > 0 && e2 > 0) || (e0 < 0 && e1 < 0 && e2 < 0)))
+                    return false;
+                continue;
+            }
+            double s = nd > 0 ? 1.0 : -1.0;
+            if (e0 * s < 0 || e1 * s < 0 || e2 * s < 0)
+                continue; // Misses the triangle
+            if (height == 0) {
+                Vec3 n = normalOf(t);
+                side = n.x * facing.x + n.y * facing.y + n.z * facing.z > 0 ? Side::Same : Side::Opposite;
+                return true;
+            }
+            if ((height > 0) != (nd * dir > 0))
+                continue; // Behind p
+            if (e0 == 0 || e1 == 0 || e2 == 0)
+                return false; // Through an edge or vertex
+            inside = !inside;
+        }
+    }
+    side = inside ? Side::Inside : Side::Outside;
+    return true;
+}
+
+// Where the piece `t` of one mesh lies relative to the other mesh, judged at
+// a point inside it. The centroid comes first; when every ray from a point
+// grazes an edge or a vertex of the other mesh (level coordinates, as on
+// boxes), points at uneven weights of the corners are tried. Returns false
+// if none of them settles it.
+bool classify(const Triangle& t, const std::vector<Triangle>& other, const BVH& bvh,
+              const uint32_t* coplanar, size_t coplanarCount, Side& side) {
+    static const double WEIGHTS[][3] = {
+        { 1.0 / 3, 1.0 / 3, 1.0 / 3 }, { 0.55, 0.3, 0.15 }, { 0.15, 0.55, 0.3 }, { 0.3, 0.15, 0.55 },
+        { 0.55, 0.15, 0.3 },           { 0.3, 0.55, 0.15 }, { 0.15, 0.3, 0.55 },
+    };
+    Vec3 n = normalOf(t);
+    int axis = dominantAxis(t);
+    for (const double* w : WEIGHTS) {
+        POINT c(float(w[0] * t.p1.x + w[1] * t.p2.x + w[2] * t.p3.x),
+                float(w[0] * t.p1.y + w[1] * t.p2.y + w[2] * t.p3.y),
+                float(w[0] * t.p1.z + w[1] * t.p2.z + w[2] * t.p3.z));
+        // A point of a piece in a coplanar overlap is rounded off the plane,
+        // so those are matched in the plane instead
+        if (axis >= 0) {
+            for (size_t k = 0; k < coplanarCount; ++k) {
+                const Triangle& q = other[coplanar[k]];
+                double s = orientAlong(axis, q.p1, q.p2, q.p3);
+                double e0 = orientAlong(axis, q.p1, q.p2, c) * s, e1 = orientAlong(axis, q.p2, q.p3, c) * s;
+                double e2 = orientAlong(axis, q.p3, q.p1, c) * s;
+                if (s != 0 && e0 > 0 && e1 > 0 && e2 > 0) {
+                    Vec3 m = normalOf(q);
+                    side = n.x * m.x + n.y * m.y + n.z * m.z > 0 ? Side::Same : Side::Opposite;
+                    return true;
+                }
+            }
+        }
+        for (int dir : { 1, -1 })
+            for (int d = 0; d < 3; ++d)
+                if (castRay(c, n, other, bvh, d, dir, side))
+                    return true;
+    }
+    return false;
+}
+
+bool keepPiece(Side side, BooleanOp op, bool fromA) {
+    switch (op) {
+    case BooleanOp::Union:
+        return side == Side::Outside || (fromA && side == Side::Same);
+    case BooleanOp::Intersection:
+        return side == Side::Inside || (fromA && side == Side::Same);
+    default:
+        return fromA ? side == Side::Outside || side == Side::Opposite : side == Side::Inside;
+    }
+}
+
+// Cuts of one mesh grouped by triangle
+struct CutMesh {
+    std::vector<Cut> cuts;
+    std::vector<size_t> groupStart; // Cuts of group g are [groupStart[g], groupStart[g + 1])
+    std::vector<uint64_t> coplanar; // (own triangle << 32 | other triangle), sorted
+};
+
+void groupCuts(CutMesh& mesh) {
+    std::stable_sort(mesh.cuts.begin(), mesh.cuts.end(),
+                     [](const Cut& x, const Cut& y) { return x.triangle < y.triangle; });
+    mesh.groupStart.clear();
+    for (size_t c = 0; c < mesh.cuts.size(); ++c)
+        if (c == 0 || mesh.cuts[c].triangle != mesh.cuts[c - 1].triangle)
+            mesh.groupStart.push_back(c);
+    mesh.groupStart.push_back(mesh.cuts.size());
+    std::sort(mesh.coplanar.begin(), mesh.coplanar.end());
+    mesh.coplanar.erase(std::unique(mesh.coplanar.begin(), mesh.coplanar.end()), mesh.coplanar.end());
+}
+
+// One mesh with its cut triangles replaced by their pieces, in input order
+struct SplitMesh {
+    std::vector<Triangle> triangles;
+    std::vector<uint32_t> source;  // Input triangle each one came from
+    std::vector<uint8_t> cutEdges; // Bit k set when edge k runs along a cut
+    size_t pieces = 0;
+};
+
+// Triangles of `own` other than t that have the edge from a to b, with the
+// index of that edge in each, found through the boxes of bvh
+void trianglesOnEdge(const std::vector<Triangle>& own, const BVH& bvh, uint32_t t, const POINT& a, const POINT& b,
+                     std::vector<std::pair<uint32_t, int8_t>>& found) {
+    AABB edge;
+    edge.expand(a);
+    edge.expand(b);
+    std::vector<uint32_t> stack;
+    stack.push_back(0);
+    while (!stack.empty()) {
+        const BVHNode& node = bvh.nodes[stack.back()];
+        stack.pop_back();
+        if (!node.bounds.overlaps(edge))
+            continue;
+        if (!node.isLeaf()) {
+            stack.push_back(node.first);
+            stack.push_back(node.first + 1);
+            continue;
+        }
+        for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+            const uint32_t s = bvh.primitives[k];
+            if (s == t)
+                continue;
+            const POINT* c[3] = { &own[s].p1, &own[s].p2, &own[s].p3 };
+            for (int j = 0; j < 3; ++j) {
+                const POINT& p = *c[j];
+                const POINT& q = *c[(j + 1) % 3];
+                if ((samePoint(p, a) && samePoint(q, b)) || (samePoint(p, b) && samePoint(q, a)))
+                    found.emplace_back(s, int8_t(j));
+            }
+        }
+    }
+}
+
+// Hands every point that a split placed on an edge of `own` to the other
+// triangles on that edge that do not have it yet, as extra[job] for the job
+// splitting them. Triangles the other mesh did not cut get a new job.
+// Returns the jobs that have to be split again.
+std::vector<uint32_t> shareEdgePoints(const std::vector<Triangle>& own, const BVH& bvh,
+                                      std::vector<uint32_t>& jobTriangle, std::vector<uint32_t>& jobOf,
+                                      const std::vector<std::vector<EdgePoint>>& boundary,
+                                      std::vector<std::vector<EdgePoint>>& extra) {
+    // Neighbours across every edge with points on it, per job
+    struct Sharer {
+        int8_t edge;      // Of the job's triangle
+        uint32_t triangle;
+        int8_t shared;    // The same edge in `triangle`
+    };
+    const size_t jobs = boundary.size();
+    std::vector<std::vector<Sharer>> sharers(jobs);
+    parallelTasks(jobs, [&](size_t job) {
+        std::vector<std::pair<uint32_t, int8_t>> found;
+        const uint32_t t = jobTriangle[job];
+        const POINT* c[3] = { &own[t].p1, &own[t].p2, &own[t].p3 };
+        for (int k = 0; k < 3; ++k) {
+            if (std::none_of(boundary[job].begin(), boundary[job].end(),
+                             [&](const EdgePoint& e) { return e.edge == k; }))
+                continue;
+            found.clear();
+            trianglesOnEdge(own, bvh, t, *c[k], *c[(k + 1) % 3], found);
+            for (const auto& f : found)
+                sharers[job].push_back(Sharer{ int8_t(k), f.first, f.second });
+        }
+    });
+
+    std::vector<uint32_t> rerun;
+    for (size_t from = 0; from < jobs; ++from)
+        for (const Sharer& sh : sharers[from]) {
+            uint32_t job = jobOf[sh.triangle];
+            for (const EdgePoint& point : boundary[from]) {
+                if (point.edge != sh.edge)
+                    continue;
+                auto same = [&](const EdgePoint& e) { return samePoint(e.p, point.p) && e.edge == sh.shared; };
+                if (job != NONE && ((job < jobs && std::any_of(boundary[job].begin(), boundary[job].end(), same)) ||
+                                    std::any_of(extra[job].begin(), extra[job].end(), same)))
+                    continue;
+                if (job == NONE) {
+                    job = uint32_t(jobTriangle.size());
+                    jobTriangle.push_back(sh.triangle);
+                    jobOf[sh.triangle] = job;
+                    extra.emplace_back();
+                }
+                if (extra[job].empty())
+                    rerun.push_back(job);
+                extra[job].push_back(EdgePoint{ point.p, sh.shared });
+            }
+        }
+    return rerun;
+}
+
+// Returns false if a cut had to be left out of some triangle
+bool splitMesh(const std::vector<Triangle>& own, const BVH& bvh, const CutMesh& mesh, SplitMesh& out) {
+    // A job splits one triangle: first the cut ones, one per group of cuts
+    const size_t groups = mesh.groupStart.size() - 1;
+    std::vector<uint32_t> jobTriangle(groups);
+    std::vector<uint32_t> jobOf(own.size(), NONE);
+    for (size_t g = 0; g < groups; ++g) {
+        jobTriangle[g] = mesh.cuts[mesh.groupStart[g]].triangle;
+        jobOf[jobTriangle[g]] = uint32_t(g);
+    }
+    std::vector<std::vector<EdgePoint>> extra(groups), boundary(groups);
+    std::vector<std::vector<Triangle>> pieces(groups);
+    std::vector<std::vector<uint8_t>> pieceEdges(groups);
+    std::vector<uint8_t> complete(groups);
+    auto split = [&](size_t job) {
+        thread_local TriangleSplitter splitter;
+        const Cut* cuts = job < groups ? &mesh.cuts[mesh.groupStart[job]] : nullptr;
+        size_t count = job < groups ? mesh.groupStart[job + 1] - mesh.groupStart[job] : 0;
+        pieces[job].clear();
+        pieceEdges[job].clear();
+        boundary[job].clear();
+        complete[job] = splitAlongCuts(own[jobTriangle[job]], cuts, count, extra[job], splitter, pieces[job],
+                                       pieceEdges[job], boundary[job]);
+    };
+    parallelTasks(groups, split);
+
+    // A point placed on an edge has to split every triangle on that edge, or
+    // a neighbour that the other mesh only touches there keeps the whole
+    // edge and leaves a T-junction. The points only go onto edges that
+    // already have them on one side, so one more round settles it.
+    std::vector<uint32_t> rerun = shareEdgePoints(own, bvh, jobTriangle, jobOf, boundary, extra);
+    pieces.resize(jobTriangle.size());
+    pieceEdges.resize(jobTriangle.size());
+    boundary.resize(jobTriangle.size());
+    complete.resize(jobTriangle.size());
+    parallelTasks(rerun.size(), [&](size_t r) { split(rerun[r]); });
+
+    for (const auto& p : pieces)
+        out.pieces += p.size();
+    out.triangles.reserve(own.size() - pieces.size() + out.pieces);
+    out.source.reserve(out.triangles.capacity());
+    out.cutEdges.reserve(out.triangles.capacity());
+    for (uint32_t t = 0; t < own.size(); ++t) {
+        if (jobOf[t] == NONE) {
+            out.triangles.push_back(own[t]);
+            out.source.push_back(t);
+            out.cutEdges.push_back(0);
+            continue;
+        }
+        const uint32_t job = jobOf[t];
+        out.triangles.insert(out.triangles.end(), pieces[job].begin(), pieces[job].end());
+        out.source.insert(out.source.end(), pieces[job].size(), t);
+        out.cutEdges.insert(out.cutEdges.end(), pieceEdges[job].begin(), pieceEdges[job].end());
+        std::vector<Triangle>().swap(pieces[job]);
+    }
+    return std::find(complete.begin(), complete.end(), 0) == complete.end();
+}
+
+uint32_t findRoot(std::vector<uint32_t>& parent, uint32_t x) {
+    while (parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+// Marks which triangles of `mesh` to keep. Triangles sharing an edge that
+// is not on a cut lie on the same side of the other mesh, so every region
+// the cuts bound is classified once, through its largest triangle: the
+// centroids of thin pieces along the curve can round onto the wrong side.
+// The smaller ones are tried in turn if that one cannot be classified.
+// Returns false if some region could not be classified at all.
+bool keepRegions(const SplitMesh& mesh, const CutMesh& cuts, const std::vector<Triangle>& other,
+                 const BVH& otherBVH, BooleanOp op, bool fromA, std::vector<uint8_t>& keep, size_t& regionCount) {
+    const size_t n = mesh.triangles.size();
+    IndexedMesh welded = weldVertices(mesh.triangles);
+    struct Edge {
+        uint64_t key;
+        uint32_t triangle;
+        bool cut;
+        bool operator<(const Edge& o) const { return key < o.key; }
+    };
+    std::vector<Edge> edges(3 * n);
+    parallelFor(n, 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t)
+            for (int k = 0; k < 3; ++k) {
+                uint64_t v0 = welded.indices[3 * t + k], v1 = welded.indices[3 * t + (k + 1) % 3];
+                edges[3 * t + k] =
+                    Edge{ std::min(v0, v1) << 32 | std::max(v0, v1), uint32_t(t), (mesh.cutEdges[t] >> k & 1) != 0 };
+            }
+    });
+    std::sort(edges.begin(), edges.end());
+    std::vector<uint32_t> parent(n);
+    for (uint32_t t = 0; t < n; ++t)
+        parent[t] = t;
+    for (size_t first = 0, last; first < edges.size(); first = last) {
+        bool cut = false;
+        for (last = first; last < edges.size() && edges[last].key == edges[first].key; ++last)
+            cut = cut || edges[last].cut;
+        if (cut)
+            continue;
+        for (size_t e = first + 1; e < last; ++e) {
+            uint32_t r0 = findRoot(parent, edges[first].triangle), r1 = findRoot(parent, edges[e].triangle);
+            if (r0 != r1)
+                parent[std::max(r0, r1)] = std::min(r0, r1);
+        }
+    }
+
+    // Largest triangle of every region
+    std::vector<uint32_t> largest(n, NONE), regionOf(n);
+    std::vector<double> area(n);
+    for (uint32_t t = 0; t < n; ++t) {
+        Vec3 normal = normalOf(mesh.triangles[t]);
+        area[t] = normal.x * normal.x + normal.y * normal.y + normal.z * normal.z;
+        uint32_t r = regionOf[t] = findRoot(parent, t);
+        if (largest[r] == NONE || area[t] > area[largest[r]])
+            largest[r] = t;
+    }
+    std::vector<uint32_t> regions;
+    for (uint32_t t = 0; t < n; ++t)
+        if (regionOf[t] == t)
+            regions.push_back(t);
+
+    auto classifyPiece = [&](uint32_t t, Side& side) {
+        uint32_t own = mesh.source[t];
+        std::vector<uint32_t> partners;
+        auto it = std::lower_bound(cuts.coplanar.begin(), cuts.coplanar.end(), uint64_t(own) << 32);
+        for (; it != cuts.coplanar.end() && uint32_t(*it >> 32) == own; ++it)
+            partners.push_back(uint32_t(*it));
+        return classify(mesh.triangles[t], other, otherBVH, partners.data(), partners.size(), side);
+    };
+    std::vector<uint8_t> keepRegion(n, 0), classified(n, 1);
+    parallelTasks(regions.size(), [&](size_t r) {
+        const uint32_t region = regions[r];
+        Side side;
+        if (classifyPiece(largest[region], side)) {
+            keepRegion[region] = keepPiece(side, op, fromA);
+            return;
+        }
+        std::vector<uint32_t> members;
+        for (uint32_t t = region; t < n; ++t)
+            if (regionOf[t] == region && t != largest[region])
+                members.push_back(t);
+        std::sort(members.begin(), members.end(), [&](uint32_t x, uint32_t y) { return area[x] > area[y]; });
+        for (uint32_t t : members)
+            if (classifyPiece(t, side)) {
+                keepRegion[region] = keepPiece(side, op, fromA);
+                return;
+            }
+        classified[region] = 0;
+    });
+    keep.resize(n);
+    for (uint32_t t = 0; t < n; ++t)
+        keep[t] = keepRegion[regionOf[t]];
+    regionCount = regions.size();
+    return std::find(classified.begin(), classified.end(), 0) == classified.end();
+}
+
+// Whether every edge of `mesh` is shared by exactly one triangle running it
+// the other way, after welding equal corners
+bool isClosed(const std::vector<Triangle>& mesh) {
+    IndexedMesh welded = weldVertices(mesh);
+    std::vector<uint64_t> forward, backward;
+    forward.reserve(welded.indices.size());
+    backward.reserve(welded.indices.size());
+    for (size_t t = 0; t < welded.indices.size() / 3; ++t)
+        for (int k = 0; k < 3; ++k) {
+            uint64_t v0 = welded.indices[3 * t + k], v1 = welded.indices[3 * t + (k + 1) % 3];
+            if (v0 == v1)
+                continue;
+            forward.push_back(v0 << 32 | v1);
+            backward.push_back(v1 << 32 | v0);
+        }
+    std::sort(forward.begin(), forward.end());
+    std::sort(backward.begin(), backward.end());
+    return forward == backward;
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+bool meshBoolean(const std::vector<Triangle>& a, const std::vector<Triangle>& b, BooleanOp op,
+                 std::vector<Triangle>& result, BooleanStats* stats) {
+    BooleanStats local;
+    BooleanStats& s = stats ? *stats : local;
+    s = BooleanStats();
+    result.clear();
+    if (a.empty() || b.empty()) {
+        std::cerr << "Error: Boolean operation needs two non-empty meshes\n";
+        return false;
+    }
+
+    // 1. Cut segments of every intersecting pair, collected per chunk of pairs
+    auto start = std::chrono::steady_clock::now();
+    BVH bvhA, bvhB;
+    bvhA.build(a);
+    bvhB.build(b);
+    std::vector<uint64_t> pairs = candidatePairs(a, bvhA, b, bvhB);
+    const size_t chunks = std::min(pairs.size() / 1024 + 1, size_t(64) * workerCount());
+    std::vector<CutMesh> chunkA(chunks), chunkB(chunks);
+    parallelTasks(chunks, [&](size_t c) {
+        CutMesh& outA = chunkA[c];
+        CutMesh& outB = chunkB[c];
+        for (size_t k = pairs.size() * c / chunks; k < pairs.size() * (c + 1) / chunks; ++k) {
+            uint32_t i = uint32_t(pairs[k] >> 32), j = uint32_t(pairs[k]);
+            if (trianglesCoplanar(a[i], b[j])) {
+                POINT outline[6];
+                int corners = coplanarOverlap(a[i], b[j], outline);
+                if (corners < 2)
+                    continue;
+                if (corners > 2) {
+                    outA.coplanar.push_back(uint64_t(i) << 32 | j);
+                    outB.coplanar.push_back(uint64_t(j) << 32 | i);
+                }
+                int edges = corners == 2 ? 1 : corners;
+                for (int e = 0; e < edges; ++e) {
+                    const POINT& p = outline[e];
+                    const POINT& q = outline[(e + 1) % corners];
+                    outA.cuts.push_back(Cut{ i, p, q, LOCATE, LOCATE });
+                    outB.cuts.push_back(Cut{ j, p, q, LOCATE, LOCATE });
+                }
+            } else {
+                SegmentEnd p, q;
+                if (triangleTriangleIntersectionSegment(a[i], b[j], p, q)) {
+                    outA.cuts.push_back(Cut{ i, p.p, q.p, p.on1, q.on1 });
+                    outB.cuts.push_back(Cut{ j, p.p, q.p, p.on2, q.on2 });
+                }
+            }
+        }
+    });
+    CutMesh cutA, cutB;
+    for (size_t c = 0; c < chunks; ++c) {
+        cutA.cuts.insert(cutA.cuts.end(), chunkA[c].cuts.begin(), chunkA[c].cuts.end());
+        cutA.coplanar.insert(cutA.coplanar.end(), chunkA[c].coplanar.begin(), chunkA[c].coplanar.end());
+        cutB.cuts.insert(cutB.cuts.end(), chunkB[c].cuts.begin(), chunkB[c].cuts.end());
+        cutB.coplanar.insert(cutB.coplanar.end(), chunkB[c].coplanar.begin(), chunkB[c].coplanar.end());
+    }
+    std::vector<CutMesh>().swap(chunkA);
+    std::vector<CutMesh>().swap(chunkB);
+    groupCuts(cutA);
+    groupCuts(cutB);
+    s.cutA = cutA.groupStart.size() - 1;
+    s.cutB = cutB.groupStart.size() - 1;
+    s.intersectMs = millisecondsSince(start);
+
+    // 2. Split the cut triangles
+    start = std::chrono::steady_clock::now();
+    SplitMesh splitA, splitB;
+    bool exact = splitMesh(a, bvhA, cutA, splitA);
+    exact = splitMesh(b, bvhB, cutB, splitB) && exact;
+    s.pieces = splitA.pieces + splitB.pieces;
+    s.retriangulateMs = millisecondsSince(start);
+
+    // 3. Classify the regions between cuts, then assemble in input order
+    start = std::chrono::steady_clock::now();
+    std::vector<uint8_t> keepA, keepB;
+    size_t regionsA = 0, regionsB = 0;
+    bool classified = keepRegions(splitA, cutA, b, bvhB, op, true, keepA, regionsA);
+    classified = keepRegions(splitB, cutB, a, bvhA, op, false, keepB, regionsB) && classified;
+    s.regions = regionsA + regionsB;
+    if (!classified) {
+        std::cerr << "Error: Boolean operation could not tell which side of the other mesh a region is on\n";
+        s.classifyMs = millisecondsSince(start);
+        return false;
+    }
+    for (size_t t = 0; t < splitA.triangles.size(); ++t)
+        if (keepA[t])
+            result.push_back(splitA.triangles[t]);
+    const bool flipB = op == BooleanOp::Difference;
+    for (size_t t = 0; t < splitB.triangles.size(); ++t) {
+        if (!keepB[t])
+            continue;
+        const Triangle& tri = splitB.triangles[t];
+        if (flipB)
+            result.emplace_back(tri.p1, tri.p3, tri.p2);
+        else
+            result.push_back(tri);
+    }
+    s.classifyMs = millisecondsSince(start);
+    // A cut left out of a triangle (faces touching along a diagonal, where
+    // rounding moves the crossing points) may leave a hole at the seam
+    if (!exact && !isClosed(result)) {
+        std::cerr << "Error: Boolean operation could not follow every cut; the result would not be closed\n";
+        result.clear();
+        return false;
+    }
+    return true;
+}
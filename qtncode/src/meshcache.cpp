@@ -0,0 +1,240 @@
+#include "meshcache.h"
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <type_traits>
+
+static const char MESH_CACHE_MAGIC[8] = { 'S', 'T', 'L', 'C', 'A', 'C', 'H', 'E' };
+static const uint64_t MESH_CACHE_ALIGNMENT = 64;
+
+static_assert(sizeof(POINT) == 12 && sizeof(BVHNode) == 32 && sizeof(MeshCacheHeader) == 128,
+              "Mesh cache sections are written as raw memory");
+static_assert(std::is_trivially_copyable<BVHNode>::value && std::is_trivially_copyable<MeshCacheHeader>::value,
+              "Mesh cache sections are written as raw memory");
+
+static uint64_t alignUp(uint64_t offset) {
+    return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+}
+
+std::string meshCachePath(const std::string& sourcePath) {
+    return sourcePath + "c";
+}
+
+bool meshCacheIsFresh(const std::string& sourcePath, const std::string& cachePath) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    auto sourceTime = fs::last_write_time(sourcePath, ec);
+    if (ec)
+        return false;
+    auto cacheTime = fs::last_write_time(cachePath, ec);
+    if (ec || cacheTime < sourceTime)
+        return false;
+
+    uint64_t sourceSize = fs::file_size(sourcePath, ec);
+    if (ec)
+        return false;
+    // The header is small; read it directly instead of mapping the whole cache
+    std::ifstream in(cachePath, std::ios::binary);
+    MeshCacheHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+    return std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) == 0 &&
+           header.version == MESH_CACHE_VERSION && header.sourceSize == sourceSize;
+}
+
+static std::vector<POINT> faceNormals(const IndexedMesh& mesh) {
+    std::vector<POINT> normals(mesh.triangleCount());
+    parallelFor(normals.size(), 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            Triangle t = mesh.triangle(i);
+            float ux = t.p2.x - t.p1.x, uy = t.p2.y - t.p1.y, uz = t.p2.z - t.p1.z;
+            float vx = t.p3.x - t.p1.x, vy = t.p3.y - t.p1.y, vz = t.p3.z - t.p1.z;
+            POINT n(uy * vz - uz * vy, uz * vx - ux * vz, ux * vy - uy * vx);
+            float len = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+            normals[i] = len > 0.0f ? POINT(n.x / len, n.y / len, n.z / len) : POINT();
+        }
+    });
+    return normals;
+}
+
+// Bytes written between two cancellation checks
+static const size_t MESH_CACHE_WRITE_STEP = 16 << 20;
+
+// Returns false if `control` was cancelled before the section was written
+template <typename T>
+static bool writeSection(std::ofstream& out, uint64_t& position, uint64_t offset, const std::vector<T>& data,
+                         const STLLoadControl* control) {
+    static const char padding[MESH_CACHE_ALIGNMENT] = {};
+    out.write(padding, std::streamsize(offset - position));
+    const char* bytes = reinterpret_cast<const char*>(data.data());
+    const size_t size = data.size() * sizeof(T);
+    for (size_t done = 0; done < size && out; done += MESH_CACHE_WRITE_STEP) {
+        if (control && control->cancelled())
+            return false;
+        out.write(bytes + done, std::streamsize(std::min(MESH_CACHE_WRITE_STEP, size - done)));
+    }
+    position = offset + size;
+    return true;
+}
+
+// Writes `mesh` with the BVH built over its triangle soup `triangles`
+static bool writeCache(const std::string& cachePath, const IndexedMesh& mesh, const std::vector<Triangle>& triangles,
+                       uint64_t sourceSize, const STLLoadControl* control) {
+    if (control && control->cancelled())
+        return false;
+    std::vector<POINT> normals = faceNormals(mesh);
+    BVH bvh;
+    bvh.build(triangles);
+    if (control && control->cancelled())
+        return false;
+
+    MeshCacheHeader header{};
+    std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+    header.version = MESH_CACHE_VERSION;
+    header.headerSize = sizeof(MeshCacheHeader);
+    header.sourceSize = sourceSize;
+    header.bounds = bvh.empty() ? AABB() : bvh.nodes[0].bounds;
+    header.vertexCount = mesh.vertices.size();
+    header.triangleCount = mesh.triangleCount();
+    header.bvhNodeCount = bvh.nodes.size();
+    header.bvhPrimitiveCount = bvh.primitives.size();
+    header.verticesOffset = alignUp(sizeof(MeshCacheHeader));
+    header.indicesOffset = alignUp(header.verticesOffset + mesh.vertices.size() * sizeof(POINT));
+    header.normalsOffset = alignUp(header.indicesOffset + mesh.indices.size() * sizeof(uint32_t));
+    header.bvhNodesOffset = alignUp(header.normalsOffset + normals.size() * sizeof(POINT));
+    header.bvhPrimitivesOffset = alignUp(header.bvhNodesOffset + bvh.nodes.size() * sizeof(BVHNode));
+
+    // Write to a temporary file first so a crash never leaves a torn cache behind
+    const std::string tempPath = cachePath + ".tmp";
+    std::error_code ec;
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Error: Cannot write mesh cache " << cachePath << "\n";
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        uint64_t position = sizeof(header);
+        bool complete = writeSection(out, position, header.verticesOffset, mesh.vertices, control) &&
+                        writeSection(out, position, header.indicesOffset, mesh.indices, control) &&
+                        writeSection(out, position, header.normalsOffset, normals, control) &&
+                        writeSection(out, position, header.bvhNodesOffset, bvh.nodes, control) &&
+                        writeSection(out, position, header.bvhPrimitivesOffset, bvh.primitives, control);
+        if (complete && !out)
+            std::cerr << "Error: Failed writing mesh cache " << cachePath << "\n";
+        if (!complete || !out) {
+            out.close();
+            std::filesystem::remove(tempPath, ec);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+bool writeMeshCache(const std::string& cachePath, const std::vector<Triangle>& triangles, uint64_t sourceSize,
+                    const STLLoadControl* control) {
+    return writeCache(cachePath, weldVertices(triangles), triangles, sourceSize, control);
+}
+
+bool writeMeshCache(const std::string& cachePath, const IndexedMesh& mesh, uint64_t sourceSize,
+                    const STLLoadControl* control) {
+    return writeCache(cachePath, mesh, mesh.toTriangles(), sourceSize, control);
+}
+
+// True if every value of the n entries at `values` is below `limit`
+static bool allBelow(const uint32_t* values, size_t n, uint64_t limit) {
+    std::atomic<bool> ok{true};
+    parallelFor(n, 1 << 18, [&](size_t begin, size_t end) {
+        uint32_t largest = 0;
+        for (size_t i = begin; i < end; ++i)
+            largest = std::max(largest, values[i]);
+        if (begin < end && largest >= limit)
+            ok = false;
+    });
+    return ok;
+}
+
+// Leaves must name stored primitives, and inner nodes children stored after
+// them, so a traversal always ends
+static bool nodesInRange(const BVHNode* nodes, uint64_t nodeCount, uint64_t primitiveCount) {
+    std::atomic<bool> ok{true};
+    parallelFor(size_t(nodeCount), 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end && ok.load(std::memory_order_relaxed); ++i) {
+            const BVHNode& node = nodes[i];
+            bool valid = node.isLeaf() ? uint64_t(node.first) + node.count <= primitiveCount
+                                       : node.first > i && uint64_t(node.first) + 1 < nodeCount;
+            if (!valid)
+                ok = false;
+        }
+    });
+    return ok;
+}
+
+bool MeshCache::open(const std::string& cachePath) {
+    close();
+    if (!file.open(cachePath) || file.size() < sizeof(MeshCacheHeader))
+        return false;
+
+    const MeshCacheHeader* h = reinterpret_cast<const MeshCacheHeader*>(file.data());
+    auto fits = [&](uint64_t offset, uint64_t count, uint64_t elementSize) {
+        return offset % 4 == 0 && offset <= file.size() && count <= (file.size() - offset) / elementSize;
+    };
+    if (std::memcmp(h->magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0 ||
+        h->version != MESH_CACHE_VERSION || h->headerSize != sizeof(MeshCacheHeader) ||
+        !fits(h->verticesOffset, h->vertexCount, sizeof(POINT)) ||
+        !fits(h->indicesOffset, h->triangleCount * 3, sizeof(uint32_t)) ||
+        !fits(h->normalsOffset, h->triangleCount, sizeof(POINT)) ||
+        !fits(h->bvhNodesOffset, h->bvhNodeCount, sizeof(BVHNode)) ||
+        !fits(h->bvhPrimitivesOffset, h->bvhPrimitiveCount, sizeof(uint32_t)) ||
+        !allBelow(section<uint32_t>(h->indicesOffset), size_t(h->triangleCount * 3), h->vertexCount) ||
+        !allBelow(section<uint32_t>(h->bvhPrimitivesOffset), size_t(h->bvhPrimitiveCount), h->triangleCount) ||
+        !nodesInRange(section<BVHNode>(h->bvhNodesOffset), h->bvhNodeCount, h->bvhPrimitiveCount)) {
+        std::cerr << "Error: Invalid mesh cache " << cachePath << "\n";
+        file.close();
+        return false;
+    }
+    header = h;
+    return true;
+}
+
+void MeshCache::close() {
+    header = nullptr;
+    file.close();
+}
+
+std::vector<Triangle> MeshCache::toTriangles() const {
+    const POINT* v = vertices();
+    const uint32_t* idx = indices();
+    std::vector<Triangle> triangles(triangleCount());
+    parallelFor(triangles.size(), 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            triangles[i] = Triangle(v[idx[3 * i]], v[idx[3 * i + 1]], v[idx[3 * i + 2]]);
+    });
+    return triangles;
+}
+
+IndexedMesh MeshCache::toIndexedMesh() const {
+    IndexedMesh mesh;
+    mesh.vertices.assign(vertices(), vertices() + vertexCount());
+    mesh.indices.assign(indices(), indices() + 3 * triangleCount());
+    return mesh;
+}
+
+BVH MeshCache::toBVH() const {
+    BVH bvh;
+    bvh.nodes.assign(bvhNodes(), bvhNodes() + bvhNodeCount());
+    bvh.primitives.assign(bvhPrimitives(), bvhPrimitives() + bvhPrimitiveCount());
+    return bvh;
+}
@@ -0,0 +1,486 @@
+#include "meshdistance.h"
+#include "intersection.h"
+#include "indexedmesh.h"
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <mutex>
+
+// Deepest subdivision of one triangle in the Hausdorff search
+static const int MAX_SUBDIVISION = 20;
+
+namespace {
+
+struct Vec {
+    double x = 0.0, y = 0.0, z = 0.0;
+
+    Vec() = default;
+    Vec(double x, double y, double z) : x(x), y(y), z(z) {}
+    explicit Vec(const POINT& p) : x(p.x), y(p.y), z(p.z) {}
+
+    Vec operator+(const Vec& o) const { return Vec(x + o.x, y + o.y, z + o.z); }
+    Vec operator-(const Vec& o) const { return Vec(x - o.x, y - o.y, z - o.z); }
+    Vec operator*(double s) const { return Vec(x * s, y * s, z * s); }
+    POINT toPoint() const { return POINT(float(x), float(y), float(z)); }
+};
+
+double dot(const Vec& a, const Vec& b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+double clamp01(double v) {
+    return std::min(1.0, std::max(0.0, v));
+}
+
+// Closest points of segments p1-q1 and p2-q2; returns their squared distance
+double closestOnSegments(const Vec& p1, const Vec& q1, const Vec& p2, const Vec& q2, Vec& c1, Vec& c2) {
+    Vec d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+    double a = dot(d1, d1), e = dot(d2, d2), f = dot(d2, r);
+    double s = 0.0, t = 0.0;
+    if (a > 0.0 && e <= 0.0) {
+        s = clamp01(-dot(d1, r) / a);
+    } else if (a <= 0.0 && e > 0.0) {
+        t = clamp01(f / e);
+    } else if (a > 0.0) {
+        double c = dot(d1, r), b = dot(d1, d2), denom = a * e - b * b;
+        s = denom > 0.0 ? clamp01((b * f - c * e) / denom) : 0.0; // Parallel: any s works
+        t = (b * s + f) / e;
+        if (t < 0.0) {
+            t = 0.0;
+            s = clamp01(-c / a);
+        } else if (t > 1.0) {
+            t = 1.0;
+            s = clamp01((b - c) / a);
+        }
+    }
+    c1 = p1 + d1 * s;
+    c2 = p2 + d2 * t;
+    Vec d = c1 - c2;
+    return dot(d, d);
+}
+
+// Closest point of triangle a-b-c to p, by the Voronoi region p falls in
+Vec closestOnTriangle(const Vec& p, const Vec& a, const Vec& b, const Vec& c) {
+    Vec ab = b - a, ac = c - a, ap = p - a;
+    double d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if (d1 <= 0.0 && d2 <= 0.0)
+        return a;
+    Vec bp = p - b;
+    double d3 = dot(ab, bp), d4 = dot(ac, bp);
+    if (d3 >= 0.0 && d4 <= d3)
+        return b;
+    double vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+        return a + ab * (d1 / (d1 - d3));
+    Vec cp = p - c;
+    double d5 = dot(ab, cp), d6 = dot(ac, cp);
+    if (d6 >= 0.0 && d5 <= d6)
+        return c;
+    double vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+        return a + ac * (d2 / (d2 - d6));
+    double va = d3 * d6 - d5 * d4;
+    if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0)
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    double sum = va + vb + vc;
+    if (sum <= 0.0) {
+        // Degenerate triangle: the nearest of its edges
+        Vec best, onEdge, q;
+        double bestSq = std::numeric_limits<double>::max();
+        const Vec* corners[3] = { &a, &b, &c };
+        for (int k = 0; k < 3; ++k) {
+            double sq = closestOnSegments(p, p, *corners[k], *corners[(k + 1) % 3], q, onEdge);
+            if (sq < bestSq) {
+                bestSq = sq;
+                best = onEdge;
+            }
+        }
+        return best;
+    }
+    return a + ab * (vb / sum) + ac * (vc / sum);
+}
+
+// Squared distance of two triangles that do not cross, with the closest points
+double separatedDistanceSq(const Triangle& a, const Triangle& b, Vec& onA, Vec& onB) {
+    const Vec pa[3] = { Vec(a.p1), Vec(a.p2), Vec(a.p3) };
+    const Vec pb[3] = { Vec(b.p1), Vec(b.p2), Vec(b.p3) };
+    double bestSq = std::numeric_limits<double>::max();
+    Vec ca, cb;
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            double sq = closestOnSegments(pa[i], pa[(i + 1) % 3], pb[j], pb[(j + 1) % 3], ca, cb);
+            if (sq < bestSq) {
+                bestSq = sq;
+                onA = ca;
+                onB = cb;
+            }
+        }
+    }
+    for (int i = 0; i < 3; ++i) {
+        cb = closestOnTriangle(pa[i], pb[0], pb[1], pb[2]);
+        Vec d = pa[i] - cb;
+        if (dot(d, d) < bestSq) {
+            bestSq = dot(d, d);
+            onA = pa[i];
+            onB = cb;
+        }
+        ca = closestOnTriangle(pb[i], pa[0], pa[1], pa[2]);
+        d = pb[i] - ca;
+        if (dot(d, d) < bestSq) {
+            bestSq = dot(d, d);
+            onA = ca;
+            onB = pb[i];
+        }
+    }
+    return bestSq;
+}
+
+double triangleDistanceSq(const Triangle& a, const Triangle& b, Vec& onA, Vec& onB) {
+    // Contact is decided exactly; crossings that touch no edge of the other
+    // triangle are the only contacts the corner and edge tests would miss
+    if (trianglesCoplanar(a, b)) {
+        POINT overlap[6];
+        if (coplanarOverlap(a, b, overlap) > 0) {
+            onA = onB = Vec(overlap[0]);
+            return 0.0;
+        }
+    } else {
+        SegmentEnd s, e;
+        if (triangleTriangleIntersectionSegment(a, b, s, e)) {
+            onA = onB = Vec(s.p);
+            return 0.0;
+        }
+    }
+    return separatedDistanceSq(a, b, onA, onB);
+}
+
+double boxDistanceSq(const AABB& a, const AABB& b) {
+    double gx = std::max({ 0.0, double(a.min.x) - b.max.x, double(b.min.x) - a.max.x });
+    double gy = std::max({ 0.0, double(a.min.y) - b.max.y, double(b.min.y) - a.max.y });
+    double gz = std::max({ 0.0, double(a.min.z) - b.max.z, double(b.min.z) - a.max.z });
+    return gx * gx + gy * gy + gz * gz;
+}
+
+double pointBoxDistanceSq(const Vec& p, const AABB& box) {
+    double gx = std::max({ 0.0, box.min.x - p.x, p.x - box.max.x });
+    double gy = std::max({ 0.0, box.min.y - p.y, p.y - box.max.y });
+    double gz = std::max({ 0.0, box.min.z - p.z, p.z - box.max.z });
+    return gx * gx + gy * gy + gz * gz;
+}
+
+// Best value found by any thread (smallest for Better = std::less), with its
+// witnesses. Reading the value needs no lock, so searches can prune with it.
+template <typename Better>
+class SharedBest {
+public:
+    explicit SharedBest(double initial) : value(initial) {}
+
+    double get() const { return value.load(std::memory_order_relaxed); }
+
+    void offer(double candidate, const Vec& a, const Vec& b) {
+        if (!Better()(candidate, get()))
+            return;
+        std::lock_guard<std::mutex> guard(lock);
+        if (!Better()(candidate, value.load(std::memory_order_relaxed)))
+            return;
+        value.store(candidate, std::memory_order_relaxed);
+        onA = a;
+        onB = b;
+    }
+
+    Vec onA, onB;
+
+private:
+    std::atomic<double> value;
+    std::mutex lock;
+};
+
+// Whether to split node a rather than node b of a pair
+bool splitFirst(const BVHNode& a, const BVHNode& b) {
+    return b.isLeaf() || (!a.isLeaf() && a.bounds.halfArea() >= b.bounds.halfArea());
+}
+
+// Depth-first search of one subtree pair, nearer child pairs first
+void searchClosest(const std::vector<Triangle>& a, const BVH& bvhA, const std::vector<Triangle>& b, const BVH& bvhB,
+                   uint32_t rootA, uint32_t rootB, SharedBest<std::less<double>>& best) {
+    struct Item {
+        uint32_t a, b;
+        double distanceSq;
+    };
+    std::vector<Item> stack;
+    stack.push_back(Item{ rootA, rootB, boxDistanceSq(bvhA.nodes[rootA].bounds, bvhB.nodes[rootB].bounds) });
+    Vec onA, onB;
+    while (!stack.empty()) {
+        Item item = stack.back();
+        stack.pop_back();
+        if (item.distanceSq >= best.get())
+            continue;
+        const BVHNode& na = bvhA.nodes[item.a];
+        const BVHNode& nb = bvhB.nodes[item.b];
+        if (na.isLeaf() && nb.isLeaf()) {
+            for (uint32_t i = na.first; i < na.first + na.count; ++i) {
+                const Triangle& ta = a[bvhA.primitives[i]];
+                AABB boxA = triangleBounds(ta);
+                for (uint32_t j = nb.first; j < nb.first + nb.count; ++j) {
+                    const Triangle& tb = b[bvhB.primitives[j]];
+                    if (boxDistanceSq(boxA, triangleBounds(tb)) >= best.get())
+                        continue;
+                    double sq = triangleDistanceSq(ta, tb, onA, onB);
+                    best.offer(sq, onA, onB);
+                }
+            }
+            continue;
+        }
+        Item first, second;
+        if (splitFirst(na, nb)) {
+            first = Item{ na.first, item.b, boxDistanceSq(bvhA.nodes[na.first].bounds, nb.bounds) };
+            second = Item{ na.first + 1, item.b, boxDistanceSq(bvhA.nodes[na.first + 1].bounds, nb.bounds) };
+        } else {
+            first = Item{ item.a, nb.first, boxDistanceSq(na.bounds, bvhB.nodes[nb.first].bounds) };
+            second = Item{ item.a, nb.first + 1, boxDistanceSq(na.bounds, bvhB.nodes[nb.first + 1].bounds) };
+        }
+        if (first.distanceSq < second.distanceSq)
+            std::swap(first, second);
+        stack.push_back(first); // Farther pair below, so the nearer is searched first
+        stack.push_back(second);
+    }
+}
+
+// Closest point of mesh to p and the triangle it lies on. The search stops
+// early once it has found a point no farther than `enough`, so the distance
+// returned is exact when it exceeds `enough` and otherwise only an upper bound.
+double nearestPoint(const Vec& p, const std::vector<Triangle>& mesh, const BVH& bvh, double enough, Vec& closest,
+                    uint32_t& triangle) {
+    struct Item {
+        uint32_t node;
+        double distanceSq;
+    };
+    const double enoughSq = enough * enough;
+    double bestSq = std::numeric_limits<double>::max();
+    std::vector<Item> stack;
+    stack.push_back(Item{ 0, pointBoxDistanceSq(p, bvh.nodes[0].bounds) });
+    while (!stack.empty() && bestSq > enoughSq) {
+        Item item = stack.back();
+        stack.pop_back();
+        if (item.distanceSq >= bestSq)
+            continue;
+        const BVHNode& node = bvh.nodes[item.node];
+        if (node.isLeaf()) {
+            for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+                const Triangle& t = mesh[bvh.primitives[k]];
+                Vec q = closestOnTriangle(p, Vec(t.p1), Vec(t.p2), Vec(t.p3));
+                Vec d = p - q;
+                if (dot(d, d) < bestSq) {
+                    bestSq = dot(d, d);
+                    closest = q;
+                    triangle = bvh.primitives[k];
+                }
+            }
+            continue;
+        }
+        Item left{ node.first, pointBoxDistanceSq(p, bvh.nodes[node.first].bounds) };
+        Item right{ node.first + 1, pointBoxDistanceSq(p, bvh.nodes[node.first + 1].bounds) };
+        if (left.distanceSq < right.distanceSq)
+            std::swap(left, right);
+        stack.push_back(left);
+        stack.push_back(right);
+    }
+    return std::sqrt(bestSq);
+}
+
+// Part of a triangle of the first mesh, with its corners' distances to the
+// second and the triangles of the second those were measured to
+struct Patch {
+    Vec v[3];
+    double d[3];
+    uint32_t nearest[3];
+    int depth;
+};
+
+// Largest distance any point of the patch can have from mesh. Two bounds
+// apply: distance changes no faster than position, so no point is farther
+// than a corner's distance plus how far it is from that corner; and the
+// distance to a single triangle is convex, so over the patch it peaks at a
+// corner. The second is the tight one once a patch faces one triangle.
+double patchBound(const Patch& patch, const std::vector<Triangle>& mesh) {
+    double bound = std::numeric_limits<double>::max();
+    for (int i = 0; i < 3; ++i) {
+        double reach = 0.0;
+        for (int j = 0; j < 3; ++j) {
+            Vec e = patch.v[j] - patch.v[i];
+            reach = std::max(reach, dot(e, e));
+        }
+        bound = std::min(bound, patch.d[i] + std::sqrt(reach));
+    }
+    for (int i = 0; i < 3; ++i) {
+        if ((i > 0 && patch.nearest[i] == patch.nearest[0]) || (i > 1 && patch.nearest[i] == patch.nearest[1]))
+            continue;
+        const Triangle& t = mesh[patch.nearest[i]];
+        Vec a(t.p1), b(t.p2), c(t.p3);
+        double farthestSq = 0.0;
+        for (int j = 0; j < 3; ++j) {
+            Vec e = patch.v[j] - closestOnTriangle(patch.v[j], a, b, c);
+            farthestSq = std::max(farthestSq, dot(e, e));
+        }
+        bound = std::min(bound, std::sqrt(farthestSq));
+    }
+    return bound;
+}
+
+double hausdorffOneSided(const std::vector<Triangle>& a, const std::vector<Triangle>& b, const BVH& bvhB,
+                         float tolerance, Vec& onA, Vec& onB) {
+    if (tolerance <= 0.0f) {
+        AABB box;
+        for (const Triangle& t : a)
+            box.expand(triangleBounds(t));
+        tolerance = 1e-4f * std::max({ box.max.x - box.min.x, box.max.y - box.min.y, box.max.z - box.min.z });
+    }
+    SharedBest<std::greater<double>> farthest(0.0);
+
+    // 1. Every distinct corner once, exactly where it can raise the maximum
+    IndexedMesh welded = weldVertices(a);
+    std::vector<double> cornerDistance(welded.vertices.size());
+    std::vector<uint32_t> cornerNearest(welded.vertices.size());
+    parallelFor(welded.vertices.size(), 1024, [&](size_t begin, size_t end) {
+        Vec closest;
+        for (size_t v = begin; v < end; ++v) {
+            Vec p(welded.vertices[v]);
+            double d = nearestPoint(p, b, bvhB, farthest.get(), closest, cornerNearest[v]);
+            cornerDistance[v] = d;
+            farthest.offer(d, p, closest);
+        }
+    });
+
+    // 2. Triangles whose insides might still hold a farther point
+    const size_t chunk = 256;
+    parallelTasks((a.size() + chunk - 1) / chunk, [&](size_t c) {
+        std::vector<Patch> stack;
+        Vec closest;
+        for (size_t t = c * chunk; t < std::min(a.size(), (c + 1) * chunk); ++t) {
+            Patch root;
+            const POINT* corners[3] = { &a[t].p1, &a[t].p2, &a[t].p3 };
+            for (int k = 0; k < 3; ++k) {
+                root.v[k] = Vec(*corners[k]);
+                root.d[k] = cornerDistance[welded.indices[3 * t + k]];
+                root.nearest[k] = cornerNearest[welded.indices[3 * t + k]];
+            }
+            root.depth = 0;
+            stack.push_back(root);
+            while (!stack.empty()) {
+                Patch patch = stack.back();
+                stack.pop_back();
+                if (patch.depth >= MAX_SUBDIVISION || patchBound(patch, b) <= farthest.get() + tolerance)
+                    continue;
+                Vec mid[3];
+                double midDistance[3];
+                uint32_t midNearest[3];
+                for (int k = 0; k < 3; ++k) {
+                    mid[k] = (patch.v[k] + patch.v[(k + 1) % 3]) * 0.5;
+                    midDistance[k] = nearestPoint(mid[k], b, bvhB, farthest.get(), closest, midNearest[k]);
+                    farthest.offer(midDistance[k], mid[k], closest);
+                }
+                int depth = patch.depth + 1;
+                for (int k = 0; k < 3; ++k) {
+                    int prev = (k + 2) % 3;
+                    stack.push_back(Patch{ { patch.v[k], mid[k], mid[prev] },
+                                           { patch.d[k], midDistance[k], midDistance[prev] },
+                                           { patch.nearest[k], midNearest[k], midNearest[prev] }, depth });
+                }
+                stack.push_back(Patch{ { mid[0], mid[1], mid[2] }, { midDistance[0], midDistance[1], midDistance[2] },
+                                       { midNearest[0], midNearest[1], midNearest[2] }, depth });
+            }
+        }
+    });
+    onA = farthest.onA;
+    onB = farthest.onB;
+    return farthest.get();
+}
+
+} // namespace
+
+double triangleDistance(const Triangle& a, const Triangle& b, POINT* onA, POINT* onB) {
+    Vec ca, cb;
+    double sq = triangleDistanceSq(a, b, ca, cb);
+    if (onA)
+        *onA = ca.toPoint();
+    if (onB)
+        *onB = cb.toPoint();
+    return std::sqrt(sq);
+}
+
+bool minimumDistance(const std::vector<Triangle>& a, const BVH& bvhA, const std::vector<Triangle>& b,
+                     const BVH& bvhB, MeshDistance& result) {
+    if (a.empty() || b.empty() || bvhA.empty() || bvhB.empty()) {
+        std::cerr << "Error: Distance query needs two non-empty meshes\n";
+        return false;
+    }
+    // Subtree pairs for the workers, split until there are enough to balance
+    // and searched nearest first so the shared bound tightens early
+    struct Pair {
+        uint32_t a, b;
+        double distanceSq;
+    };
+    std::vector<Pair> pairs{ Pair{ 0, 0, 0.0 } };
+    const size_t target = workerCount() > 1 ? 16 * workerCount() : 1;
+    while (pairs.size() < target) {
+        std::vector<Pair> next;
+        for (const Pair& p : pairs) {
+            const BVHNode& na = bvhA.nodes[p.a];
+            const BVHNode& nb = bvhB.nodes[p.b];
+            if (na.isLeaf() && nb.isLeaf())
+                next.push_back(p);
+            else if (splitFirst(na, nb))
+                for (uint32_t child : { na.first, na.first + 1 })
+                    next.push_back(Pair{ child, p.b, boxDistanceSq(bvhA.nodes[child].bounds, nb.bounds) });
+            else
+                for (uint32_t child : { nb.first, nb.first + 1 })
+                    next.push_back(Pair{ p.a, child, boxDistanceSq(na.bounds, bvhB.nodes[child].bounds) });
+        }
+        if (next.size() == pairs.size())
+            break;
+        pairs.swap(next);
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const Pair& x, const Pair& y) { return x.distanceSq < y.distanceSq; });
+
+    SharedBest<std::less<double>> best(std::numeric_limits<double>::max());
+    parallelTasks(pairs.size(), [&](size_t k) {
+        if (pairs[k].distanceSq < best.get())
+            searchClosest(a, bvhA, b, bvhB, pairs[k].a, pairs[k].b, best);
+    });
+    result.distance = std::sqrt(best.get());
+    result.onA = best.onA.toPoint();
+    result.onB = best.onB.toPoint();
+    return true;
+}
+
+bool hausdorffDistance(const std::vector<Triangle>& a, const std::vector<Triangle>& b, const BVH& bvhB,
+                       MeshDistance& result, float tolerance) {
+    if (a.empty() || b.empty() || bvhB.empty()) {
+        std::cerr << "Error: Distance query needs two non-empty meshes\n";
+        return false;
+    }
+    Vec onA, onB;
+    result.distance = hausdorffOneSided(a, b, bvhB, tolerance, onA, onB);
+    result.onA = onA.toPoint();
+    result.onB = onB.toPoint();
+    return true;
+}
+
+bool symmetricHausdorffDistance(const std::vector<Triangle>& a, const BVH& bvhA, const std::vector<Triangle>& b,
+                                const BVH& bvhB, MeshDistance& result, float tolerance) {
+    MeshDistance forward, backward;
+    if (!hausdorffDistance(a, b, bvhB, forward, tolerance) || !hausdorffDistance(b, a, bvhA, backward, tolerance))
+        return false;
+    if (forward.distance >= backward.distance) {
+        result = forward;
+    } else {
+        result.distance = backward.distance;
+        result.onA = backward.onB;
+        result.onB = backward.onA;
+    }
+    return true;
+}
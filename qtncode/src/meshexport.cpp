@@ -0,0 +1,192 @@
+#include "meshexport.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+// Collects small writes in a 4 MB buffer and hands full buffers to fwrite
+class BufferedWriter {
+public:
+    explicit BufferedWriter(const std::string& filename)
+        : file(std::fopen(filename.c_str(), "wb")), buffer(4 << 20) {
+        if (!file)
+            std::cerr << "Error: Cannot write file " << filename << "\n";
+    }
+    ~BufferedWriter() { close(); }
+
+    bool isOpen() const { return file != nullptr; }
+
+    void write(const void* data, size_t size) {
+        if (used + size > buffer.size())
+            flush();
+        if (size > buffer.size()) {
+            failed |= std::fwrite(data, 1, size, file) != size;
+            return;
+        }
+        std::memcpy(buffer.data() + used, data, size);
+        used += size;
+    }
+    void write(const std::string& text) { write(text.data(), text.size()); }
+
+    bool close() {
+        if (!file)
+            return false;
+        flush();
+        failed |= std::fclose(file) != 0;
+        file = nullptr;
+        return !failed;
+    }
+
+private:
+    void flush() {
+        if (used > 0)
+            failed |= std::fwrite(buffer.data(), 1, used, file) != used;
+        used = 0;
+    }
+
+    std::FILE* file;
+    std::vector<char> buffer;
+    size_t used = 0;
+    bool failed = false;
+};
+
+} // namespace
+
+static const size_t STL_FACET_SIZE = 50;
+
+static void writeFacet(BufferedWriter& out, const POINT& a, const POINT& b, const POINT& c) {
+    float ux = b.x - a.x, uy = b.y - a.y, uz = b.z - a.z;
+    float vx = c.x - a.x, vy = c.y - a.y, vz = c.z - a.z;
+    float n[3] = { uy * vz - uz * vy, uz * vx - ux * vz, ux * vy - uy * vx };
+    float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (len > 0.0f) {
+        n[0] /= len;
+        n[1] /= len;
+        n[2] /= len;
+    }
+
+    char record[STL_FACET_SIZE] = {};
+    std::memcpy(record, n, sizeof(n));
+    std::memcpy(record + 12, &a, sizeof(POINT));
+    std::memcpy(record + 24, &b, sizeof(POINT));
+    std::memcpy(record + 36, &c, sizeof(POINT));
+    out.write(record, sizeof(record)); // Attribute byte count stays 0
+}
+
+static bool writeSTLHeader(BufferedWriter& out, size_t triangleCount) {
+    if (triangleCount > std::numeric_limits<uint32_t>::max()) {
+        std::cerr << "Error: Too many triangles for binary STL\n";
+        return false;
+    }
+    char header[80] = {};
+    std::snprintf(header, sizeof(header), "binary STL exported by qtncode");
+    out.write(header, sizeof(header));
+    uint32_t count = uint32_t(triangleCount);
+    out.write(&count, sizeof(count));
+    return true;
+}
+
+bool writeBinarySTL(const std::string& filename, const std::vector<Triangle>& triangles) {
+    BufferedWriter out(filename);
+    if (!out.isOpen() || !writeSTLHeader(out, triangles.size()))
+        return false;
+    for (const auto& t : triangles)
+        writeFacet(out, t.p1, t.p2, t.p3);
+    return out.close();
+}
+
+bool writeBinarySTL(const std::string& filename, const IndexedMesh& mesh) {
+    BufferedWriter out(filename);
+    if (!out.isOpen() || !writeSTLHeader(out, mesh.triangleCount()))
+        return false;
+    const uint32_t* idx = mesh.indices.data();
+    for (size_t i = 0; i < mesh.triangleCount(); ++i, idx += 3)
+        writeFacet(out, mesh.vertices[idx[0]], mesh.vertices[idx[1]], mesh.vertices[idx[2]]);
+    return out.close();
+}
+
+static void writePLYHeader(BufferedWriter& out, size_t vertexCount, size_t faceCount, size_t edgeCount) {
+    std::string header =
+        "ply\n"
+        "format binary_little_endian 1.0\n"
+        "comment exported by qtncode\n"
+        "element vertex " + std::to_string(vertexCount) + "\n"
+        "property float x\n"
+        "property float y\n"
+        "property float z\n";
+    if (faceCount > 0)
+        header += "element face " + std::to_string(faceCount) + "\n"
+                  "property list uchar uint vertex_indices\n";
+    if (edgeCount > 0)
+        header += "element edge " + std::to_string(edgeCount) + "\n"
+                  "property uint vertex1\n"
+                  "property uint vertex2\n";
+    header += "end_header\n";
+    out.write(header);
+}
+
+static void writeFace(BufferedWriter& out, uint32_t a, uint32_t b, uint32_t c) {
+    char record[13];
+    record[0] = 3;
+    std::memcpy(record + 1, &a, 4);
+    std::memcpy(record + 5, &b, 4);
+    std::memcpy(record + 9, &c, 4);
+    out.write(record, sizeof(record));
+}
+
+bool writeBinaryPLY(const std::string& filename, const IndexedMesh& mesh) {
+    BufferedWriter out(filename);
+    if (!out.isOpen())
+        return false;
+    writePLYHeader(out, mesh.vertices.size(), mesh.triangleCount(), 0);
+    out.write(mesh.vertices.data(), mesh.vertices.size() * sizeof(POINT));
+    const uint32_t* idx = mesh.indices.data();
+    for (size_t i = 0; i < mesh.triangleCount(); ++i, idx += 3)
+        writeFace(out, idx[0], idx[1], idx[2]);
+    return out.close();
+}
+
+bool writeBinaryPLY(const std::string& filename, const std::vector<Triangle>& triangles) {
+    if (triangles.size() * 3 > std::numeric_limits<uint32_t>::max()) {
+        std::cerr << "Error: Too many vertices for PLY export\n";
+        return false;
+    }
+    BufferedWriter out(filename);
+    if (!out.isOpen())
+        return false;
+    writePLYHeader(out, triangles.size() * 3, triangles.size(), 0);
+    out.write(triangles.data(), triangles.size() * sizeof(Triangle));
+    for (uint32_t i = 0; i < uint32_t(triangles.size()); ++i)
+        writeFace(out, 3 * i, 3 * i + 1, 3 * i + 2);
+    return out.close();
+}
+
+bool writeSegmentsPLY(const std::string& filename, const std::vector<std::pair<POINT, POINT>>& segments) {
+    BufferedWriter out(filename);
+    if (!out.isOpen())
+        return false;
+    writePLYHeader(out, segments.size() * 2, 0, segments.size());
+    for (const auto& seg : segments) {
+        out.write(&seg.first, sizeof(POINT));
+        out.write(&seg.second, sizeof(POINT));
+    }
+    for (uint32_t i = 0; i < uint32_t(segments.size()); ++i) {
+        uint32_t edge[2] = { 2 * i, 2 * i + 1 };
+        out.write(edge, sizeof(edge));
+    }
+    return out.close();
+}
+
+bool exportTriangles(const std::string& filename, const std::vector<Triangle>& triangles) {
+    std::string ext = filename.size() >= 4 ? filename.substr(filename.size() - 4) : "";
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+    if (ext == ".ply")
+        return writeBinaryPLY(filename, triangles);
+    return writeBinarySTL(filename, triangles);
+}
@@ -0,0 +1,394 @@
+#include "meshimport.h"
+#include "mappedfile.h"
+#include "tokenizer.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+// Lines (OBJ) or elements (PLY) read between two progress/cancellation checks
+static const size_t IMPORT_PROGRESS_STEP = 1 << 16;
+
+static std::string lowerExtension(const std::string& filename) {
+    size_t dot = filename.find_last_of('.');
+    std::string ext = dot == std::string::npos ? "" : filename.substr(dot);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+    return ext;
+}
+
+// Appends the fan (first, k, k + 1) of a polygon
+static void triangulateFan(const std::vector<uint32_t>& polygon, std::vector<uint32_t>& indices) {
+    for (size_t k = 1; k + 1 < polygon.size(); ++k) {
+        indices.push_back(polygon[0]);
+        indices.push_back(polygon[k]);
+        indices.push_back(polygon[k + 1]);
+    }
+}
+
+static bool checkIndices(const IndexedMesh& mesh) {
+    const size_t count = mesh.vertices.size();
+    bool valid = std::all_of(mesh.indices.begin(), mesh.indices.end(), [count](uint32_t i) { return i < count; });
+    if (!valid)
+        std::cerr << "Error: Face references a missing vertex\n";
+    return valid;
+}
+
+static bool reportProgress(const STLLoadControl* control, const char* position, const char* begin, size_t size) {
+    if (!control)
+        return true;
+    if (control->cancelled())
+        return false;
+    control->report(float(position - begin) / float(std::max<size_t>(size, 1)));
+    return true;
+}
+
+bool loadOBJ(const char* data, size_t size, IndexedMesh& mesh, const STLLoadControl* control) {
+    mesh.vertices.clear();
+    mesh.indices.clear();
+
+    Tokenizer tok(data, data + size);
+    std::vector<uint32_t> polygon;
+    size_t lines = 0;
+    while (!tok.atEnd()) {
+        if (++lines % IMPORT_PROGRESS_STEP == 0 && !reportProgress(control, tok.position(), data, size))
+            return false;
+
+        std::string_view keyword = tok.lineToken();
+        if (keyword == "v") {
+            float c[3];
+            if (!tok.number(c[0]) || !tok.number(c[1]) || !tok.number(c[2])) {
+                std::cerr << "Error: Malformed vertex in OBJ file\n";
+                return false;
+            }
+            mesh.vertices.emplace_back(c[0], c[1], c[2]);
+        } else if (keyword == "f") {
+            polygon.clear();
+            for (std::string_view corner = tok.lineToken(); !corner.empty(); corner = tok.lineToken()) {
+                // Only the position index before the first '/' matters
+                long long index = 0;
+                auto result = std::from_chars(corner.data(), corner.data() + corner.size(), index);
+                if (result.ec != std::errc() || index == 0) {
+                    std::cerr << "Error: Malformed face in OBJ file\n";
+                    return false;
+                }
+                index = index < 0 ? (long long)mesh.vertices.size() + index : index - 1;
+                if (index < 0 || index > (long long)std::numeric_limits<uint32_t>::max()) {
+                    std::cerr << "Error: Face references a missing vertex\n";
+                    return false;
+                }
+                polygon.push_back(uint32_t(index));
+            }
+            triangulateFan(polygon, mesh.indices);
+        }
+        tok.skipLine();
+    }
+    if (!checkIndices(mesh))
+        return false;
+    if (control)
+        control->report(1.0f);
+    return true;
+}
+
+namespace {
+
+enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64, Invalid };
+
+struct PlyProperty {
+    std::string name;
+    PlyType type = PlyType::Invalid;
+    bool isList = false;
+    PlyType countType = PlyType::Invalid;
+};
+
+struct PlyElement {
+    std::string name;
+    size_t count = 0;
+    std::vector<PlyProperty> properties;
+};
+
+PlyType plyType(std::string_view name) {
+    if (name == "char" || name == "int8") return PlyType::Int8;
+    if (name == "uchar" || name == "uint8") return PlyType::UInt8;
+    if (name == "short" || name == "int16") return PlyType::Int16;
+    if (name == "ushort" || name == "uint16") return PlyType::UInt16;
+    if (name == "int" || name == "int32") return PlyType::Int32;
+    if (name == "uint" || name == "uint32") return PlyType::UInt32;
+    if (name == "float" || name == "float32") return PlyType::Float32;
+    if (name == "double" || name == "float64") return PlyType::Float64;
+    return PlyType::Invalid;
+}
+
+size_t plySize(PlyType type) {
+    switch (type) {
+    case PlyType::Int8: case PlyType::UInt8: return 1;
+    case PlyType::Int16: case PlyType::UInt16: return 2;
+    case PlyType::Int32: case PlyType::UInt32: case PlyType::Float32: return 4;
+    case PlyType::Float64: return 8;
+    default: return 0;
+    }
+}
+
+// Reads typed values from the body of a PLY file, in any of its three
+// encodings. A read past the end or a malformed number sets `failed` and
+// yields 0, so callers check once per element instead of once per value.
+class PlyReader {
+public:
+    enum Format { Ascii, LittleEndian, BigEndian };
+
+    PlyReader(const char* p, const char* end, Format format) : tok(p, end), p(p), end(end), format(format) {}
+
+    double read(PlyType type) {
+        if (format == Ascii) {
+            double value = 0.0;
+            tok.skipSpace();
+            if (tok.atEnd() || !tok.number(value))
+                failed = true;
+            return value;
+        }
+        return readBinary(p, type);
+    }
+
+    // Binary value at an absolute position, for fixed-size records
+    double readBinary(const char*& at, PlyType type) {
+        unsigned char bytes[8];
+        size_t n = plySize(type);
+        if (n == 0 || size_t(end - at) < n) {
+            failed = true;
+            return 0.0;
+        }
+        std::memcpy(bytes, at, n);
+        at += n;
+        if (format == BigEndian)
+            std::reverse(bytes, bytes + n);
+        switch (type) {
+        case PlyType::Int8: { int8_t v; std::memcpy(&v, bytes, 1); return v; }
+        case PlyType::UInt8: return bytes[0];
+        case PlyType::Int16: { int16_t v; std::memcpy(&v, bytes, 2); return v; }
+        case PlyType::UInt16: { uint16_t v; std::memcpy(&v, bytes, 2); return v; }
+        case PlyType::Int32: { int32_t v; std::memcpy(&v, bytes, 4); return v; }
+        case PlyType::UInt32: { uint32_t v; std::memcpy(&v, bytes, 4); return v; }
+        case PlyType::Float32: { float v; std::memcpy(&v, bytes, 4); return v; }
+        case PlyType::Float64: { double v; std::memcpy(&v, bytes, 8); return v; }
+        default: return 0.0;
+        }
+    }
+
+    void skip(const PlyProperty& property) {
+        if (!property.isList) {
+            read(property.type);
+            return;
+        }
+        size_t count = size_t(read(property.countType));
+        if (format != Ascii && !failed) {
+            size_t bytes = count * plySize(property.type);
+            if (size_t(end - p) < bytes)
+                failed = true;
+            else
+                p += bytes;
+            return;
+        }
+        for (size_t i = 0; i < count && !failed; ++i)
+            read(property.type);
+    }
+
+    const char* position() const { return format == Ascii ? tok.position() : p; }
+    bool isBinary() const { return format != Ascii; }
+    void advance(size_t bytes) { p += bytes; }
+    size_t remaining() const { return size_t(end - p); }
+
+    bool failed = false;
+
+private:
+    Tokenizer tok;
+    const char* p;
+    const char* end;
+    Format format;
+};
+
+} // namespace
+
+bool loadPLY(const char* data, size_t size, IndexedMesh& mesh, const STLLoadControl* control) {
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    const char* end = data + size;
+    Tokenizer header(data, end);
+    if (header.lineToken() != "ply") {
+        std::cerr << "Error: Not a PLY file\n";
+        return false;
+    }
+    header.skipLine();
+
+    PlyReader::Format format = PlyReader::Ascii;
+    std::vector<PlyElement> elements;
+    bool headerDone = false;
+    while (!header.atEnd() && !headerDone) {
+        std::string_view keyword = header.lineToken();
+        if (keyword == "format") {
+            std::string_view name = header.lineToken();
+            if (name == "binary_little_endian")
+                format = PlyReader::LittleEndian;
+            else if (name == "binary_big_endian")
+                format = PlyReader::BigEndian;
+            else if (name != "ascii") {
+                std::cerr << "Error: Unknown PLY format " << std::string(name) << "\n";
+                return false;
+            }
+        } else if (keyword == "element") {
+            PlyElement element;
+            element.name = std::string(header.lineToken());
+            long long count = 0;
+            if (!header.number(count) || count < 0) {
+                std::cerr << "Error: Malformed PLY element\n";
+                return false;
+            }
+            element.count = size_t(count);
+            elements.push_back(std::move(element));
+        } else if (keyword == "property") {
+            if (elements.empty()) {
+                std::cerr << "Error: PLY property outside an element\n";
+                return false;
+            }
+            PlyProperty property;
+            std::string_view type = header.lineToken();
+            if (type == "list") {
+                property.isList = true;
+                property.countType = plyType(header.lineToken());
+                type = header.lineToken();
+            }
+            property.type = plyType(type);
+            property.name = std::string(header.lineToken());
+            if (property.type == PlyType::Invalid || (property.isList && property.countType == PlyType::Invalid)) {
+                std::cerr << "Error: Unknown PLY property type\n";
+                return false;
+            }
+            elements.back().properties.push_back(std::move(property));
+        } else if (keyword == "end_header") {
+            headerDone = true;
+        }
+        header.skipLine(); // comment, obj_info and unknown lines included
+    }
+    if (!headerDone) {
+        std::cerr << "Error: PLY header is incomplete\n";
+        return false;
+    }
+
+    PlyReader reader(header.position(), end, format);
+    std::vector<uint32_t> polygon;
+    for (const PlyElement& element : elements) {
+        const bool isVertex = element.name == "vertex";
+        const bool isFace = element.name == "face";
+        int axis[3] = { -1, -1, -1 };
+        int faceList = -1;
+        bool fixedSize = true;
+        size_t stride = 0;
+        std::vector<size_t> offsets;
+        for (size_t k = 0; k < element.properties.size(); ++k) {
+            const PlyProperty& property = element.properties[k];
+            offsets.push_back(stride);
+            stride += plySize(property.type);
+            fixedSize = fixedSize && !property.isList;
+            if (isVertex && !property.isList && property.name.size() == 1 && property.name[0] >= 'x' && property.name[0] <= 'z')
+                axis[property.name[0] - 'x'] = int(k);
+            if (isFace && property.isList && (property.name == "vertex_indices" || property.name == "vertex_index"))
+                faceList = int(k);
+        }
+        if (isVertex && (axis[0] < 0 || axis[1] < 0 || axis[2] < 0)) {
+            std::cerr << "Error: PLY vertices have no x/y/z\n";
+            return false;
+        }
+
+        if (isVertex)
+            mesh.vertices.reserve(element.count);
+        if (isFace)
+            mesh.indices.reserve(3 * element.count);
+
+        // Binary elements without lists are records of a fixed stride
+        if (reader.isBinary() && fixedSize) {
+            if (stride > 0 && reader.remaining() / stride < element.count) {
+                std::cerr << "Error: PLY file is truncated\n";
+                return false;
+            }
+            if (isVertex) {
+                const char* record = reader.position();
+                for (size_t i = 0; i < element.count; ++i, record += stride) {
+                    float c[3];
+                    for (int a = 0; a < 3; ++a) {
+                        const char* at = record + offsets[axis[a]];
+                        c[a] = float(reader.readBinary(at, element.properties[axis[a]].type));
+                    }
+                    mesh.vertices.emplace_back(c[0], c[1], c[2]);
+                    if (i % IMPORT_PROGRESS_STEP == 0 && !reportProgress(control, record, data, size))
+                        return false;
+                }
+            }
+            reader.advance(stride * element.count);
+            continue;
+        }
+
+        std::vector<double> values(element.properties.size());
+        for (size_t i = 0; i < element.count; ++i) {
+            if (i % IMPORT_PROGRESS_STEP == 0 && !reportProgress(control, reader.position(), data, size))
+                return false;
+            for (size_t k = 0; k < element.properties.size(); ++k) {
+                const PlyProperty& property = element.properties[k];
+                if (int(k) == faceList) {
+                    size_t count = size_t(reader.read(property.countType));
+                    polygon.clear();
+                    for (size_t j = 0; j < count && !reader.failed; ++j) {
+                        double index = reader.read(property.type);
+                        if (index < 0 || index > double(std::numeric_limits<uint32_t>::max()))
+                            reader.failed = true;
+                        polygon.push_back(uint32_t(index));
+                    }
+                    triangulateFan(polygon, mesh.indices);
+                } else if (isVertex && !property.isList) {
+                    values[k] = reader.read(property.type);
+                } else {
+                    reader.skip(property);
+                }
+            }
+            if (reader.failed) {
+                std::cerr << "Error: Malformed or truncated PLY data\n";
+                return false;
+            }
+            if (isVertex)
+                mesh.vertices.emplace_back(float(values[axis[0]]), float(values[axis[1]]), float(values[axis[2]]));
+        }
+    }
+
+    if (!checkIndices(mesh))
+        return false;
+    if (control)
+        control->report(1.0f);
+    return true;
+}
+
+bool isIndexedMeshFile(const std::string& filename) {
+    std::string ext = lowerExtension(filename);
+    return ext == ".obj" || ext == ".ply";
+}
+
+bool loadIndexedMeshFile(const std::string& filename, IndexedMesh& mesh, const STLLoadControl* control) {
+    MappedFile file(filename);
+    if (!file.isOpen()) {
+        std::cerr << "Error: Cannot open file " << filename << "\n";
+        return false;
+    }
+    if (lowerExtension(filename) == ".obj")
+        return loadOBJ(file.data(), file.size(), mesh, control);
+    return loadPLY(file.data(), file.size(), mesh, control);
+}
+
+bool loadMeshFile(const std::string& filename, std::vector<Triangle>& triangles, const STLLoadControl* control) {
+    if (!isIndexedMeshFile(filename))
+        return loadSTLFile(filename, triangles, control);
+    IndexedMesh mesh;
+    if (!loadIndexedMeshFile(filename, mesh, control))
+        return false;
+    std::vector<Triangle> soup = mesh.toTriangles();
+    triangles.insert(triangles.end(), soup.begin(), soup.end());
+    return true;
+}
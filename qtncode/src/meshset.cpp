@@ -0,0 +1,100 @@
+#include "meshset.h"
+#include <cmath>
+
+MeshSet meshSet;
+
+// The first two match the colors meshes A and B always had
+static const float MESH_PALETTE[][3] = {
+    { 0.2f, 0.8f, 0.0f }, { 0.0f, 0.2f, 0.9f }, { 0.9f, 0.5f, 0.0f }, { 0.8f, 0.1f, 0.6f },
+    { 0.0f, 0.7f, 0.7f }, { 0.9f, 0.9f, 0.2f }, { 0.5f, 0.3f, 0.9f }, { 0.9f, 0.2f, 0.2f },
+};
+static const size_t MESH_PALETTE_SIZE = sizeof(MESH_PALETTE) / sizeof(MESH_PALETTE[0]);
+
+// Past the fixed palette, walk the hue circle by the golden angle
+static void paletteColor(size_t n, float rgb[3]) {
+    if (n < MESH_PALETTE_SIZE) {
+        for (int k = 0; k < 3; ++k)
+            rgb[k] = MESH_PALETTE[n][k];
+        return;
+    }
+    float h = std::fmod(float(n) * 0.618034f, 1.0f) * 6.0f;
+    float x = 1.0f - std::fabs(std::fmod(h, 2.0f) - 1.0f);
+    const float s = 0.75f, v = 0.9f;
+    float r = 0, g = 0, b = 0;
+    switch (int(h)) {
+    case 0: r = 1; g = x; break;
+    case 1: r = x; g = 1; break;
+    case 2: g = 1; b = x; break;
+    case 3: g = x; b = 1; break;
+    case 4: r = x; b = 1; break;
+    default: r = 1; b = x; break;
+    }
+    rgb[0] = v * (1 - s + s * r);
+    rgb[1] = v * (1 - s + s * g);
+    rgb[2] = v * (1 - s + s * b);
+}
+
+std::vector<Triangle> MeshEntry::toTriangles() const {
+    if (!blocked)
+        return triangles;
+    std::vector<Triangle> result;
+    result.reserve(blocked->triangleCount());
+    for (size_t b = 0; b < blocked->blockCount(); ++b) {
+        BlockedMesh::Block block = blocked->block(b);
+        result.insert(result.end(), block->begin(), block->end());
+    }
+    return result;
+}
+
+std::vector<Triangle> MeshEntry::placedTriangles(const RigidTransform& place) const {
+    std::vector<Triangle> result = toTriangles();
+    if (!place.isIdentity())
+        for (Triangle& t : result)
+            t = place.apply(t);
+    return result;
+}
+
+size_t MeshSet::add(std::unique_ptr<MeshEntry> mesh) {
+    paletteColor(colorsUsed++, mesh->color);
+    mesh->id = nextId++;
+    meshes.push_back(std::move(mesh));
+    int index = int(meshes.size() - 1);
+    if (indexA < 0)
+        indexA = index;
+    else if (indexB < 0)
+        indexB = index;
+    return size_t(index);
+}
+
+void MeshSet::remove(size_t index) {
+    if (index >= meshes.size())
+        return;
+    meshes.erase(meshes.begin() + index);
+    auto shift = [index](int& i) {
+        if (i == int(index))
+            i = -1;
+        else if (i > int(index))
+            --i;
+    };
+    shift(indexA);
+    shift(indexB);
+}
+
+void MeshSet::clear() {
+    meshes.clear();
+    colorsUsed = 0;
+    indexA = indexB = -1;
+}
+
+int MeshSet::find(const std::string& name) const {
+    for (size_t i = 0; i < meshes.size(); ++i)
+        if (meshes[i]->name == name)
+            return int(i);
+    return -1;
+}
+
+void MeshSet::setIntersectionPair(int a, int b) {
+    auto valid = [this](int i) { return i >= 0 && i < int(meshes.size()) ? i : -1; };
+    indexA = valid(a);
+    indexB = valid(b);
+}
@@ -0,0 +1,146 @@
+#include "morton.h"
+#include "parallel.h"
+#include <algorithm>
+
+// Below this many keys the radix sort runs on the calling thread only
+static const size_t MORTON_PARALLEL_THRESHOLD = 1 << 16;
+// 30-bit codes are sorted in three passes of 10 bits
+static const int RADIX_BITS = 10;
+static const size_t RADIX_BUCKETS = size_t(1) << RADIX_BITS;
+
+// Spreads the low 10 bits of v so that two zero bits follow each one
+static uint32_t spreadBits(uint32_t v) {
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+uint32_t mortonCode(const POINT& p, const AABB& box) {
+    auto cell = [](float v, float lo, float hi) {
+        float t = hi > lo ? (v - lo) / (hi - lo) : 0.0f;
+        return uint32_t(std::min(std::max(t, 0.0f), 1.0f) * 1023.0f);
+    };
+    return (spreadBits(cell(p.x, box.min.x, box.max.x)) << 2) |
+           (spreadBits(cell(p.y, box.min.y, box.max.y)) << 1) |
+           spreadBits(cell(p.z, box.min.z, box.max.z));
+}
+
+void sortMortonKeys(std::vector<uint64_t>& keys) {
+    const size_t n = keys.size();
+    const size_t chunks = n < MORTON_PARALLEL_THRESHOLD ? 1 : workerCount();
+    std::vector<uint64_t> scratch(n);
+    std::vector<size_t> offsets(chunks * RADIX_BUCKETS);
+
+    for (int shift = 32; shift < 32 + 30; shift += RADIX_BITS) {
+        auto digit = [shift](uint64_t key) { return size_t(key >> shift) & (RADIX_BUCKETS - 1); };
+
+        // Per-chunk histograms
+        std::fill(offsets.begin(), offsets.end(), 0);
+        parallelChunks(chunks, [&](size_t c) {
+            size_t* count = &offsets[c * RADIX_BUCKETS];
+            for (size_t i = c * n / chunks; i < (c + 1) * n / chunks; ++i)
+                ++count[digit(keys[i])];
+        });
+
+        // Exclusive prefix over (bucket, chunk), so every chunk scatters into
+        // its own slice of each bucket and the sort stays stable
+        size_t sum = 0;
+        for (size_t b = 0; b < RADIX_BUCKETS; ++b) {
+            for (size_t c = 0; c < chunks; ++c) {
+                size_t count = offsets[c * RADIX_BUCKETS + b];
+                offsets[c * RADIX_BUCKETS + b] = sum;
+                sum += count;
+            }
+        }
+
+        parallelChunks(chunks, [&](size_t c) {
+            size_t* next = &offsets[c * RADIX_BUCKETS];
+            for (size_t i = c * n / chunks; i < (c + 1) * n / chunks; ++i)
+                scratch[next[digit(keys[i])]++] = keys[i];
+        });
+        keys.swap(scratch);
+    }
+}
+
+// Keys (code << 32 | i) for n items whose representative point is point(i)
+template <typename Fn>
+static std::vector<uint64_t> mortonKeys(size_t n, const AABB& box, Fn point) {
+    std::vector<uint64_t> keys(n);
+    parallelFor(n, 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            keys[i] = (uint64_t(mortonCode(point(i), box)) << 32) | i;
+    });
+    sortMortonKeys(keys);
+    return keys;
+}
+
+template <typename Fn>
+static AABB pointBounds(size_t n, Fn point) {
+    const size_t chunks = n < MORTON_PARALLEL_THRESHOLD ? 1 : workerCount();
+    std::vector<AABB> partial(chunks);
+    parallelChunks(chunks, [&](size_t c) {
+        for (size_t i = c * n / chunks; i < (c + 1) * n / chunks; ++i)
+            partial[c].expand(point(i));
+    });
+    AABB box;
+    for (const auto& b : partial)
+        box.expand(b);
+    return box;
+}
+
+static POINT centroid(const POINT& a, const POINT& b, const POINT& c) {
+    return POINT((a.x + b.x + c.x) / 3.0f, (a.y + b.y + c.y) / 3.0f, (a.z + b.z + c.z) / 3.0f);
+}
+
+void reorderMorton(std::vector<Triangle>& triangles) {
+    if (triangles.size() > 0xffffffffu)
+        return; // Indices would not fit the key
+    auto center = [&](size_t i) { return centroid(triangles[i].p1, triangles[i].p2, triangles[i].p3); };
+    std::vector<uint64_t> keys = mortonKeys(triangles.size(), pointBounds(triangles.size(), center), center);
+
+    std::vector<Triangle> sorted(triangles.size());
+    parallelFor(sorted.size(), 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            sorted[i] = triangles[uint32_t(keys[i])];
+    });
+    triangles.swap(sorted);
+}
+
+void reorderMorton(IndexedMesh& mesh) {
+    const size_t vertexCount = mesh.vertices.size();
+    const size_t triangleCount = mesh.triangleCount();
+    if (vertexCount > 0xffffffffu || triangleCount > 0xffffffffu)
+        return;
+
+    // Vertices first, so that the renumbered indices come out coherent too
+    auto position = [&](size_t i) { return mesh.vertices[i]; };
+    const AABB box = pointBounds(vertexCount, position);
+    std::vector<uint64_t> keys = mortonKeys(vertexCount, box, position);
+    std::vector<POINT> sortedVertices(vertexCount);
+    std::vector<uint32_t> renumber(vertexCount);
+    parallelFor(vertexCount, 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            uint32_t old = uint32_t(keys[i]);
+            sortedVertices[i] = mesh.vertices[old];
+            renumber[old] = uint32_t(i);
+        }
+    });
+
+    const POINT* v = mesh.vertices.data();
+    const uint32_t* idx = mesh.indices.data();
+    auto center = [&](size_t t) { return centroid(v[idx[3 * t]], v[idx[3 * t + 1]], v[idx[3 * t + 2]]); };
+    keys = mortonKeys(triangleCount, box, center);
+    std::vector<uint32_t> indices(mesh.indices.size());
+    parallelFor(triangleCount, 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            const uint32_t* src = idx + 3 * size_t(uint32_t(keys[t]));
+            for (int k = 0; k < 3; ++k)
+                indices[3 * t + k] = renumber[src[k]];
+        }
+    });
+    mesh.vertices.swap(sortedVertices);
+    mesh.indices.swap(indices);
+}
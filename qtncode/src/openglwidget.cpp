@@ -285,6 +285,13 @@ void OpenGLWidget::extrudeCube(double height)
     }
 }
 
+std::vector<Triangle> OpenGLWidget::cubeTriangles() const
+{
+    if (!cube)
+        return {};
+    return cube->toTriangles();
+}
+
 // Helper to map mouse position to OpenGL coordinates
 QPointF OpenGLWidget::mapToOpenGLCoordinates(const QPoint &mousePos)
 {
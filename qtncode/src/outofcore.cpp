@@ -0,0 +1,116 @@
+#include "outofcore.h"
+#include "meshcache.h"
+#include "morton.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+static const size_t STL_PREAMBLE_SIZE = 84;
+static const size_t STL_FACET_SIZE = 50;
+
+Triangle OutOfCoreMesh::triangle(size_t i) const {
+    Triangle t;
+    if (records) {
+        std::memcpy(&t, records + i * STL_FACET_SIZE + 3 * sizeof(float), sizeof(Triangle));
+    } else {
+        const uint32_t* idx = cacheIndices + 3 * i;
+        if (idx[0] < cacheVertexCount && idx[1] < cacheVertexCount && idx[2] < cacheVertexCount)
+            t = Triangle(cacheVertices[idx[0]], cacheVertices[idx[1]], cacheVertices[idx[2]]);
+    }
+    return t;
+}
+
+bool OutOfCoreMesh::open(const std::string& filename, const STLLoadControl* control) {
+    if (!file.open(filename)) {
+        std::cerr << "Error: Cannot open file " << filename << "\n";
+        return false;
+    }
+
+    size_t count = 0;
+    const MeshCacheHeader* cache = reinterpret_cast<const MeshCacheHeader*>(file.data());
+    if (file.size() >= sizeof(MeshCacheHeader) && std::memcmp(cache->magic, "STLCACHE", 8) == 0) {
+        MeshCache view;
+        if (!view.open(filename))
+            return false;
+        // Same file, so the section offsets apply to our own mapping
+        cacheVertices = reinterpret_cast<const POINT*>(file.data() + cache->verticesOffset);
+        cacheIndices = reinterpret_cast<const uint32_t*>(file.data() + cache->indicesOffset);
+        cacheVertexCount = view.vertexCount();
+        count = view.triangleCount();
+    } else if (isBinarySTL(file.data(), file.size())) {
+        uint32_t facets;
+        std::memcpy(&facets, file.data() + 80, sizeof(facets));
+        count = facets;
+        if (STL_PREAMBLE_SIZE + uint64_t(count) * STL_FACET_SIZE > file.size()) {
+            std::cerr << "Error: Binary STL is truncated\n";
+            return false;
+        }
+        records = file.data() + STL_PREAMBLE_SIZE;
+    } else {
+        std::cerr << "Error: Out-of-core mode needs a binary STL or .stlc file\n";
+        return false;
+    }
+
+    // Pass 1: mesh bounds
+    const size_t chunks = workerCount();
+    std::vector<AABB> partial(chunks);
+    parallelChunks(chunks, [&](size_t c) {
+        for (size_t i = c * count / chunks; i < (c + 1) * count / chunks; ++i)
+            partial[c].expand(triangleBounds(triangle(i)));
+    });
+    meshBounds = AABB();
+    for (const auto& box : partial)
+        meshBounds.expand(box);
+    if (control) {
+        if (control->cancelled())
+            return false;
+        control->report(0.3f);
+    }
+
+    // Pass 2: order triangles along the Morton curve of their centroids
+    std::vector<uint64_t> keys(count);
+    parallelFor(count, 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            keys[i] = (uint64_t(mortonCode(triangleBounds(triangle(i)).center(), meshBounds)) << 32) | i;
+    });
+    sortMortonKeys(keys);
+    order.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        order[i] = uint32_t(keys[i]);
+    std::vector<uint64_t>().swap(keys);
+    if (control) {
+        if (control->cancelled())
+            return false;
+        control->report(0.7f);
+    }
+
+    // Pass 3: bounds of every block
+    blockBounds.assign((count + BLOCK_TRIANGLES - 1) / BLOCK_TRIANGLES, AABB());
+    parallelFor(blockBounds.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b)
+            for (size_t i = b * BLOCK_TRIANGLES; i < std::min(count, (b + 1) * BLOCK_TRIANGLES); ++i)
+                blockBounds[b].expand(triangleBounds(triangle(order[i])));
+    });
+    if (control)
+        control->report(1.0f);
+    return true;
+}
+
+OutOfCoreMesh::Block OutOfCoreMesh::block(size_t b) {
+    if (Block held = residentBlocks.find(b))
+        return held;
+
+    // Decode outside the lock so several threads can page in different blocks
+    auto decoded = std::make_shared<std::vector<Triangle>>();
+    size_t begin = b * BLOCK_TRIANGLES;
+    size_t end = std::min(order.size(), begin + BLOCK_TRIANGLES);
+    decoded->reserve(end - begin);
+    for (size_t i = begin; i < end; ++i)
+        decoded->push_back(triangle(order[i]));
+    return residentBlocks.insert(b, decoded);
+}
+
+bool OutOfCoreMesh::isResident(size_t b) const {
+    return residentBlocks.contains(b);
+}
@@ -0,0 +1,91 @@
+#include "parallel.h"
+#include <atomic>
+
+struct WorkerPool::Job {
+    void (*call)(void*, size_t);
+    void* context;
+    size_t chunks;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> finished{0};
+    std::mutex mutex;
+    std::condition_variable done;
+
+    // Claims and runs one chunk; false once every chunk has been claimed
+    bool runOne() {
+        size_t c = next++;
+        if (c >= chunks)
+            return false;
+        call(context, c);
+        if (++finished == chunks) {
+            std::lock_guard<std::mutex> lock(mutex);
+            done.notify_all();
+        }
+        return true;
+    }
+};
+
+WorkerPool& WorkerPool::instance() {
+    static WorkerPool pool;
+    return pool;
+}
+
+WorkerPool::WorkerPool() {
+    for (unsigned i = 1; i < workerCount(); ++i)
+        threads.emplace_back(&WorkerPool::work, this);
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& t : threads)
+        t.join();
+}
+
+void WorkerPool::work() {
+    for (;;) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || !jobs.empty(); });
+            if (stopping)
+                return;
+            job = jobs.front();
+        }
+        if (!job->runOne()) {
+            // Fully claimed: take it off the queue unless someone already did
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!jobs.empty() && jobs.front() == job)
+                jobs.pop_front();
+        }
+    }
+}
+
+void WorkerPool::run(size_t chunks, void (*call)(void*, size_t), void* context) {
+    auto job = std::make_shared<Job>();
+    job->call = call;
+    job->context = context;
+    job->chunks = chunks;
+    if (!threads.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(job);
+        }
+        wake.notify_all();
+    }
+
+    while (job->runOne()) {
+    }
+    if (!threads.empty()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = jobs.begin(); it != jobs.end(); ++it)
+            if (*it == job) {
+                jobs.erase(it);
+                break;
+            }
+    }
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->done.wait(lock, [&] { return job->finished == job->chunks; });
+}
@@ -0,0 +1,172 @@
+#include "polyline.h"
+#include "bvh.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+
+static double distance(const POINT& p, const POINT& q) {
+    double dx = double(p.x) - q.x, dy = double(p.y) - q.y, dz = double(p.z) - q.z;
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+// End of a cell's point chain
+static const uint32_t NONE = UINT32_MAX;
+
+namespace {
+
+// Merges points within a tolerance. Every point lands in a cell at least
+// the tolerance wide, so its matches can only lie in the 27 cells around it.
+class EndpointWelder {
+public:
+    EndpointWelder(const AABB& bounds, float tolerance)
+        : origin(bounds.min), tolerance(tolerance), inverseCell(1.0 / tolerance) {}
+
+    // Index of the first earlier point within tolerance of p, or a new one
+    uint32_t weld(const POINT& p) {
+        int64_t cx = cellOf(p.x, origin.x), cy = cellOf(p.y, origin.y), cz = cellOf(p.z, origin.z);
+        for (int64_t dx = -1; dx <= 1; ++dx)
+            for (int64_t dy = -1; dy <= 1; ++dy)
+                for (int64_t dz = -1; dz <= 1; ++dz) {
+                    auto it = cells.find(key(cx + dx, cy + dy, cz + dz));
+                    if (it == cells.end())
+                        continue;
+                    for (uint32_t v = it->second; v != NONE; v = nextInCell[v])
+                        if (distance(points[v], p) <= tolerance)
+                            return v;
+                }
+        uint32_t id = uint32_t(points.size());
+        points.push_back(p);
+        auto inserted = cells.emplace(key(cx, cy, cz), id);
+        nextInCell.push_back(inserted.second ? NONE : inserted.first->second);
+        inserted.first->second = id;
+        return id;
+    }
+
+    std::vector<POINT> points;
+
+private:
+    int64_t cellOf(float v, float min) const { return int64_t(std::floor((double(v) - min) * inverseCell)); }
+    // 21 bits per axis; distant cells that wrap onto the same key only cost
+    // extra distance checks
+    static uint64_t key(int64_t x, int64_t y, int64_t z) {
+        const uint64_t mask = (uint64_t(1) << 21) - 1;
+        return (uint64_t(x) & mask) << 42 | (uint64_t(y) & mask) << 21 | (uint64_t(z) & mask);
+    }
+
+    POINT origin;
+    double tolerance;
+    double inverseCell;
+    std::unordered_map<uint64_t, uint32_t> cells; // Cell key -> last point in it
+    std::vector<uint32_t> nextInCell;
+};
+
+} // namespace
+
+PolylineStats chainSegments(const std::vector<std::pair<POINT, POINT>>& segments,
+                            std::vector<Polyline>& polylines, float tolerance) {
+    PolylineStats stats;
+    polylines.clear();
+    if (segments.empty())
+        return stats;
+
+    AABB bounds;
+    for (const auto& seg : segments) {
+        bounds.expand(seg.first);
+        bounds.expand(seg.second);
+    }
+    if (tolerance <= 0.0f) {
+        float extent = std::max(bounds.max.x - bounds.min.x,
+                                std::max(bounds.max.y - bounds.min.y, bounds.max.z - bounds.min.z));
+        tolerance = extent > 0.0f ? extent * 1e-5f : 1e-5f;
+    }
+
+    // 1. Weld endpoints and key every edge by its ordered vertex pair; sorting
+    //    the keys with the segment index attached keeps input order among equals
+    EndpointWelder welder(bounds, tolerance);
+    welder.points.reserve(segments.size());
+    std::vector<std::pair<uint64_t, uint32_t>> keyed;
+    keyed.reserve(segments.size());
+    for (size_t i = 0; i < segments.size(); ++i) {
+        uint32_t u = welder.weld(segments[i].first);
+        uint32_t v = welder.weld(segments[i].second);
+        if (u == v)
+            continue;
+        keyed.emplace_back(uint64_t(std::min(u, v)) << 32 | std::max(u, v), uint32_t(i));
+    }
+    std::sort(keyed.begin(), keyed.end());
+    keyed.erase(std::unique(keyed.begin(), keyed.end(),
+                            [](const std::pair<uint64_t, uint32_t>& x, const std::pair<uint64_t, uint32_t>& y) {
+                                return x.first == y.first;
+                            }),
+                keyed.end());
+    std::sort(keyed.begin(), keyed.end(),
+              [](const std::pair<uint64_t, uint32_t>& x, const std::pair<uint64_t, uint32_t>& y) {
+                  return x.second < y.second;
+              });
+    const std::vector<POINT>& points = welder.points;
+    stats.vertices = points.size();
+    stats.dropped = segments.size() - keyed.size();
+
+    // 2. Incident edges per vertex (compressed rows)
+    const size_t edges = keyed.size();
+    std::vector<uint32_t> ends(2 * edges);
+    std::vector<uint32_t> firstEdge(points.size() + 1, 0);
+    for (size_t e = 0; e < edges; ++e) {
+        ends[2 * e] = uint32_t(keyed[e].first >> 32);
+        ends[2 * e + 1] = uint32_t(keyed[e].first);
+        ++firstEdge[ends[2 * e] + 1];
+        ++firstEdge[ends[2 * e + 1] + 1];
+    }
+    for (size_t v = 0; v < points.size(); ++v)
+        firstEdge[v + 1] += firstEdge[v];
+    std::vector<uint32_t> incident(2 * edges);
+    std::vector<uint32_t> fill(firstEdge.begin(), firstEdge.end() - 1);
+    for (size_t e = 0; e < edges; ++e) {
+        incident[fill[ends[2 * e]]++] = uint32_t(e);
+        incident[fill[ends[2 * e + 1]]++] = uint32_t(e);
+    }
+    std::vector<uint32_t>().swap(fill);
+    auto degree = [&](uint32_t v) { return firstEdge[v + 1] - firstEdge[v]; };
+
+    // 3. Walk from `start` along edge `e` until a vertex that is not a plain
+    //    pass-through, or until the walk runs out of unused edges
+    std::vector<bool> used(edges, false);
+    auto walk = [&](uint32_t start, uint32_t e) {
+        Polyline line;
+        line.points.push_back(points[start]);
+        uint32_t at = start;
+        for (;;) {
+            used[e] = true;
+            uint32_t next = ends[2 * e] == at ? ends[2 * e + 1] : ends[2 * e];
+            stats.length += distance(points[at], points[next]);
+            at = next;
+            if (at == start) {
+                line.closed = true;
+                break;
+            }
+            line.points.push_back(points[at]);
+            if (degree(at) != 2)
+                break;
+            uint32_t other = incident[firstEdge[at]] == e ? incident[firstEdge[at] + 1] : incident[firstEdge[at]];
+            if (used[other])
+                break;
+            e = other;
+        }
+        ++(line.closed ? stats.loops : stats.open);
+        polylines.push_back(std::move(line));
+    };
+
+    // Chains ending at free ends or junctions first, then the plain loops left over
+    for (uint32_t v = 0; v < points.size(); ++v) {
+        if (degree(v) == 2)
+            continue;
+        for (uint32_t k = firstEdge[v]; k < firstEdge[v + 1]; ++k)
+            if (!used[incident[k]])
+                walk(v, incident[k]);
+    }
+    for (uint32_t e = 0; e < edges; ++e)
+        if (!used[e])
+            walk(ends[2 * e], e);
+    return stats;
+}
@@ -0,0 +1,175 @@
+#include "predicates.h"
+#include <algorithm>
+#include <cmath>
+
+// Unit roundoff of double precision, as in Shewchuk's predicates
+static const double EPSILON = 1.1102230246251565e-16; // 2^-53
+static const double CCW_ERROR_BOUND = (3.0 + 16.0 * EPSILON) * EPSILON;
+static const double O3D_ERROR_BOUND = (7.0 + 56.0 * EPSILON) * EPSILON;
+static const double DOT_ERROR_BOUND = (5.0 + 64.0 * EPSILON) * EPSILON;
+
+// Exact arithmetic on expansions: sums of doubles with non-overlapping
+// mantissas, smallest magnitude first. Only used when a filter fails, so the
+// simple quadratic algorithms are good enough.
+struct Expansion {
+    static const int CAPACITY = 256;
+    double e[CAPACITY];
+    int n = 0;
+
+    // Copies only the components in use
+    Expansion() = default;
+    Expansion(const Expansion& other) : n(other.n) { std::copy(other.e, other.e + n, e); }
+    Expansion& operator=(const Expansion& other) {
+        n = other.n;
+        std::copy(other.e, other.e + n, e);
+        return *this;
+    }
+
+    void push(double v) {
+        if (v != 0.0)
+            e[n++] = v;
+    }
+    double sign() const { return n ? e[n - 1] : 0.0; }
+};
+
+static void twoSum(double a, double b, double& x, double& y) {
+    x = a + b;
+    double bv = x - a;
+    double av = x - bv;
+    y = (a - av) + (b - bv);
+}
+
+static void fastTwoSum(double a, double b, double& x, double& y) {
+    x = a + b;
+    y = b - (x - a);
+}
+
+static void twoProduct(double a, double b, double& x, double& y) {
+    x = a * b;
+    y = std::fma(a, b, -x);
+}
+
+// a - b exactly, as a two-term expansion
+static Expansion difference(double a, double b) {
+    double x = a - b;
+    double bv = a - x;
+    double av = x + bv;
+    Expansion r;
+    r.push((a - av) + (bv - b));
+    r.push(x);
+    return r;
+}
+
+static Expansion add(const Expansion& e, const Expansion& f) {
+    Expansion r = e;
+    for (int j = 0; j < f.n; ++j) {
+        Expansion g;
+        double q = f.e[j];
+        for (int i = 0; i < r.n; ++i) {
+            double sum, err;
+            twoSum(q, r.e[i], sum, err);
+            g.push(err);
+            q = sum;
+        }
+        g.push(q);
+        r = g;
+    }
+    return r;
+}
+
+static Expansion negate(Expansion e) {
+    for (int i = 0; i < e.n; ++i)
+        e.e[i] = -e.e[i];
+    return e;
+}
+
+static Expansion scale(const Expansion& e, double b) {
+    Expansion r;
+    if (e.n == 0)
+        return r;
+    double q, err;
+    twoProduct(e.e[0], b, q, err);
+    r.push(err);
+    for (int i = 1; i < e.n; ++i) {
+        double p1, p0, sum;
+        twoProduct(e.e[i], b, p1, p0);
+        twoSum(q, p0, sum, err);
+        r.push(err);
+        fastTwoSum(p1, sum, q, err);
+        r.push(err);
+    }
+    r.push(q);
+    return r;
+}
+
+static Expansion multiply(const Expansion& e, const Expansion& f) {
+    Expansion r;
+    for (int j = 0; j < f.n; ++j)
+        r = add(r, scale(e, f.e[j]));
+    return r;
+}
+
+static double orient2dExact(double ax, double ay, double bx, double by, double cx, double cy) {
+    Expansion left = multiply(difference(ax, cx), difference(by, cy));
+    Expansion right = multiply(difference(ay, cy), difference(bx, cx));
+    return add(left, negate(right)).sign();
+}
+
+double orient2d(double ax, double ay, double bx, double by, double cx, double cy) {
+    double detLeft = (ax - cx) * (by - cy);
+    double detRight = (ay - cy) * (bx - cx);
+    double det = detLeft - detRight;
+    double bound = CCW_ERROR_BOUND * (std::fabs(detLeft) + std::fabs(detRight));
+    if (det > bound || -det > bound)
+        return det;
+    return orient2dExact(ax, ay, bx, by, cx, cy);
+}
+
+double orient2d(const POINT& a, const POINT& b, const POINT& c) {
+    return orient2d(a.x, a.y, b.x, b.y, c.x, c.y);
+}
+
+static double orient3dExact(const POINT& a, const POINT& b, const POINT& c, const POINT& d) {
+    Expansion adx = difference(a.x, d.x), ady = difference(a.y, d.y), adz = difference(a.z, d.z);
+    Expansion bdx = difference(b.x, d.x), bdy = difference(b.y, d.y), bdz = difference(b.z, d.z);
+    Expansion cdx = difference(c.x, d.x), cdy = difference(c.y, d.y), cdz = difference(c.z, d.z);
+    Expansion bc = add(multiply(bdx, cdy), negate(multiply(cdx, bdy)));
+    Expansion ca = add(multiply(cdx, ady), negate(multiply(adx, cdy)));
+    Expansion ab = add(multiply(adx, bdy), negate(multiply(bdx, ady)));
+    return add(add(multiply(adz, bc), multiply(bdz, ca)), multiply(cdz, ab)).sign();
+}
+
+double orient3d(const POINT& a, const POINT& b, const POINT& c, const POINT& d) {
+    double adx = double(a.x) - d.x, ady = double(a.y) - d.y, adz = double(a.z) - d.z;
+    double bdx = double(b.x) - d.x, bdy = double(b.y) - d.y, bdz = double(b.z) - d.z;
+    double cdx = double(c.x) - d.x, cdy = double(c.y) - d.y, cdz = double(c.z) - d.z;
+    double bdxcdy = bdx * cdy, cdxbdy = cdx * bdy;
+    double cdxady = cdx * ady, adxcdy = adx * cdy;
+    double adxbdy = adx * bdy, bdxady = bdx * ady;
+    double det = adz * (bdxcdy - cdxbdy) + bdz * (cdxady - adxcdy) + cdz * (adxbdy - bdxady);
+    double permanent = (std::fabs(bdxcdy) + std::fabs(cdxbdy)) * std::fabs(adz) +
+                       (std::fabs(cdxady) + std::fabs(adxcdy)) * std::fabs(bdz) +
+                       (std::fabs(adxbdy) + std::fabs(bdxady)) * std::fabs(cdz);
+    double bound = O3D_ERROR_BOUND * permanent;
+    if (det > bound || -det > bound)
+        return det;
+    return orient3dExact(a, b, c, d);
+}
+
+static double alongLineExact(const POINT& a, const POINT& b, const POINT& p, const POINT& q) {
+    Expansion x = multiply(difference(q.x, p.x), difference(b.x, a.x));
+    Expansion y = multiply(difference(q.y, p.y), difference(b.y, a.y));
+    Expansion z = multiply(difference(q.z, p.z), difference(b.z, a.z));
+    return add(add(x, y), z).sign();
+}
+
+double alongLine(const POINT& a, const POINT& b, const POINT& p, const POINT& q) {
+    double x = (double(q.x) - p.x) * (double(b.x) - a.x);
+    double y = (double(q.y) - p.y) * (double(b.y) - a.y);
+    double z = (double(q.z) - p.z) * (double(b.z) - a.z);
+    double dot = x + y + z;
+    double bound = DOT_ERROR_BOUND * (std::fabs(x) + std::fabs(y) + std::fabs(z));
+    if (dot > bound || -dot > bound)
+        return dot;
+    return alongLineExact(a, b, p, q);
+}
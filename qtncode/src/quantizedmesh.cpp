@@ -0,0 +1,224 @@
+#include "quantizedmesh.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+
+static uint64_t zigzag(int64_t v) { return (uint64_t(v) << 1) ^ uint64_t(v >> 63); }
+static int64_t unzigzag(uint64_t v) { return int64_t(v >> 1) ^ -int64_t(v & 1); }
+
+static void putVarint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(uint8_t(v) | 0x80);
+        v >>= 7;
+    }
+    out.push_back(uint8_t(v));
+}
+
+QuantizedMesh QuantizedMesh::encode(const IndexedMesh& mesh, int bits) {
+    QuantizedMesh q;
+    q.quantBits = bits == 21 ? 21 : 16;
+    q.vertices = mesh.vertices.size();
+    q.triangles = mesh.triangleCount();
+
+    AABB box;
+    for (const auto& v : mesh.vertices)
+        box.expand(v);
+    const uint32_t maxQ = (1u << q.quantBits) - 1;
+    if (!box.empty()) {
+        q.origin[0] = box.min.x;
+        q.origin[1] = box.min.y;
+        q.origin[2] = box.min.z;
+        q.step[0] = (box.max.x - box.min.x) / float(maxQ);
+        q.step[1] = (box.max.y - box.min.y) / float(maxQ);
+        q.step[2] = (box.max.z - box.min.z) / float(maxQ);
+    }
+
+    auto quantize = [&](float v, int axis) {
+        if (q.step[axis] <= 0.0f)
+            return uint32_t(0);
+        float t = std::round((v - q.origin[axis]) / q.step[axis]);
+        return uint32_t(std::min(std::max(t, 0.0f), float(maxQ)));
+    };
+    if (q.quantBits == 16) {
+        q.qx.resize(q.vertices);
+        q.qy.resize(q.vertices);
+        q.qz.resize(q.vertices);
+    } else {
+        q.packed.resize(q.vertices);
+    }
+    parallelFor(q.vertices, 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const POINT& v = mesh.vertices[i];
+            uint32_t x = quantize(v.x, 0), y = quantize(v.y, 1), z = quantize(v.z, 2);
+            if (q.quantBits == 16) {
+                q.qx[i] = uint16_t(x);
+                q.qy[i] = uint16_t(y);
+                q.qz[i] = uint16_t(z);
+            } else {
+                q.packed[i] = uint64_t(x) | (uint64_t(y) << 21) | (uint64_t(z) << 42);
+            }
+        }
+    });
+
+    // Delta-code the indices block by block, so every block decodes on its own
+    const size_t blocks = (q.triangles + BLOCK_TRIANGLES - 1) / BLOCK_TRIANGLES;
+    std::vector<std::vector<uint8_t>> streams(blocks);
+    parallelFor(blocks, 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            size_t first = 3 * b * BLOCK_TRIANGLES;
+            size_t last = 3 * std::min(q.triangles, (b + 1) * BLOCK_TRIANGLES);
+            int64_t previous = 0;
+            streams[b].reserve(last - first);
+            for (size_t i = first; i < last; ++i) {
+                putVarint(streams[b], zigzag(int64_t(mesh.indices[i]) - previous));
+                previous = mesh.indices[i];
+            }
+        }
+    });
+    q.blockOffsets.resize(blocks + 1, 0);
+    for (size_t b = 0; b < blocks; ++b)
+        q.blockOffsets[b + 1] = q.blockOffsets[b] + streams[b].size();
+    q.indexStream.resize(q.blockOffsets[blocks]);
+    for (size_t b = 0; b < blocks; ++b) {
+        std::copy(streams[b].begin(), streams[b].end(), q.indexStream.begin() + q.blockOffsets[b]);
+        std::vector<uint8_t>().swap(streams[b]);
+    }
+
+    // Block bounds come from the decoded triangles, so they enclose exactly
+    // what block() hands out
+    q.blockBounds.assign(blocks, AABB());
+    parallelFor(blocks, 1, [&](size_t begin, size_t end) {
+        std::vector<Triangle> decoded(BLOCK_TRIANGLES);
+        for (size_t b = begin; b < end; ++b) {
+            size_t n = std::min(q.triangles, (b + 1) * BLOCK_TRIANGLES) - b * BLOCK_TRIANGLES;
+            q.decodeBlock(b, decoded.data());
+            for (size_t i = 0; i < n; ++i)
+                q.blockBounds[b].expand(triangleBounds(decoded[i]));
+        }
+    });
+    for (const auto& bb : q.blockBounds)
+        q.meshBounds.expand(bb);
+    return q;
+}
+
+void QuantizedMesh::decodeVertices(size_t begin, size_t end, float* x, float* y, float* z) const {
+    const float ox = origin[0], oy = origin[1], oz = origin[2];
+    const float sx = step[0], sy = step[1], sz = step[2];
+    const size_t n = end - begin;
+    // Plain counted loops over unit-stride arrays; these vectorize
+    if (quantBits == 16) {
+        const uint16_t* px = qx.data() + begin;
+        const uint16_t* py = qy.data() + begin;
+        const uint16_t* pz = qz.data() + begin;
+        for (size_t i = 0; i < n; ++i) x[i] = ox + float(px[i]) * sx;
+        for (size_t i = 0; i < n; ++i) y[i] = oy + float(py[i]) * sy;
+        for (size_t i = 0; i < n; ++i) z[i] = oz + float(pz[i]) * sz;
+    } else {
+        const uint64_t* p = packed.data() + begin;
+        const uint64_t mask = (1u << 21) - 1;
+        for (size_t i = 0; i < n; ++i) {
+            x[i] = ox + float(uint32_t(p[i] & mask)) * sx;
+            y[i] = oy + float(uint32_t((p[i] >> 21) & mask)) * sy;
+            z[i] = oz + float(uint32_t((p[i] >> 42) & mask)) * sz;
+        }
+    }
+}
+
+POINT QuantizedMesh::vertex(size_t i) const {
+    float x, y, z;
+    decodeVertices(i, i + 1, &x, &y, &z);
+    return POINT(x, y, z);
+}
+
+void QuantizedMesh::decodeIndices(size_t b, std::vector<uint32_t>& out) const {
+    size_t n = std::min(triangles, (b + 1) * BLOCK_TRIANGLES) - b * BLOCK_TRIANGLES;
+    out.resize(3 * n);
+    const uint8_t* p = indexStream.data() + blockOffsets[b];
+    int64_t previous = 0;
+    for (size_t i = 0; i < 3 * n; ++i) {
+        uint64_t v = 0;
+        int shift = 0;
+        uint8_t byte;
+        do {
+            byte = *p++;
+            v |= uint64_t(byte & 0x7f) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        previous += unzigzag(v);
+        out[i] = uint32_t(previous);
+    }
+}
+
+// Writes the triangles of block b to out. Vertices are referenced mostly in
+// first-appearance order, so the block usually covers a compact index range
+// that is dequantized in one vectorized pass and then gathered.
+void QuantizedMesh::decodeBlock(size_t b, Triangle* out) const {
+    std::vector<uint32_t> idx;
+    decodeIndices(b, idx);
+    if (idx.empty())
+        return;
+    auto range = std::minmax_element(idx.begin(), idx.end());
+    const uint32_t lo = *range.first;
+    const size_t span = size_t(*range.second) - lo + 1;
+
+    if (span <= 2 * idx.size()) {
+        std::vector<float> x(span), y(span), z(span);
+        decodeVertices(lo, lo + span, x.data(), y.data(), z.data());
+        for (size_t t = 0; t < idx.size() / 3; ++t) {
+            const uint32_t* v = &idx[3 * t];
+            out[t] = Triangle(POINT(x[v[0] - lo], y[v[0] - lo], z[v[0] - lo]),
+                              POINT(x[v[1] - lo], y[v[1] - lo], z[v[1] - lo]),
+                              POINT(x[v[2] - lo], y[v[2] - lo], z[v[2] - lo]));
+        }
+    } else {
+        for (size_t t = 0; t < idx.size() / 3; ++t)
+            out[t] = Triangle(vertex(idx[3 * t]), vertex(idx[3 * t + 1]), vertex(idx[3 * t + 2]));
+    }
+}
+
+QuantizedMesh::Block QuantizedMesh::block(size_t b) {
+    if (Block held = decodedBlocks.find(b))
+        return held;
+    size_t n = std::min(triangles, (b + 1) * BLOCK_TRIANGLES) - b * BLOCK_TRIANGLES;
+    auto decoded = std::make_shared<std::vector<Triangle>>(n);
+    decodeBlock(b, decoded->data());
+    return decodedBlocks.insert(b, decoded);
+}
+
+bool QuantizedMesh::isResident(size_t b) const {
+    return decodedBlocks.contains(b) || triangles * sizeof(Triangle) <= decodedBlocks.budgetBytes();
+}
+
+std::vector<Triangle> QuantizedMesh::toTriangles() const {
+    std::vector<Triangle> result(triangles);
+    parallelFor(blockCount(), 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b)
+            decodeBlock(b, result.data() + b * BLOCK_TRIANGLES);
+    });
+    return result;
+}
+
+IndexedMesh QuantizedMesh::toIndexedMesh() const {
+    IndexedMesh mesh;
+    mesh.vertices.resize(vertices);
+    parallelFor(vertices, 1 << 16, [&](size_t begin, size_t end) {
+        std::vector<float> x(end - begin), y(end - begin), z(end - begin);
+        decodeVertices(begin, end, x.data(), y.data(), z.data());
+        for (size_t i = begin; i < end; ++i)
+            mesh.vertices[i] = POINT(x[i - begin], y[i - begin], z[i - begin]);
+    });
+    mesh.indices.resize(3 * triangles);
+    parallelFor(blockCount(), 1, [&](size_t begin, size_t end) {
+        std::vector<uint32_t> idx;
+        for (size_t b = begin; b < end; ++b) {
+            decodeIndices(b, idx);
+            std::copy(idx.begin(), idx.end(), mesh.indices.begin() + 3 * b * BLOCK_TRIANGLES);
+        }
+    });
+    return mesh;
+}
+
+size_t QuantizedMesh::memoryBytes() const {
+    return (qx.size() + qy.size() + qz.size()) * sizeof(uint16_t) + packed.size() * sizeof(uint64_t) +
+           indexStream.size() + blockOffsets.size() * sizeof(size_t) + blockBounds.size() * sizeof(AABB);
+}
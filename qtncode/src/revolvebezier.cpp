@@ -5,8 +5,14 @@
 #include <QMatrix4x4>
 #include <QtMath>
 #include <QDebug>
+#include <QFileDialog>
+#include <QMessageBox>
+#include "meshexport.h"
  
 BezierWidget::BezierWidget(QWidget *parent) : QOpenGLWidget(parent) {
+    exportButton = new QPushButton("Export Mesh", this);
+    exportButton->move(10, 10);
+    connect(exportButton, &QPushButton::clicked, this, &BezierWidget::exportRevolution);
 }
  
 void BezierWidget::initializeGL() {
@@ -173,4 +179,37 @@ void BezierWidget::drawRevolutionAxis() {
     glVertex3f(0.0f, -500.0f, 0.5f);
     glVertex3f(0.0f, 500.0f, 0.5f);
     glEnd();
-}
\ No newline at end of file
+}
+
+std::vector<Triangle> BezierWidget::revolutionTriangles() const {
+    std::vector<Triangle> triangles;
+    if (revolutionMesh.size() < 2)
+        return triangles;
+    triangles.reserve(size_t(revolutionMesh.size() - 1) * size_t(revolutionMesh[0].size()) * 2);
+    auto toPOINT = [](const QVector3D &v) { return POINT(v.x(), v.y(), v.z()); };
+    for (int i = 0; i < revolutionMesh.size() - 1; ++i) {
+        for (int j = 0; j < revolutionMesh[i].size() - 1; ++j) {
+            POINT a = toPOINT(revolutionMesh[i][j]);
+            POINT b = toPOINT(revolutionMesh[i + 1][j]);
+            POINT c = toPOINT(revolutionMesh[i + 1][j + 1]);
+            POINT d = toPOINT(revolutionMesh[i][j + 1]);
+            triangles.emplace_back(a, b, c);
+            triangles.emplace_back(a, c, d);
+        }
+    }
+    return triangles;
+}
+
+//Writes the surface of revolution as binary STL or PLY (picked by extension).
+void BezierWidget::exportRevolution() {
+    std::vector<Triangle> triangles = revolutionTriangles();
+    if (triangles.empty()) {
+        QMessageBox::information(this, "Export Mesh", "Revolve a curve first (drag a control point with the right button).");
+        return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(this, "Export Mesh", "", "Binary STL (*.stl);;Binary PLY (*.ply)");
+    if (fileName.isEmpty())
+        return;
+    if (!exportTriangles(fileName.toStdString(), triangles))
+        QMessageBox::warning(this, "Export Mesh", "Failed to write " + fileName);
+}
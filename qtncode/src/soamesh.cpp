@@ -0,0 +1,78 @@
+#include "soamesh.h"
+#include "parallel.h"
+#include <algorithm>
+
+void TriangleSoA::clear() {
+    for (int k = 0; k < 3; ++k) {
+        x[k].clear();
+        y[k].clear();
+        z[k].clear();
+    }
+    for (auto* a : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ, &nx, &ny, &nz, &d })
+        a->clear();
+}
+
+void TriangleSoA::build(const std::vector<Triangle>& triangles) {
+    const size_t n = triangles.size();
+    for (int k = 0; k < 3; ++k) {
+        x[k].resize(n);
+        y[k].resize(n);
+        z[k].resize(n);
+    }
+    for (auto* a : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ, &nx, &ny, &nz, &d })
+        a->resize(n);
+
+    // Scatter the corners first, then derive bounds and planes with dense loops
+    parallelFor(n, 1 << 15, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const Triangle& t = triangles[i];
+            x[0][i] = t.p1.x; y[0][i] = t.p1.y; z[0][i] = t.p1.z;
+            x[1][i] = t.p2.x; y[1][i] = t.p2.y; z[1][i] = t.p2.z;
+            x[2][i] = t.p3.x; y[2][i] = t.p3.y; z[2][i] = t.p3.z;
+        }
+
+        const float* x0 = x[0].data(); const float* x1 = x[1].data(); const float* x2 = x[2].data();
+        const float* y0 = y[0].data(); const float* y1 = y[1].data(); const float* y2 = y[2].data();
+        const float* z0 = z[0].data(); const float* z1 = z[1].data(); const float* z2 = z[2].data();
+        for (size_t i = begin; i < end; ++i) {
+            minX[i] = std::min(x0[i], std::min(x1[i], x2[i]));
+            minY[i] = std::min(y0[i], std::min(y1[i], y2[i]));
+            minZ[i] = std::min(z0[i], std::min(z1[i], z2[i]));
+            maxX[i] = std::max(x0[i], std::max(x1[i], x2[i]));
+            maxY[i] = std::max(y0[i], std::max(y1[i], y2[i]));
+            maxZ[i] = std::max(z0[i], std::max(z1[i], z2[i]));
+        }
+        for (size_t i = begin; i < end; ++i) {
+            float ux = x1[i] - x0[i], uy = y1[i] - y0[i], uz = z1[i] - z0[i];
+            float vx = x2[i] - x0[i], vy = y2[i] - y0[i], vz = z2[i] - z0[i];
+            float a = uy * vz - uz * vy;
+            float b = uz * vx - ux * vz;
+            float c = ux * vy - uy * vx;
+            nx[i] = a;
+            ny[i] = b;
+            nz[i] = c;
+            d[i] = -(a * x0[i] + b * y0[i] + c * z0[i]);
+        }
+    });
+}
+
+void TriangleSoA::overlapping(const AABB& box, std::vector<uint32_t>& out) const {
+    const size_t n = size();
+    const float* lx = minX.data(); const float* ly = minY.data(); const float* lz = minZ.data();
+    const float* hx = maxX.data(); const float* hy = maxY.data(); const float* hz = maxZ.data();
+    // Branch-free overlap mask per block, so the compare loop vectorizes
+    const size_t block = 64;
+    unsigned char hit[block];
+    for (size_t base = 0; base < n; base += block) {
+        size_t count = std::min(block, n - base);
+        for (size_t j = 0; j < count; ++j) {
+            size_t i = base + j;
+            hit[j] = (lx[i] <= box.max.x) & (hx[i] >= box.min.x) &
+                     (ly[i] <= box.max.y) & (hy[i] >= box.min.y) &
+                     (lz[i] <= box.max.z) & (hz[i] >= box.min.z);
+        }
+        for (size_t j = 0; j < count; ++j)
+            if (hit[j])
+                out.push_back(uint32_t(base + j));
+    }
+}
@@ -0,0 +1,92 @@
+#include "spatialhash.h"
+#include "parallel.h"
+
+static float largestExtent(const AABB& box) {
+    return std::max(box.max.x - box.min.x, std::max(box.max.y - box.min.y, box.max.z - box.min.z));
+}
+
+void UniformGrid::build(const std::vector<Triangle>& a, const std::vector<Triangle>& b, float cellSize) {
+    entries.clear();
+    boxesA.resize(a.size());
+    boxesB.resize(b.size());
+    parallelFor(a.size(), 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            boxesA[i] = triangleBounds(a[i]);
+    });
+    parallelFor(b.size(), 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            boxesB[i] = triangleBounds(b[i]);
+    });
+
+    AABB boundsA, boundsB;
+    for (const AABB& box : boxesA)
+        boundsA.expand(box);
+    for (const AABB& box : boxesB)
+        boundsB.expand(box);
+    domain = AABB();
+    cell = inverseCell = 0.0f;
+    if (boundsA.empty() || boundsB.empty() || !boundsA.overlaps(boundsB))
+        return;
+    domain.min = POINT(std::max(boundsA.min.x, boundsB.min.x), std::max(boundsA.min.y, boundsB.min.y),
+                       std::max(boundsA.min.z, boundsB.min.z));
+    domain.max = POINT(std::min(boundsA.max.x, boundsB.max.x), std::min(boundsA.max.y, boundsB.max.y),
+                       std::min(boundsA.max.z, boundsB.max.z));
+
+    // Cells about the size of a typical triangle keep both the entries per
+    // triangle and the triangles per cell small
+    cell = cellSize;
+    if (cell <= 0.0f) {
+        double sum = 0.0;
+        size_t n = 0;
+        for (const auto* boxes : { &boxesA, &boxesB })
+            for (const AABB& box : *boxes)
+                if (box.overlaps(domain)) {
+                    sum += largestExtent(box);
+                    ++n;
+                }
+        cell = n ? float(sum / double(n)) : 0.0f;
+    }
+    cell = std::max(cell, largestExtent(domain) / float(MAX_CELLS_PER_AXIS - 1));
+    if (!(cell > 0.0f))
+        cell = 1.0f; // Every triangle degenerate to the same point
+    inverseCell = 1.0f / cell;
+
+    // Count the cells each triangle touches, then fill the entries in place
+    const size_t total = a.size() + b.size();
+    auto boxOf = [&](size_t t) -> const AABB& { return t < a.size() ? boxesA[t] : boxesB[t - a.size()]; };
+    std::vector<uint64_t> offsets(total + 1, 0);
+    parallelFor(total, 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            const AABB& box = boxOf(t);
+            if (!box.overlaps(domain))
+                continue;
+            uint64_t cells = 1;
+            for (int axis = 0; axis < 3; ++axis) {
+                float lo = axis == 0 ? box.min.x : (axis == 1 ? box.min.y : box.min.z);
+                float hi = axis == 0 ? box.max.x : (axis == 1 ? box.max.y : box.max.z);
+                cells *= cellCoordinate(hi, axis) - cellCoordinate(lo, axis) + 1;
+            }
+            offsets[t + 1] = cells;
+        }
+    });
+    for (size_t t = 0; t < total; ++t)
+        offsets[t + 1] += offsets[t];
+    entries.resize(size_t(offsets[total]));
+
+    parallelFor(total, 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            if (offsets[t] == offsets[t + 1])
+                continue;
+            const AABB& box = boxOf(t);
+            uint32_t index = t < a.size() ? uint32_t(t) : (uint32_t(t - a.size()) | MESH_B);
+            uint64_t lo = cellKey(box.min), hi = cellKey(box.max);
+            const uint64_t mask = MAX_CELLS_PER_AXIS - 1;
+            Entry* out = entries.data() + offsets[t];
+            for (uint64_t z = lo >> 42; z <= hi >> 42; ++z)
+                for (uint64_t y = (lo >> 21) & mask; y <= ((hi >> 21) & mask); ++y)
+                    for (uint64_t x = lo & mask; x <= (hi & mask); ++x)
+                        *out++ = { x | y << 21 | z << 42, index };
+        }
+    });
+    std::sort(entries.begin(), entries.end());
+}
@@ -0,0 +1,234 @@
+#include "stlimporter.h"
+#include "stlparser.h"
+#include "meshimport.h"
+#include "meshcache.h"
+#include "outofcore.h"
+#include "quantizedmesh.h"
+#include "morton.h"
+#include <QFileInfo>
+#include <QThread>
+#include <algorithm>
+#include <filesystem>
+
+// A cache to write once the mesh has been handed over
+struct PendingCache
+{
+    std::string path;
+    uint64_t sourceSize = 0;
+    bool needed = false;
+    bool indexed = false;            // OBJ/PLY input: write `mesh` as it is
+    IndexedMesh mesh;
+    std::vector<Triangle> triangles; // STL input: welded when written
+
+    bool write(const STLLoadControl &control) const
+    {
+        if (!needed || control.cancelled())
+            return false;
+        return indexed ? writeMeshCache(path, mesh, sourceSize, &control)
+                       : writeMeshCache(path, triangles, sourceSize, &control);
+    }
+};
+
+// Reuses a fresh cache when there is one, otherwise parses the file and
+// leaves what the cache needs in `pending`, so the caller can write it after
+// handing the mesh over. With `indexed` set the mesh is handed back there
+// instead of as a soup. OBJ and PLY files keep their own index buffer and
+// are never welded. A soup read from the cache comes with the cache's BVH
+// in `tree`.
+static bool loadFile(const std::string &path, const STLLoadControl &control,
+                     std::vector<Triangle> &triangles, IndexedMesh *indexed,
+                     std::shared_ptr<const BVH> *tree, PendingCache &pending)
+{
+    const std::string cachePath = meshCachePath(path);
+    if (meshCacheIsFresh(path, cachePath))
+    {
+        MeshCache cache;
+        if (cache.open(cachePath))
+        {
+            if (indexed)
+            {
+                *indexed = cache.toIndexedMesh();
+            }
+            else
+            {
+                triangles = cache.toTriangles();
+                if (tree && cache.bvhNodeCount() > 0 && cache.bvhPrimitiveCount() == cache.triangleCount())
+                    *tree = std::make_shared<const BVH>(cache.toBVH());
+            }
+            control.report(1.0f);
+            return true;
+        }
+    }
+
+    std::error_code ec;
+    pending.path = cachePath;
+    pending.sourceSize = std::filesystem::file_size(path, ec);
+    pending.needed = !ec; // Best effort; the import itself does not depend on it
+    if (isIndexedMeshFile(path))
+    {
+        IndexedMesh mesh;
+        if (!loadIndexedMeshFile(path, mesh, &control))
+            return false;
+        if (indexed)
+            *indexed = mesh;
+        else
+            triangles = mesh.toTriangles();
+        pending.indexed = true;
+        pending.mesh = std::move(mesh);
+        return true;
+    }
+
+    if (!loadSTLFile(path, triangles, &control))
+        return false;
+    if (indexed)
+    {
+        *indexed = weldVertices(triangles);
+        pending.triangles = std::move(triangles);
+        triangles = std::vector<Triangle>();
+    }
+    else if (pending.needed)
+    {
+        pending.triangles = triangles;
+    }
+    return true;
+}
+
+STLImporter::STLImporter(QObject *parent)
+    : QObject(parent)
+{
+    // Each parse already spreads over several cores, so run fewer files at
+    // once than there are cores
+    pool.setMaxThreadCount(std::max(2, QThread::idealThreadCount() / 2));
+}
+
+STLImporter::~STLImporter()
+{
+    cancel();
+    pool.waitForDone();
+}
+
+bool STLImporter::start(const QStringList &fileNames, Storage storage)
+{
+    if (isRunning() || fileNames.isEmpty())
+        return false;
+
+    jobs = std::vector<Job>(size_t(fileNames.size()));
+    for (int i = 0; i < fileNames.size(); ++i)
+        jobs[i].fileName = fileNames[i];
+    remaining = int(jobs.size());
+    loaded = 0;
+    cancelRequested = false;
+    lastPercent = -1;
+
+    const bool reorder = spatialReorder;
+    for (int i = 0; i < int(jobs.size()); ++i)
+        pool.start([this, i, storage, reorder]() { runJob(i, storage, reorder); });
+    return true;
+}
+
+// Pool-thread side of start(): loads one file into a MeshEntry
+void STLImporter::runJob(int job, Storage storage, bool reorder)
+{
+    Job &j = jobs[job];
+    const std::string path = j.fileName.toStdString();
+    STLLoadControl control;
+    control.cancel = &cancelRequested;
+    control.progress = [this, &j](float fraction)
+    {
+        j.permille = int(fraction * 1000.0f);
+        reportProgress();
+    };
+
+    auto mesh = std::make_unique<MeshEntry>();
+    mesh->name = QFileInfo(j.fileName).fileName().toStdString();
+    PendingCache cache;
+    bool ok = false;
+    if (storage == OutOfCore)
+    {
+        auto blocked = std::make_unique<OutOfCoreMesh>();
+        ok = blocked->open(path, &control);
+        mesh->blocked = std::move(blocked);
+    }
+    else if (storage == InMemory)
+    {
+        ok = loadFile(path, control, mesh->triangles, nullptr, &mesh->bvh, cache);
+        if (ok && reorder && !control.cancelled())
+        {
+            reorderMorton(mesh->triangles);
+            mesh->bvh.reset(); // Its primitive numbers follow the old order
+        }
+    }
+    else
+    {
+        // Leave the last fifth of the bar for welding and encoding
+        STLLoadControl loadControl = control;
+        loadControl.progress = [&control](float fraction) { control.report(0.8f * fraction); };
+        IndexedMesh indexed;
+        ok = loadFile(path, loadControl, mesh->triangles, &indexed, nullptr, cache) && !control.cancelled();
+        if (ok)
+        {
+            if (reorder)
+                reorderMorton(indexed);
+            control.report(0.9f);
+            mesh->blocked = std::make_unique<QuantizedMesh>(
+                QuantizedMesh::encode(indexed, storage == Compact21 ? 21 : 16));
+        }
+    }
+
+    const bool loaded = ok && !control.cancelled();
+    j.ok = loaded;
+    if (loaded)
+        j.mesh = std::move(mesh);
+    j.permille = 1000;
+    reportProgress();
+    QMetaObject::invokeMethod(this, [this, job]() { jobDone(job); }, Qt::QueuedConnection);
+
+    // The mesh is already out, and a new batch may reuse `jobs`; only the
+    // cancel flag is shared with it (and the destructor cancels and waits)
+    if (loaded)
+    {
+        STLLoadControl cacheControl;
+        cacheControl.cancel = &cancelRequested;
+        cache.write(cacheControl);
+    }
+}
+
+// Runs on the GUI thread once a job has returned
+void STLImporter::jobDone(int job)
+{
+    --remaining;
+    if (jobs[job].ok)
+        ++loaded;
+    emit meshLoaded(job, jobs[job].ok);
+    if (remaining == 0)
+        emit finished(loaded, cancelRequested.load());
+}
+
+// Parser workers of every job report often; only forward whole-percent
+// steps of the batch average
+void STLImporter::reportProgress()
+{
+    long total = 0;
+    for (const Job &j : jobs)
+        total += j.permille.load(std::memory_order_relaxed);
+    int percent = int(total / (10 * long(jobs.size())));
+    int previous = lastPercent.load();
+    while (percent > previous)
+    {
+        if (lastPercent.compare_exchange_weak(previous, percent))
+        {
+            emit progressChanged(percent);
+            break;
+        }
+    }
+}
+
+void STLImporter::cancel()
+{
+    cancelRequested = true;
+}
+
+std::unique_ptr<MeshEntry> STLImporter::takeMesh(int job)
+{
+    return std::move(jobs[job].mesh);
+}
@@ -1,36 +1,310 @@
 #include "stlparser.h"
-#include <fstream>
-#include <sstream>
+#include "mappedfile.h"
+#include "gzipreader.h"
+#include "tokenizer.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cctype>
 #include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
 
-bool loadSTLFile(const std::string& filename, std::vector<Triangle>& triangles) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error: Cannot open file " << filename << "\n";
+static const size_t STL_HEADER_SIZE = 80;
+static const size_t STL_PREAMBLE_SIZE = STL_HEADER_SIZE + sizeof(uint32_t);
+static const size_t STL_FACET_SIZE = 50;
+// Facets decoded between two progress/cancellation checks
+static const size_t STL_PROGRESS_FACETS = 1 << 16;
+// Streamed ASCII text collected before a batch is handed to loadAsciiSTL
+static const size_t STL_STREAM_BATCH = 8 << 20;
+
+// A facet record stores the normal first, then the three vertices we keep
+static_assert(sizeof(Triangle) == 9 * sizeof(float) && std::is_trivially_copyable<Triangle>::value,
+              "Triangle must match the vertex block of a binary STL facet");
+
+static uint32_t readFacetCount(const char* data) {
+    uint32_t count;
+    std::memcpy(&count, data + STL_HEADER_SIZE, sizeof(count));
+    return count;
+}
+
+bool isBinarySTL(const char* data, size_t size) {
+    if (size < STL_PREAMBLE_SIZE)
+        return false;
+    uint64_t expected = STL_PREAMBLE_SIZE + uint64_t(readFacetCount(data)) * STL_FACET_SIZE;
+    // Exact size match is decisive, even when the header starts with "solid"
+    // (several exporters write that into binary headers too).
+    if (expected == size)
+        return true;
+    // Some tools pad the file; accept that only if it cannot be ASCII.
+    bool asciiHeader = size >= 5 && std::memcmp(data, "solid", 5) == 0;
+    return !asciiHeader && expected < size;
+}
+
+bool loadBinarySTL(const char* data, size_t size, std::vector<Triangle>& triangles,
+                   const STLLoadControl* control) {
+    if (size < STL_PREAMBLE_SIZE)
         return false;
+    uint64_t count = readFacetCount(data);
+    if (STL_PREAMBLE_SIZE + count * STL_FACET_SIZE > size) {
+        std::cerr << "Error: Binary STL is truncated\n";
+        return false;
+    }
+
+    size_t first = triangles.size();
+    triangles.resize(first + count);
+    const char* record = data + STL_PREAMBLE_SIZE;
+    Triangle* out = triangles.data() + first;
+    for (uint64_t begin = 0; begin < count; begin += STL_PROGRESS_FACETS) {
+        if (control && control->cancelled()) {
+            triangles.resize(first);
+            return false;
+        }
+        uint64_t end = std::min<uint64_t>(count, begin + STL_PROGRESS_FACETS);
+        for (uint64_t i = begin; i < end; ++i, record += STL_FACET_SIZE) {
+            // Skip the 12-byte facet normal; the 36 vertex bytes map onto Triangle
+            std::memcpy(&out[i], record + 3 * sizeof(float), sizeof(Triangle));
+        }
+        if (control)
+            control->report(float(end) / float(count));
     }
+    return true;
+}
 
-    std::string line;
-    POINT v[3];
+// Returns the position just past the next "endfacet" at or after p, so that
+// chunks starting there never split a facet.
+static const char* nextFacetBoundary(const char* p, const char* end) {
+    static const char key[] = "endfacet";
+    const size_t keyLen = sizeof(key) - 1;
+    const char* hit = std::search(p, end, key, key + keyLen);
+    return hit == end ? end : hit + keyLen;
+}
+
+// Tokenizes one chunk of an ASCII STL and appends its facets to out.
+// Only "vertex" tokens matter; every third vertex closes a triangle.
+// Consumed bytes are added to `done` every STL_PROGRESS_FACETS facets.
+static bool parseAsciiChunk(const char* p, const char* end, std::vector<Triangle>& out,
+                            const STLLoadControl* control, std::atomic<size_t>& done, size_t total) {
+    Tokenizer tok(p, end);
+    float c[9];
     int vertexCount = 0;
+    const char* reported = p;
+    while (true) {
+        std::string_view token = tok.token();
+        if (token.empty())
+            break;
+        if (token != "vertex")
+            continue;
+
+        for (int k = 0; k < 3; ++k) {
+            tok.skipSpace();
+            if (!tok.number(c[vertexCount * 3 + k]))
+                return false;
+        }
+        if (++vertexCount == 3) {
+            out.emplace_back(POINT(c[0], c[1], c[2]), POINT(c[3], c[4], c[5]), POINT(c[6], c[7], c[8]));
+            vertexCount = 0;
+            if (control && out.size() % STL_PROGRESS_FACETS == 0) {
+                if (control->cancelled())
+                    return false;
+                size_t now = done.fetch_add(size_t(tok.position() - reported)) + size_t(tok.position() - reported);
+                reported = tok.position();
+                control->report(float(now) / float(total));
+            }
+        }
+    }
+    done.fetch_add(size_t(end - reported));
+    return true;
+}
 
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string word;
-        iss >> word;
+bool loadAsciiSTL(const char* data, size_t size, std::vector<Triangle>& triangles,
+                  const STLLoadControl* control) {
+    const char* end = data + size;
+    // One chunk per worker, but never less than 1 MB per chunk
+    size_t chunks = std::min<size_t>(workerCount(), std::max<size_t>(size >> 20, 1));
 
-        if (word == "vertex") {
-            float x, y, z;
-            iss >> x >> y >> z;
-            v[vertexCount++] = POINT(x, y, z);
+    std::vector<const char*> bounds(chunks + 1);
+    bounds[0] = data;
+    for (size_t i = 1; i < chunks; ++i)
+        bounds[i] = std::max(bounds[i - 1], nextFacetBoundary(data + i * (size / chunks), end));
+    bounds[chunks] = end;
 
-            if (vertexCount == 3) {
-                triangles.emplace_back(v[0], v[1], v[2]);
-                vertexCount = 0;
+    std::vector<std::vector<Triangle>> parts(chunks);
+    std::vector<char> ok(chunks, 0);
+    std::atomic<size_t> done(0);
+    parallelChunks(chunks, [&](size_t i) {
+        // Roughly 250 bytes of text per facet in typical exports
+        parts[i].reserve(size_t(bounds[i + 1] - bounds[i]) / 250 + 1);
+        ok[i] = parseAsciiChunk(bounds[i], bounds[i + 1], parts[i], control, done, size);
+    });
+
+    if (control && control->cancelled())
+        return false;
+
+    size_t total = 0;
+    for (size_t i = 0; i < chunks; ++i) {
+        if (!ok[i]) {
+            std::cerr << "Error: Malformed vertex in ASCII STL\n";
+            return false;
+        }
+        total += parts[i].size();
+    }
+
+    triangles.reserve(triangles.size() + total);
+    for (const auto& part : parts)
+        triangles.insert(triangles.end(), part.begin(), part.end());
+    if (control)
+        control->report(1.0f);
+    return true;
+}
+
+// Decodes a whole STL image. A padded binary file whose header starts with
+// "solid" looks like ASCII to isBinarySTL(); when the ASCII parse finds no
+// facet in it and the binary layout fits, the facet records are read instead.
+static bool loadSTLData(const char* data, size_t size, std::vector<Triangle>& triangles,
+                        const STLLoadControl* control) {
+    if (isBinarySTL(data, size))
+        return loadBinarySTL(data, size, triangles, control);
+    const size_t first = triangles.size();
+    bool ascii = loadAsciiSTL(data, size, triangles, control);
+    if ((ascii && triangles.size() > first) || (control && control->cancelled()))
+        return ascii;
+    bool binaryFits = size >= STL_PREAMBLE_SIZE && readFacetCount(data) > 0 &&
+                      STL_PREAMBLE_SIZE + uint64_t(readFacetCount(data)) * STL_FACET_SIZE <= size;
+    if (!binaryFits)
+        return ascii; // An ASCII solid without facets, or malformed text
+    return loadBinarySTL(data, size, triangles, control);
+}
+
+// Binary facet records arriving in arbitrary pieces; a record split across
+// two chunks is completed from `partial`.
+static void decodeBinaryStream(const char* p, const char* end, std::vector<char>& partial,
+                               std::vector<Triangle>& triangles) {
+    if (!partial.empty()) {
+        size_t take = std::min<size_t>(STL_FACET_SIZE - partial.size(), size_t(end - p));
+        partial.insert(partial.end(), p, p + take);
+        p += take;
+        if (partial.size() < STL_FACET_SIZE)
+            return;
+        triangles.emplace_back();
+        std::memcpy(&triangles.back(), partial.data() + 3 * sizeof(float), sizeof(Triangle));
+        partial.clear();
+    }
+    size_t records = size_t(end - p) / STL_FACET_SIZE;
+    size_t first = triangles.size();
+    triangles.resize(first + records);
+    for (size_t i = 0; i < records; ++i, p += STL_FACET_SIZE)
+        std::memcpy(&triangles[first + i], p + 3 * sizeof(float), sizeof(Triangle));
+    partial.assign(p, end);
+}
+
+// Parses everything up to the last complete facet of `text` and keeps the rest
+static bool parseAsciiBatch(std::vector<char>& text, bool last, std::vector<Triangle>& triangles,
+                            const STLLoadControl& batchControl) {
+    static const char key[] = "endfacet";
+    size_t cut = text.size();
+    if (!last) {
+        auto hit = std::find_end(text.begin(), text.end(), key, key + sizeof(key) - 1);
+        if (hit == text.end())
+            return true; // No complete facet yet
+        cut = size_t(hit - text.begin()) + sizeof(key) - 1;
+    }
+    if (!loadAsciiSTL(text.data(), cut, triangles, &batchControl))
+        return false;
+    text.erase(text.begin(), text.begin() + cut);
+    return true;
+}
+
+bool loadGzipSTL(const std::string& filename, std::vector<Triangle>& triangles,
+                 const STLLoadControl* control) {
+    GzipReader reader;
+    if (!reader.open(filename))
+        return false;
+
+    // Batches only honour cancellation; progress follows the compressed input
+    STLLoadControl batchControl;
+    if (control)
+        batchControl.cancel = control->cancel;
+
+    const size_t first = triangles.size();
+    std::vector<char> chunk, pending;
+    enum { Detecting, Binary, Ascii } format = Detecting;
+    uint64_t expected = 0;
+    bool ok = true;
+    while (ok && reader.read(chunk)) {
+        if (control) {
+            if (control->cancelled()) {
+                ok = false;
+                break;
             }
+            control->report(reader.progress());
         }
+
+        if (format == Binary) {
+            decodeBinaryStream(chunk.data(), chunk.data() + chunk.size(), pending, triangles);
+            continue;
+        }
+        pending.insert(pending.end(), chunk.begin(), chunk.end());
+        if (format == Detecting) {
+            // Decide once the header plus some payload is in. Binary facets are
+            // float bytes, so text that starts with "solid" and stays printable
+            // is ASCII.
+            const size_t probe = 512;
+            if (pending.size() < probe)
+                continue;
+            bool ascii = std::memcmp(pending.data(), "solid", 5) == 0 &&
+                         std::all_of(pending.begin(), pending.begin() + probe, [](char c) {
+                             return std::isprint(static_cast<unsigned char>(c)) || Tokenizer::isSpace(c);
+                         });
+            if (!ascii) {
+                format = Binary;
+                expected = readFacetCount(pending.data());
+                triangles.reserve(first + std::min<uint64_t>(expected, 1u << 26));
+                std::vector<char> body(pending.begin() + STL_PREAMBLE_SIZE, pending.end());
+                pending.clear();
+                decodeBinaryStream(body.data(), body.data() + body.size(), pending, triangles);
+                continue;
+            }
+            format = Ascii;
+        }
+        if (pending.size() >= STL_STREAM_BATCH)
+            ok = parseAsciiBatch(pending, false, triangles, batchControl);
     }
+    reader.stop();
 
-    file.close();
+    if (ok && (reader.failed() || (control && control->cancelled())))
+        ok = false;
+    if (ok && format == Detecting) {
+        // Short file: whole content is in `pending`
+        ok = loadSTLData(pending.data(), pending.size(), triangles, &batchControl);
+    } else if (ok && format == Ascii) {
+        ok = parseAsciiBatch(pending, true, triangles, batchControl);
+    } else if (ok && format == Binary && triangles.size() - first < expected) {
+        std::cerr << "Error: Binary STL is truncated\n";
+        ok = false;
+    } else if (ok && format == Binary) {
+        triangles.resize(first + expected); // Ignore trailing padding
+    }
+
+    if (!ok) {
+        triangles.resize(first);
+        return false;
+    }
+    if (control)
+        control->report(1.0f);
     return true;
 }
+
+bool loadSTLFile(const std::string& filename, std::vector<Triangle>& triangles,
+                 const STLLoadControl* control) {
+    if (filename.size() > 3 && filename.compare(filename.size() - 3, 3, ".gz") == 0)
+        return loadGzipSTL(filename, triangles, control);
+
+    MappedFile file(filename);
+    if (!file.isOpen()) {
+        std::cerr << "Error: Cannot open file " << filename << "\n";
+        return false;
+    }
+
+    return loadSTLData(file.data(), file.size(), triangles, control);
+}
@@ -1,17 +1,52 @@
 #include "STLWidget.h"
 #include "intersection.h"
+#include "blockedmesh.h"
+#include "meshset.h"
 #include <QOpenGLFunctions>
 #include <QOpenGLWidget>
 #include <QColor>
-#include <QDebug>
+#include <QtMath>
  
+// Resident blocks are drawn as triangles, paged-out blocks as their bounding boxes
+static void drawBlocked(BlockedMesh& mesh)
+{
+    for (size_t b = 0; b < mesh.blockCount(); ++b) {
+        if (mesh.isResident(b)) {
+            BlockedMesh::Block block = mesh.block(b);
+            for (const auto& tri : *block) {
+                glBegin(GL_LINE_LOOP);
+                glVertex3f(tri.p1.x, tri.p1.y, tri.p1.z);
+                glVertex3f(tri.p2.x, tri.p2.y, tri.p2.z);
+                glVertex3f(tri.p3.x, tri.p3.y, tri.p3.z);
+                glEnd();
+            }
+            continue;
+        }
+        const AABB& box = mesh.blockBound(b);
+        const float xs[2] = { box.min.x, box.max.x };
+        const float ys[2] = { box.min.y, box.max.y };
+        const float zs[2] = { box.min.z, box.max.z };
+        glBegin(GL_LINES);
+        for (int i = 0; i < 2; ++i)
+            for (int j = 0; j < 2; ++j) {
+                glVertex3f(xs[0], ys[i], zs[j]); glVertex3f(xs[1], ys[i], zs[j]);
+                glVertex3f(xs[i], ys[0], zs[j]); glVertex3f(xs[i], ys[1], zs[j]);
+                glVertex3f(xs[i], ys[j], zs[0]); glVertex3f(xs[i], ys[j], zs[1]);
+            }
+        glEnd();
+    }
+}
+
 STLWidget::STLWidget(QWidget *parent)
     : QOpenGLWidget(parent)
 {
+    intersectionPool.setMaxThreadCount(1);
 }
  
 STLWidget::~STLWidget()
 {
+    // The running computation uses rigidIntersection; its result is dropped
+    intersectionPool.waitForDone();
 }
  
 void STLWidget::initializeGL()
@@ -41,121 +76,215 @@ void STLWidget::paintGL()
     QMatrix4x4 mvp = projection * view * model;
     glLoadMatrixf(mvp.constData());
  
-    glColor3f(0.2f, 0.8f, 0.0f);
-    for (const auto& tri : trianglesA) {
-        glBegin(GL_LINE_LOOP);
-        glVertex3f(tri.p1.x, tri.p1.y, tri.p1.z);
-        glVertex3f(tri.p2.x, tri.p2.y, tri.p2.z);
-        glVertex3f(tri.p3.x, tri.p3.y, tri.p3.z);
-        glEnd();
-    }
- 
-
-    glColor3f(0.0f, 0.2f, 0.9f);
-    for (const auto& tri : trianglesB) {
-        glBegin(GL_LINE_LOOP);
-        glVertex3f(tri.p1.x, tri.p1.y, tri.p1.z);
-        glVertex3f(tri.p2.x, tri.p2.y, tri.p2.z);
-        glVertex3f(tri.p3.x, tri.p3.y, tri.p3.z);
-        glEnd();
-    }
-
- 
-    // For each pair of triangles, handle coplanar and non-coplanar cases
-    std::vector<std::pair<POINT, POINT>> intersectionSegments;
-    for (const auto& triA : trianglesA) {
-        for (const auto& triB : trianglesB) {
-            if (trianglesCoplanar(triA, triB)) {
-                // Coplanar: collect intersection points along edges
-                auto pointInTriangle = [](const POINT& p, const Triangle& t) {
-                    float x = p.x, y = p.y;
-                    float x1 = t.p1.x, y1 = t.p1.y;
-                    float x2 = t.p2.x, y2 = t.p2.y;
-                    float x3 = t.p3.x, y3 = t.p3.y;
-                    float denom = (y2 - y3)*(x1 - x3) + (x3 - x2)*(y1 - y3);
-                    float a = ((y2 - y3)*(x - x3) + (x3 - x2)*(y - y3)) / denom;
-                    float b = ((y3 - y1)*(x - x3) + (x1 - x3)*(y - y3)) / denom;
-                    float c = 1.0f - a - b;
-                    return a >= 0 && b >= 0 && c >= 0 && a <= 1 && b <= 1 && c <= 1;
-                };
-                float step = 0.01f;
-                // For each edge of triA, check if inside triB
-                const POINT* ptsA[3] = { &triA.p1, &triA.p2, &triA.p3 };
-                for (int i = 0; i < 3; ++i) {
-                    const POINT& p0 = *ptsA[i];
-                    const POINT& p1 = *ptsA[(i+1)%3];
-                    std::vector<POINT> segment;
-                    for (float t = 0; t <= 1.0f; t += step) {
-                        float x = p0.x + t * (p1.x - p0.x);
-                        float y = p0.y + t * (p1.y - p0.y);
-                        POINT pt(x, y, 0);
-                        if (pointInTriangle(pt, triB)) {
-                            segment.push_back(pt);
-                        } else if (!segment.empty()) {
-                            // End of a segment inside
-                            if (segment.size() > 1)
-                                intersectionSegments.emplace_back(segment.front(), segment.back());
-                            segment.clear();
-                        }
-                    }
-                    if (segment.size() > 1)
-                        intersectionSegments.emplace_back(segment.front(), segment.back());
-                }
-                // For each edge of triB, check if inside triA
-                const POINT* ptsB[3] = { &triB.p1, &triB.p2, &triB.p3 };
-                for (int i = 0; i < 3; ++i) {
-                    const POINT& p0 = *ptsB[i];
-                    const POINT& p1 = *ptsB[(i+1)%3];
-                    std::vector<POINT> segment;
-                    for (float t = 0; t <= 1.0f; t += step) {
-                        float x = p0.x + t * (p1.x - p0.x);
-                        float y = p0.y + t * (p1.y - p0.y);
-                        POINT pt(x, y, 0);
-                        if (pointInTriangle(pt, triA)) {
-                            segment.push_back(pt);
-                        } else if (!segment.empty()) {
-                            if (segment.size() > 1)
-                                intersectionSegments.emplace_back(segment.front(), segment.back());
-                            segment.clear();
-                        }
-                    }
-                    if (segment.size() > 1)
-                        intersectionSegments.emplace_back(segment.front(), segment.back());
-                }
-            } else {
-                // Non-coplanar: collect intersection segment endpoints as a line
-                POINT segA, segB;
-                if (triangleTriangleIntersectionSegment(triA, triB, segA, segB)) {
-                    intersectionSegments.emplace_back(segA, segB);
-                }
-            }
+    for (size_t m = 0; m < meshSet.size(); ++m) {
+        MeshEntry& mesh = meshSet[m];
+        if (!mesh.visible)
+            continue;
+        glColor3f(mesh.color[0], mesh.color[1], mesh.color[2]);
+        glPushMatrix();
+        float placement[16];
+        mesh.transform.toMatrix(placement);
+        glMultMatrixf(placement);
+        if (mesh.blocked)
+            drawBlocked(*mesh.blocked);
+        for (const auto& tri : mesh.triangles) {
+            glBegin(GL_LINE_LOOP);
+            glVertex3f(tri.p1.x, tri.p1.y, tri.p1.z);
+            glVertex3f(tri.p2.x, tri.p2.y, tri.p2.z);
+            glVertex3f(tri.p3.x, tri.p3.y, tri.p3.z);
+            glEnd();
         }
+        glPopMatrix();
     }
-    // Draw all intersection segments as lines in white
+
+    // Draw the stored intersection polylines in white; they are computed on
+    // request (computeIntersection) and hidden once stale, except that while
+    // a drag is followed the curve of an earlier step stays up
+    static const std::vector<Polyline> none;
+    IntersectionKey key = currentKey();
+    bool showCurve = intersectionKey == key || (computing && intersectionKey.sameGeometry(key));
     glColor3f(1.0f, 1.0f, 1.0f);
     glLineWidth(3.0f);
-    for (const auto& seg : intersectionSegments) {
-        glBegin(GL_LINES);
-        glVertex3f(seg.first.x, seg.first.y, seg.first.z);
-        glVertex3f(seg.second.x, seg.second.y, seg.second.z);
+    for (const Polyline& line : showCurve ? intersectionPolylines : none) {
+        glBegin(line.closed ? GL_LINE_LOOP : GL_LINE_STRIP);
+        for (const POINT& p : line.points)
+            glVertex3f(p.x, p.y, p.z);
         glEnd();
     }
     glLineWidth(1.0f);
 }
  
+STLWidget::IntersectionKey STLWidget::currentKey() const
+{
+    IntersectionKey key;
+    const MeshEntry* meshA = meshSet.meshA();
+    const MeshEntry* meshB = meshSet.meshB();
+    if (meshA && meshB) {
+        key.idA = meshA->id;
+        key.revisionA = meshA->revision;
+        key.idB = meshB->id;
+        key.revisionB = meshB->revision;
+        key.placeA = meshA->transform;
+        key.placeB = meshB->transform;
+        key.phase = broadPhase;
+    }
+    return key;
+}
+
+const std::vector<std::pair<POINT, POINT>>& STLWidget::segments() const
+{
+    static const std::vector<std::pair<POINT, POINT>> none;
+    return intersectionKey == currentKey() ? intersectionSegments : none;
+}
+
+const std::vector<Polyline>& STLWidget::polylines() const
+{
+    static const std::vector<Polyline> none;
+    return intersectionKey == currentKey() ? intersectionPolylines : none;
+}
+
+void STLWidget::computeIntersection()
+{
+    IntersectionKey key = currentKey();
+    if (key == intersectionKey && key.idA) {
+        update();
+        emit intersectionReady();
+        return;
+    }
+    if (!computing)
+        startIntersection(key);
+}
+
+// Hands the computation for key to the pool. Everything it reads is taken
+// here: the entries are shared so they outlive a removal, and placements are
+// copied so drags can go on meanwhile.
+void STLWidget::startIntersection(const IntersectionKey& key)
+{
+    auto result = std::make_shared<IntersectionResult>();
+    result->key = key;
+    if (!key.idA) {
+        storeIntersection(*result);
+        return;
+    }
+    if (!key.sameGeometry(intersectionKey))
+        rigidIntersection.reset();
+    // When only the placement changed since the stored result (a drag), the
+    // grid would be rebuilt from placed copies on every step; RigidIntersection
+    // keeps its trees and candidates across steps instead
+    bool moved = key.sameGeometry(intersectionKey) && key.phase == intersectionKey.phase;
+    bool grid = key.phase == BroadPhase::Grid && !moved;
+    std::shared_ptr<const MeshEntry> meshA = meshSet.share(size_t(meshSet.pairA()));
+    std::shared_ptr<const MeshEntry> meshB = meshSet.share(size_t(meshSet.pairB()));
+    computing = true;
+    computingKey = key;
+    intersectionPool.start([this, meshA, meshB, grid, result]() {
+        const IntersectionKey& key = result->key;
+        std::vector<std::pair<POINT, POINT>>& segments = result->segments;
+        // Blocked meshes cannot be dragged, so they are always in place
+        if (meshA->blocked && meshB->blocked) {
+            intersectBlocked(*meshA->blocked, *meshB->blocked, segments);
+        } else if (meshA->blocked) {
+            intersectBlocked(*meshA->blocked, meshB->placedTriangles(key.placeB), segments);
+        } else if (meshB->blocked) {
+            intersectBlocked(*meshB->blocked, meshA->placedTriangles(key.placeA), segments);
+        } else if (grid) {
+            intersectMeshes(meshA->placedTriangles(key.placeA), meshB->placedTriangles(key.placeB), segments,
+                            key.phase, &result->broadPhase);
+            result->measured = true;
+        } else {
+            rigidIntersection.intersect(meshA->triangles, key.placeA, meshB->triangles, key.placeB, segments,
+                                        &result->broadPhase, meshA->bvh, meshB->bvh);
+            // Drag steps keep the timings of the last full computation
+            result->measured = !result->broadPhase.reused && key.phase == BroadPhase::Tree;
+        }
+        result->stats = chainSegments(segments, result->polylines);
+        QMetaObject::invokeMethod(this, [this, result]() { storeIntersection(*result); }, Qt::QueuedConnection);
+    });
+}
+
+// GUI-thread side of a finished computation. If the pair or its placement
+// changed meanwhile, the current one is computed next.
+void STLWidget::storeIntersection(IntersectionResult& result)
+{
+    computing = false;
+    intersectionKey = result.key;
+    intersectionSegments = std::move(result.segments);
+    intersectionPolylines = std::move(result.polylines);
+    intersectionStats = result.stats;
+    if (result.measured)
+        broadPhaseTimes = result.broadPhase;
+    update();
+    IntersectionKey key = currentKey();
+    if (key == intersectionKey)
+        emit intersectionReady();
+    else
+        startIntersection(key);
+}
+
+void STLWidget::dragMeshB(int dx, int dy, bool rotate)
+{
+    MeshEntry* mesh = meshSet.meshB();
+    if (!mesh || mesh->blocked || (dx == 0 && dy == 0))
+        return;
+    // The camera only rotates the scene, so its inverse takes view directions to the world
+    QMatrix4x4 toWorld = model.inverted();
+    RigidTransform delta;
+    if (rotate) {
+        QVector3D axis = toWorld.mapVector(QVector3D(float(dy), float(dx), 0.0f));
+        POINT center = mesh->transform.apply(dragCenter);
+        float angle = qDegreesToRadians(0.5f * std::sqrt(float(dx * dx + dy * dy)));
+        delta = RigidTransform::translation(center) *
+                RigidTransform::rotation(POINT(axis.x(), axis.y(), axis.z()), angle) *
+                RigidTransform::translation(POINT(-center.x, -center.y, -center.z));
+    } else {
+        // World units per pixel at the distance the scene is viewed from
+        float perPixel = 2.0f * 3.0f * zoom * std::tan(qDegreesToRadians(22.5f)) / float(height() ? height() : 1);
+        QVector3D d = toWorld.mapVector(QVector3D(float(dx), float(-dy), 0.0f) * perPixel);
+        delta = RigidTransform::translation(POINT(d.x(), d.y(), d.z()));
+    }
+    mesh->transform = delta * mesh->transform;
+
+    // Follow the curve only for a pair the user has already intersected
+    IntersectionKey key = currentKey();
+    if (key.idA && (key.sameGeometry(intersectionKey) || (computing && key.sameGeometry(computingKey))))
+        computeIntersection();
+    else
+        update();
+}
+
+void STLWidget::setBroadPhase(BroadPhase phase)
+{
+    broadPhase = phase;
+    update();
+}
+
 void STLWidget::mousePressEvent(QMouseEvent *event)
 {
     lastMousePos = event->pos();
+    bool dragsMesh = (event->buttons() & Qt::RightButton) || (event->modifiers() & Qt::ShiftModifier);
+    MeshEntry* mesh = meshSet.meshB();
+    if (dragsMesh && mesh && !mesh->triangles.empty()) {
+        AABB bounds;
+        for (const auto& tri : mesh->triangles)
+            bounds.expand(triangleBounds(tri));
+        dragCenter = bounds.center();
+    }
 }
  
 void STLWidget::mouseMoveEvent(QMouseEvent *event)
 {
     int dx = event->x() - lastMousePos.x();
     int dy = event->y() - lastMousePos.y();
-    if (event->buttons() & Qt::LeftButton) {
-        rotationX += dy;
-        rotationY += dx;
-        update();
+    if (event->buttons() & Qt::RightButton) {
+        dragMeshB(dx, dy, false);
+    } else if (event->buttons() & Qt::LeftButton) {
+        if (event->modifiers() & Qt::ShiftModifier) {
+            dragMeshB(dx, dy, true);
+        } else {
+            rotationX += dy;
+            rotationY += dx;
+            update();
+        }
     }
     lastMousePos = event->pos();
 }
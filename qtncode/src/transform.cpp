@@ -0,0 +1,74 @@
+#include "transform.h"
+#include <algorithm>
+#include <cfloat>
+
+RigidTransform RigidTransform::rotation(const POINT& axis, float angle) {
+    RigidTransform m;
+    double len = std::sqrt(double(axis.x) * axis.x + double(axis.y) * axis.y + double(axis.z) * axis.z);
+    if (len == 0.0)
+        return m;
+    double x = axis.x / len, y = axis.y / len, z = axis.z / len;
+    double c = std::cos(angle), s = std::sin(angle), k = 1.0 - c;
+    const double rot[3][3] = { { c + x * x * k, x * y * k - z * s, x * z * k + y * s },
+                               { y * x * k + z * s, c + y * y * k, y * z * k - x * s },
+                               { z * x * k - y * s, z * y * k + x * s, c + z * z * k } };
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j)
+            m.r[i][j] = float(rot[i][j]);
+    return m;
+}
+
+RigidTransform operator*(const RigidTransform& a, const RigidTransform& b) {
+    double rot[3][3];
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j)
+            rot[i][j] = double(a.r[i][0]) * b.r[0][j] + double(a.r[i][1]) * b.r[1][j] + double(a.r[i][2]) * b.r[2][j];
+    // Gram-Schmidt on the rows; the third row is the cross product of the first two
+    double n0 = std::sqrt(rot[0][0] * rot[0][0] + rot[0][1] * rot[0][1] + rot[0][2] * rot[0][2]);
+    for (int j = 0; j < 3; ++j)
+        rot[0][j] /= n0;
+    double d = rot[0][0] * rot[1][0] + rot[0][1] * rot[1][1] + rot[0][2] * rot[1][2];
+    for (int j = 0; j < 3; ++j)
+        rot[1][j] -= d * rot[0][j];
+    double n1 = std::sqrt(rot[1][0] * rot[1][0] + rot[1][1] * rot[1][1] + rot[1][2] * rot[1][2]);
+    for (int j = 0; j < 3; ++j)
+        rot[1][j] /= n1;
+    rot[2][0] = rot[0][1] * rot[1][2] - rot[0][2] * rot[1][1];
+    rot[2][1] = rot[0][2] * rot[1][0] - rot[0][0] * rot[1][2];
+    rot[2][2] = rot[0][0] * rot[1][1] - rot[0][1] * rot[1][0];
+
+    RigidTransform m;
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j)
+            m.r[i][j] = float(rot[i][j]);
+    m.t = a.apply(b.t);
+    return m;
+}
+
+AABB transformedBounds(const AABB& box, const RigidTransform& m) {
+    if (box.empty() || m.isIdentity())
+        return box;
+    // Center moves with the transform; the half extents spread by |r|. The
+    // box is worked out in double and then widened by a bound on the float
+    // rounding of m.apply(), so it holds the corners as apply() places them.
+    const double lo[3] = { box.min.x, box.min.y, box.min.z };
+    const double hi[3] = { box.max.x, box.max.y, box.max.z };
+    const double t[3] = { m.t.x, m.t.y, m.t.z };
+    float minCorner[3], maxCorner[3];
+    for (int i = 0; i < 3; ++i) {
+        double c = t[i], h = 0.0, reach = std::fabs(t[i]);
+        for (int j = 0; j < 3; ++j) {
+            double r = m.r[i][j];
+            c += r * 0.5 * (lo[j] + hi[j]);
+            h += std::fabs(r) * 0.5 * (hi[j] - lo[j]);
+            reach += std::fabs(r) * std::max(std::fabs(lo[j]), std::fabs(hi[j]));
+        }
+        double pad = 4.0 * FLT_EPSILON * reach;
+        minCorner[i] = std::nextafter(float(c - h - pad), -HUGE_VALF);
+        maxCorner[i] = std::nextafter(float(c + h + pad), HUGE_VALF);
+    }
+    AABB result;
+    result.min = POINT(minCorner[0], minCorner[1], minCorner[2]);
+    result.max = POINT(maxCorner[0], maxCorner[1], maxCorner[2]);
+    return result;
+}
@@ -0,0 +1,114 @@
+#include "trianglebatch.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BATCH_DISPATCH 1
+#define KERNEL_INLINE inline __attribute__((always_inline))
+#else
+#define KERNEL_INLINE inline
+#endif
+
+static KERNEL_INLINE float maxAbs3(float a, float b, float c) {
+    return std::max(std::fabs(a), std::max(std::fabs(b), std::fabs(c)));
+}
+
+// The lane loop is plain C++ written to vectorize; it is inlined into one
+// wrapper per instruction set below, each compiled for that target.
+//
+// The exact predicates behind intersectTrianglePair() reject a pair when the
+// true distances all have one sign, so a margin only has to cover how far the
+// float distances here can be from the true ones: the rounding of the edges,
+// the normal and the dot products, fused or not.
+static KERNEL_INLINE uint32_t survivors(const Triangle& tri, const TriangleBatch& b) {
+    const int W = TriangleBatch::WIDTH;
+    const float rounding = 64.0f * std::numeric_limits<float>::epsilon();
+
+    const float ux = tri.p2.x - tri.p1.x, uy = tri.p2.y - tri.p1.y, uz = tri.p2.z - tri.p1.z;
+    const float vx = tri.p3.x - tri.p1.x, vy = tri.p3.y - tri.p1.y, vz = tri.p3.z - tri.p1.z;
+    const float nx = uy * vz - uz * vy, ny = uz * vx - ux * vz, nz = ux * vy - uy * vx;
+    const float edgesA = (std::fabs(ux) + std::fabs(uy) + std::fabs(uz)) * (std::fabs(vx) + std::fabs(vy) + std::fabs(vz));
+    const float magnitudeA = std::max(maxAbs3(tri.p1.x, tri.p1.y, tri.p1.z),
+                                      std::max(maxAbs3(tri.p2.x, tri.p2.y, tri.p2.z), maxAbs3(tri.p3.x, tri.p3.y, tri.p3.z)));
+
+    alignas(64) int keep[W];
+    for (int i = 0; i < W; ++i) {
+        const float x0 = b.x[0][i], y0 = b.y[0][i], z0 = b.z[0][i];
+        const float x1 = b.x[1][i], y1 = b.y[1][i], z1 = b.z[1][i];
+        const float x2 = b.x[2][i], y2 = b.y[2][i], z2 = b.z[2][i];
+        const float magnitude = std::max(magnitudeA, std::max(maxAbs3(x0, y0, z0),
+                                                              std::max(maxAbs3(x1, y1, z1), maxAbs3(x2, y2, z2))));
+
+        // Candidate corners against tri's plane
+        const float d0 = nx * (x0 - tri.p1.x) + ny * (y0 - tri.p1.y) + nz * (z0 - tri.p1.z);
+        const float d1 = nx * (x1 - tri.p1.x) + ny * (y1 - tri.p1.y) + nz * (z1 - tri.p1.z);
+        const float d2 = nx * (x2 - tri.p1.x) + ny * (y2 - tri.p1.y) + nz * (z2 - tri.p1.z);
+        const float dMax = maxAbs3(d0, d1, d2);
+        const float marginA = rounding * edgesA * magnitude;
+        const int sideA = ((d0 > marginA) & (d1 > marginA) & (d2 > marginA)) |
+                          ((d0 < -marginA) & (d1 < -marginA) & (d2 < -marginA));
+
+        // tri's corners against the candidate's plane; only meaningful once
+        // the pair is known not to be coplanar
+        const float bux = x1 - x0, buy = y1 - y0, buz = z1 - z0;
+        const float bvx = x2 - x0, bvy = y2 - y0, bvz = z2 - z0;
+        const float bnx = buy * bvz - buz * bvy, bny = buz * bvx - bux * bvz, bnz = bux * bvy - buy * bvx;
+        const float edgesB = (std::fabs(bux) + std::fabs(buy) + std::fabs(buz)) * (std::fabs(bvx) + std::fabs(bvy) + std::fabs(bvz));
+        const float e0 = bnx * (tri.p1.x - x0) + bny * (tri.p1.y - y0) + bnz * (tri.p1.z - z0);
+        const float e1 = bnx * (tri.p2.x - x0) + bny * (tri.p2.y - y0) + bnz * (tri.p2.z - z0);
+        const float e2 = bnx * (tri.p3.x - x0) + bny * (tri.p3.y - y0) + bnz * (tri.p3.z - z0);
+        const float marginB = rounding * edgesB * magnitude;
+        const int sideB = (dMax > marginA) &
+                          (((e0 > marginB) & (e1 > marginB) & (e2 > marginB)) |
+                           ((e0 < -marginB) & (e1 < -marginB) & (e2 < -marginB)));
+
+        keep[i] = (sideA | sideB) ^ 1;
+    }
+
+    uint32_t mask = 0;
+    for (int i = 0; i < b.count; ++i)
+        mask |= uint32_t(keep[i]) << i;
+    return mask;
+}
+
+using SurvivorKernel = uint32_t (*)(const Triangle&, const TriangleBatch&);
+
+static uint32_t survivorsBaseline(const Triangle& tri, const TriangleBatch& b) { return survivors(tri, b); }
+
+#ifdef BATCH_DISPATCH
+__attribute__((target("avx2,fma")))
+static uint32_t survivorsAVX2(const Triangle& tri, const TriangleBatch& b) { return survivors(tri, b); }
+
+__attribute__((target("avx512f")))
+static uint32_t survivorsAVX512(const Triangle& tri, const TriangleBatch& b) { return survivors(tri, b); }
+#endif
+
+struct KernelChoice {
+    SurvivorKernel kernel;
+    const char* name;
+};
+
+static const KernelChoice& kernelChoice() {
+    static const KernelChoice choice = []() -> KernelChoice {
+#ifdef BATCH_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return { survivorsAVX512, "AVX-512" };
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return { survivorsAVX2, "AVX2" };
+        return { survivorsBaseline, "SSE2" };
+#else
+        return { survivorsBaseline, "generic" };
+#endif
+    }();
+    return choice;
+}
+
+uint32_t planeSideSurvivors(const Triangle& tri, const TriangleBatch& batch) {
+    return kernelChoice().kernel(tri, batch);
+}
+
+const char* triangleBatchKernel() {
+    return kernelChoice().name;
+}